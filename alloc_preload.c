@@ -0,0 +1,559 @@
+// LD_PRELOAD allocation tracer: built as liballoc_preload.so, never linked into the profiler.
+// Every call updates per-thread counters; one allocation in N on average is traced for its
+// lifetime and call site, at exponentially distributed gaps so loops cannot alias with
+// it. The summary is appended to $ALLOC_PROFILE_OUTPUT at exit.
+#define _GNU_SOURCE
+#include "alloc_profile.h"
+#include <dlfcn.h>
+#include <errno.h>
+#include <execinfo.h>
+#include <fcntl.h>
+#include <malloc.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+// glibc's own entry points: no dlsym bootstrap, which would itself allocate
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void *__libc_memalign(size_t alignment, size_t size);
+extern void __libc_free(void *ptr);
+
+#define SITE_SLOTS 1024          // Per-thread call-site table, open addressing
+#define SITE_PROBE 16
+#define SITE_FRAMES 3            // Return addresses that name a call site
+#define BACKTRACE_DEPTH 12
+#define TRACE_SLOTS (1 << 16)    // Process-wide table of traced blocks
+#define TRACE_PROBE 16
+#define TRACE_BUSY ((uintptr_t)1)
+#define LIVE_FLUSH (256 * 1024)  // Per-thread live-byte drift before it is published
+#define REPORT_BUFFER (256 * 1024)
+
+typedef struct {
+    void *frames[SITE_FRAMES];
+    uint64_t count;
+    uint64_t bytes;
+} site_slot_t;
+
+typedef struct thread_state {
+    struct thread_state *next;   // Every state ever made, for the report
+    struct thread_state *spare;  // Free list of states whose thread exited
+    uint64_t calls[ALLOC_CALL_COUNT];
+    uint64_t bytes;
+    uint64_t class_count[ALLOC_SIZE_CLASSES];
+    uint64_t class_bytes[ALLOC_SIZE_CLASSES];
+    uint64_t life[ALLOC_LIFE_BUCKETS];
+    int64_t live_drift;          // Not yet added to live_bytes
+    uint64_t countdown;          // Allocations until the next traced one
+    uint64_t rng;                // xorshift64* state for the sampling gaps
+    site_slot_t sites[SITE_SLOTS];
+} thread_state_t;
+
+static int enabled = 0;
+static uint64_t period = ALLOC_DEFAULT_PERIOD;
+static _Atomic(thread_state_t *) threads = NULL;  // Never unlinked: exited threads still count
+// An exited thread's state is handed to the next new thread, which keeps adding to its totals
+static thread_state_t *spares = NULL;
+static pthread_mutex_t spares_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t exit_key;           // Its destructor returns the state to the spares
+static int have_exit_key = 0;
+static atomic_llong live_bytes = 0;
+static atomic_llong peak_bytes = 0;
+
+// Traced blocks: key is the pointer, found again on free by a bounded linear probe
+static _Atomic uintptr_t trace_keys[TRACE_SLOTS];
+static uint64_t trace_start[TRACE_SLOTS];
+static atomic_long traced = 0;
+
+static __thread thread_state_t *self __attribute__((tls_model("initial-exec")));
+static __thread int busy __attribute__((tls_model("initial-exec")));  // Inside our own bookkeeping
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int size_class(size_t size) {
+    if (size <= 16) {
+        return 0;
+    }
+    int c = 64 - __builtin_clzl(size - 1) - 4;  // Smallest c with size <= 16 << c
+    return c < ALLOC_SIZE_CLASSES - 1 ? c : ALLOC_SIZE_CLASSES - 1;
+}
+
+static int life_bucket(uint64_t ns) {
+    int b = 0;
+    for (uint64_t limit = 100; b < ALLOC_LIFE_BUCKETS - 1 && ns >= limit; limit *= 10) {
+        b++;
+    }
+    return b;
+}
+
+static size_t hash_pointer(uintptr_t key) {
+    return (size_t)((key >> 4) * 0x9E3779B97F4A7C15ULL >> 48);
+}
+
+// Gap to the next traced allocation: exponential with mean 'period', as tcmalloc samples.
+// A fixed gap lines up with loops whose sizes cycle, so every traced block had the same size
+static uint64_t next_gap(thread_state_t *state) {
+    state->rng ^= state->rng >> 12;
+    state->rng ^= state->rng << 25;
+    state->rng ^= state->rng >> 27;
+    double u = ((state->rng * 0x2545F4914F6CDD1DULL) >> 11) * (1.0 / 9007199254740992.0);  // [0, 1)
+    double gap = -log(1.0 - u) * period;
+    return gap < 1.0 ? 1 : (uint64_t)gap;
+}
+
+static void spare_push(thread_state_t *state) {
+    pthread_mutex_lock(&spares_lock);
+    state->spare = spares;
+    spares = state;
+    pthread_mutex_unlock(&spares_lock);
+}
+
+static thread_state_t *spare_pop(void) {
+    pthread_mutex_lock(&spares_lock);
+    thread_state_t *state = spares;
+    if (state != NULL) {
+        spares = state->spare;
+    }
+    pthread_mutex_unlock(&spares_lock);
+    return state;
+}
+
+// Key destructor; a thread that allocates again afterwards gets a state back and
+// the destructor runs once more
+static void thread_exit(void *arg) {
+    self = NULL;
+    spare_push(arg);
+}
+
+// Thread state is recycled or mmap'd, so getting one cannot recurse into malloc;
+// one mapping per live thread, not per thread ever created
+static thread_state_t *thread_state(void) {
+    if (self == NULL) {
+        thread_state_t *state = spare_pop();
+        if (state == NULL) {
+            void *mem = mmap(NULL, sizeof(thread_state_t), PROT_READ | PROT_WRITE,
+                             MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (mem == MAP_FAILED) {
+                return NULL;
+            }
+            state = mem;
+            state->rng = ((uintptr_t)state ^ now_ns()) | 1;
+            state->countdown = next_gap(state);
+            state->next = atomic_load(&threads);
+            while (!atomic_compare_exchange_weak(&threads, &state->next, state)) {
+            }
+        }
+        self = state;
+        if (have_exit_key) {
+            int was_busy = busy;
+            busy = 1;  // pthread_setspecific may allocate its second-level block
+            pthread_setspecific(exit_key, state);
+            busy = was_busy;
+        }
+    }
+    return self;
+}
+
+static void raise_peak(long long live) {
+    long long peak = atomic_load_explicit(&peak_bytes, memory_order_relaxed);
+    while (live > peak && !atomic_compare_exchange_weak(&peak_bytes, &peak, live)) {
+    }
+}
+
+// The shared total only moves every LIVE_FLUSH bytes of drift; growth is checked against
+// the peak on every allocation with plain loads, which stay cached while the peak holds
+static void live_add(thread_state_t *state, int64_t delta) {
+    state->live_drift += delta;
+    if (state->live_drift >= LIVE_FLUSH || state->live_drift <= -LIVE_FLUSH) {
+        raise_peak(atomic_fetch_add(&live_bytes, state->live_drift) + state->live_drift);
+        state->live_drift = 0;
+    } else if (delta > 0) {
+        long long live = atomic_load_explicit(&live_bytes, memory_order_relaxed) + state->live_drift;
+        if (live > atomic_load_explicit(&peak_bytes, memory_order_relaxed)) {
+            raise_peak(live);
+        }
+    }
+}
+
+static void trace_insert(void *ptr, uint64_t start) {
+    size_t h = hash_pointer((uintptr_t)ptr);
+    for (size_t i = 0; i < TRACE_PROBE; i++) {
+        size_t slot = (h + i) & (TRACE_SLOTS - 1);
+        uintptr_t empty = 0;
+        if (atomic_compare_exchange_strong(&trace_keys[slot], &empty, TRACE_BUSY)) {
+            trace_start[slot] = start;
+            atomic_store_explicit(&trace_keys[slot], (uintptr_t)ptr, memory_order_release);
+            atomic_fetch_add_explicit(&traced, 1, memory_order_relaxed);
+            return;
+        }
+    }
+    // Neighbourhood full: the block goes untraced
+}
+
+// Start time of a traced block, removing it; 0 if it was not traced
+static uint64_t trace_remove(void *ptr) {
+    if (atomic_load_explicit(&traced, memory_order_relaxed) == 0) {
+        return 0;
+    }
+    size_t h = hash_pointer((uintptr_t)ptr);
+    for (size_t i = 0; i < TRACE_PROBE; i++) {
+        size_t slot = (h + i) & (TRACE_SLOTS - 1);
+        uintptr_t key = (uintptr_t)ptr;
+        if (atomic_load_explicit(&trace_keys[slot], memory_order_acquire) == key &&
+            atomic_compare_exchange_strong(&trace_keys[slot], &key, TRACE_BUSY)) {
+            uint64_t start = trace_start[slot];
+            atomic_store_explicit(&trace_keys[slot], 0, memory_order_release);
+            atomic_fetch_sub_explicit(&traced, 1, memory_order_relaxed);
+            return start;
+        }
+    }
+    return 0;
+}
+
+// The site is the caller of the allocation function plus the frames above it.
+// Kept out of line so the untraced path needs no stack frame for the backtrace
+__attribute__((noinline, cold)) static void trace_site(thread_state_t *state, void *caller, size_t size) {
+    void *stack[BACKTRACE_DEPTH];
+    void *frames[SITE_FRAMES] = {caller};
+    int depth = backtrace(stack, BACKTRACE_DEPTH);
+
+    for (int i = 0; i < depth; i++) {
+        if (stack[i] == caller) {
+            for (int f = 1; f < SITE_FRAMES && i + f < depth; f++) {
+                frames[f] = stack[i + f];
+            }
+            break;
+        }
+    }
+
+    size_t h = hash_pointer((uintptr_t)frames[0] ^ (uintptr_t)frames[1] * 31 ^ (uintptr_t)frames[2] * 17);
+    for (size_t i = 0; i < SITE_PROBE; i++) {
+        site_slot_t *slot = &state->sites[(h + i) & (SITE_SLOTS - 1)];
+        if (slot->count == 0) {
+            memcpy(slot->frames, frames, sizeof(frames));
+        } else if (memcmp(slot->frames, frames, sizeof(frames)) != 0) {
+            continue;
+        }
+        slot->count++;
+        slot->bytes += size;
+        return;
+    }
+}
+
+static void record_alloc(alloc_call_t call, void *ptr, size_t size, void *caller) {
+    thread_state_t *state;
+    if (ptr == NULL || !enabled || busy || (state = thread_state()) == NULL) {
+        return;
+    }
+    busy = 1;
+    int c = size_class(size);
+    state->calls[call]++;
+    state->bytes += size;
+    state->class_count[c]++;
+    state->class_bytes[c] += size;
+    live_add(state, (int64_t)malloc_usable_size(ptr));
+    if (--state->countdown == 0) {
+        state->countdown = next_gap(state);
+        trace_site(state, caller, size);
+        trace_insert(ptr, now_ns());
+    }
+    busy = 0;
+}
+
+static void record_free(void *ptr, size_t usable) {
+    thread_state_t *state;
+    if (ptr == NULL || !enabled || busy || (state = thread_state()) == NULL) {
+        return;
+    }
+    busy = 1;
+    state->calls[ALLOC_FREE]++;
+    live_add(state, -(int64_t)usable);
+    uint64_t start = trace_remove(ptr);
+    if (start != 0) {
+        state->life[life_bucket(now_ns() - start)]++;
+    }
+    busy = 0;
+}
+
+void *malloc(size_t size) {
+    void *ptr = __libc_malloc(size);
+    record_alloc(ALLOC_MALLOC, ptr, size, __builtin_return_address(0));
+    return ptr;
+}
+
+void *calloc(size_t count, size_t size) {
+    void *ptr = __libc_calloc(count, size);
+    record_alloc(ALLOC_CALLOC, ptr, count * size, __builtin_return_address(0));
+    return ptr;
+}
+
+void *realloc(void *ptr, size_t size) {
+    size_t old = ptr != NULL ? malloc_usable_size(ptr) : 0;
+    if (ptr == NULL) {
+        void *fresh = __libc_realloc(NULL, size);
+        record_alloc(ALLOC_REALLOC, fresh, size, __builtin_return_address(0));
+        return fresh;
+    }
+    if (size == 0) {
+        // glibc frees the block and returns NULL
+        record_free(ptr, old);
+        return __libc_realloc(ptr, 0);
+    }
+
+    // Resizing keeps a traced block's birth time, even when it moves
+    uint64_t start = enabled && !busy ? trace_remove(ptr) : 0;
+    void *next = __libc_realloc(ptr, size);
+    thread_state_t *state;
+    if (start != 0) {
+        trace_insert(next != NULL ? next : ptr, start);
+    }
+    if (next != NULL && enabled && !busy && (state = thread_state()) != NULL) {
+        int c = size_class(size);
+        state->calls[ALLOC_REALLOC]++;
+        state->bytes += size;
+        state->class_count[c]++;
+        state->class_bytes[c] += size;
+        live_add(state, (int64_t)malloc_usable_size(next) - (int64_t)old);
+    }
+    return next;
+}
+
+void *reallocarray(void *ptr, size_t count, size_t size) {
+    size_t total;
+    if (__builtin_mul_overflow(count, size, &total)) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    return realloc(ptr, total);
+}
+
+void free(void *ptr) {
+    if (ptr != NULL && enabled) {
+        record_free(ptr, malloc_usable_size(ptr));
+    }
+    __libc_free(ptr);
+}
+
+int posix_memalign(void **memptr, size_t alignment, size_t size) {
+    if (alignment % sizeof(void *) != 0 || (alignment & (alignment - 1)) != 0) {
+        return EINVAL;
+    }
+    void *ptr = __libc_memalign(alignment, size);
+    if (ptr == NULL) {
+        return ENOMEM;
+    }
+    record_alloc(ALLOC_MEMALIGN, ptr, size, __builtin_return_address(0));
+    *memptr = ptr;
+    return 0;
+}
+
+void *aligned_alloc(size_t alignment, size_t size) {
+    void *ptr = __libc_memalign(alignment, size);
+    record_alloc(ALLOC_MEMALIGN, ptr, size, __builtin_return_address(0));
+    return ptr;
+}
+
+void *memalign(size_t alignment, size_t size) {
+    void *ptr = __libc_memalign(alignment, size);
+    record_alloc(ALLOC_MEMALIGN, ptr, size, __builtin_return_address(0));
+    return ptr;
+}
+
+void *valloc(size_t size) {
+    void *ptr = __libc_memalign((size_t)sysconf(_SC_PAGESIZE), size);
+    record_alloc(ALLOC_MEMALIGN, ptr, size, __builtin_return_address(0));
+    return ptr;
+}
+
+static int compare_sites(const void *a, const void *b) {
+    const site_slot_t *x = a;
+    const site_slot_t *y = b;
+    return memcmp(x->frames, y->frames, sizeof(x->frames));
+}
+
+static int compare_site_counts(const void *a, const void *b) {
+    const site_slot_t *x = a;
+    const site_slot_t *y = b;
+    return x->count < y->count ? 1 : x->count > y->count ? -1 : 0;
+}
+
+// "symbol+0x12" when exported, otherwise "object+0x1234" for addr2line
+static int describe_frame(char *out, size_t len, void *frame) {
+    Dl_info info;
+    if (frame == NULL) {
+        return 0;
+    }
+    if (dladdr(frame, &info) == 0) {
+        return snprintf(out, len, "%p", frame);
+    }
+    if (info.dli_sname != NULL) {
+        return snprintf(out, len, "%s+0x%lx", info.dli_sname,
+                        (unsigned long)((char *)frame - (char *)info.dli_saddr));
+    }
+    const char *object = info.dli_fname != NULL ? strrchr(info.dli_fname, '/') : NULL;
+    return snprintf(out, len, "%s+0x%lx", object != NULL ? object + 1 : "?",
+                    (unsigned long)((char *)frame - (char *)info.dli_fbase));
+}
+
+// Merge every thread's sites, then keep the heaviest
+static size_t collect_sites(site_slot_t *merged, size_t capacity) {
+    size_t count = 0;
+    for (thread_state_t *state = atomic_load(&threads); state != NULL; state = state->next) {
+        for (size_t i = 0; i < SITE_SLOTS && count < capacity; i++) {
+            if (state->sites[i].count > 0) {
+                merged[count++] = state->sites[i];
+            }
+        }
+    }
+    qsort(merged, count, sizeof(site_slot_t), compare_sites);
+    size_t unique = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (unique > 0 && compare_sites(&merged[unique - 1], &merged[i]) == 0) {
+            merged[unique - 1].count += merged[i].count;
+            merged[unique - 1].bytes += merged[i].bytes;
+        } else {
+            merged[unique++] = merged[i];
+        }
+    }
+    qsort(merged, unique, sizeof(site_slot_t), compare_site_counts);
+    return unique < ALLOC_TOP_SITES ? unique : ALLOC_TOP_SITES;
+}
+
+static void write_report(void) {
+    const char *path = getenv(ALLOC_OUTPUT_ENV);
+    alloc_profile_t total;
+    long long live = atomic_load(&live_bytes);
+
+    memset(&total, 0, sizeof(total));
+    for (thread_state_t *state = atomic_load(&threads); state != NULL; state = state->next) {
+        for (int i = 0; i < ALLOC_CALL_COUNT; i++) {
+            total.calls[i] += state->calls[i];
+        }
+        for (int c = 0; c < ALLOC_SIZE_CLASSES; c++) {
+            total.class_count[c] += state->class_count[c];
+            total.class_bytes[c] += state->class_bytes[c];
+        }
+        for (int b = 0; b < ALLOC_LIFE_BUCKETS; b++) {
+            total.life[b] += state->life[b];
+        }
+        total.bytes += state->bytes;
+        live += state->live_drift;
+    }
+    long long peak = atomic_load(&peak_bytes);
+    total.peak_live = (uint64_t)(live > peak ? live : peak);
+    total.live_at_exit = live > 0 ? (uint64_t)live : 0;
+
+    // One buffer and one O_APPEND write, so reports from several processes do not interleave
+    size_t sites_capacity = TRACE_SLOTS;
+    site_slot_t *sites = mmap(NULL, sites_capacity * sizeof(site_slot_t), PROT_READ | PROT_WRITE,
+                              MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    char *text = mmap(NULL, REPORT_BUFFER, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (sites == MAP_FAILED || text == MAP_FAILED) {
+        return;
+    }
+    size_t used = 0;
+#define EMIT(...) used += (size_t)snprintf(text + used, used < REPORT_BUFFER ? REPORT_BUFFER - used : 0, __VA_ARGS__)
+    EMIT("process %d %d %lu\n", (int)getpid(), (int)getppid(), (unsigned long)period);
+    EMIT("calls");
+    for (int i = 0; i < ALLOC_CALL_COUNT; i++) {
+        EMIT(" %lu", (unsigned long)total.calls[i]);
+    }
+    EMIT("\nbytes %lu %lu %lu\n", (unsigned long)total.bytes, (unsigned long)total.peak_live,
+         (unsigned long)total.live_at_exit);
+    for (int c = 0; c < ALLOC_SIZE_CLASSES; c++) {
+        EMIT("class %d %lu %lu\n", c, (unsigned long)total.class_count[c], (unsigned long)total.class_bytes[c]);
+    }
+    for (int b = 0; b < ALLOC_LIFE_BUCKETS; b++) {
+        EMIT("life %d %lu\n", b, (unsigned long)total.life[b]);
+    }
+    EMIT("traced_live %ld\n", atomic_load(&traced));
+    size_t num_sites = collect_sites(sites, sites_capacity);
+    for (size_t s = 0; s < num_sites; s++) {
+        char site[ALLOC_SITE_TEXT];
+        size_t len = 0;
+        for (int f = 0; f < SITE_FRAMES && sites[s].frames[f] != NULL && len < sizeof(site); f++) {
+            if (f > 0) {
+                len += (size_t)snprintf(site + len, sizeof(site) - len, " <- ");
+            }
+            if (len < sizeof(site)) {
+                len += (size_t)describe_frame(site + len, sizeof(site) - len, sites[s].frames[f]);
+            }
+        }
+        EMIT("site %lu %lu %s\n", (unsigned long)sites[s].count, (unsigned long)sites[s].bytes, site);
+    }
+    EMIT("end\n");
+#undef EMIT
+
+    int fd = open(path, O_WRONLY | O_APPEND | O_CREAT, 0600);
+    if (fd >= 0) {
+        if (write(fd, text, used < REPORT_BUFFER ? used : REPORT_BUFFER) < 0) {
+            perror("alloc_preload: write");
+        }
+        close(fd);
+    }
+    munmap(sites, sites_capacity * sizeof(site_slot_t));
+    munmap(text, REPORT_BUFFER);
+}
+
+// A forked child starts from zero: it inherits the parent's counters, which the parent
+// reports itself, and only the forking thread survives, so the other states become spares
+static void fork_child(void) {
+    long long live = atomic_load(&live_bytes);
+
+    pthread_mutex_init(&spares_lock, NULL);
+    spares = NULL;
+    for (thread_state_t *state = atomic_load(&threads); state != NULL; state = state->next) {
+        live += state->live_drift;
+        memset(state->calls, 0, sizeof(state->calls));
+        state->bytes = 0;
+        memset(state->class_count, 0, sizeof(state->class_count));
+        memset(state->class_bytes, 0, sizeof(state->class_bytes));
+        memset(state->life, 0, sizeof(state->life));
+        state->live_drift = 0;
+        memset(state->sites, 0, sizeof(state->sites));
+        if (state != self) {
+            spare_push(state);
+        }
+    }
+    // The heap itself is inherited, so live bytes carry over; the peak starts from them
+    atomic_store(&live_bytes, live);
+    atomic_store(&peak_bytes, live);
+    for (size_t i = 0; i < TRACE_SLOTS; i++) {
+        atomic_store_explicit(&trace_keys[i], 0, memory_order_relaxed);
+    }
+    atomic_store(&traced, 0);
+}
+
+__attribute__((constructor)) static void alloc_preload_init(void) {
+    const char *value = getenv(ALLOC_PERIOD_ENV);
+    if (value != NULL && strtoull(value, NULL, 0) > 0) {
+        period = strtoull(value, NULL, 0);
+    }
+    // backtrace loads libgcc_s on first use; do it before any traced allocation
+    void *frame;
+    busy = 1;
+    backtrace(&frame, 1);
+    have_exit_key = pthread_key_create(&exit_key, thread_exit) == 0;
+    pthread_atfork(NULL, NULL, fork_child);
+    busy = 0;
+    enabled = getenv(ALLOC_OUTPUT_ENV) != NULL;
+}
+
+__attribute__((destructor)) static void alloc_preload_fini(void) {
+    if (enabled) {
+        busy = 1;
+        write_report();
+        enabled = 0;
+    }
+}
@@ -0,0 +1,359 @@
+#define _GNU_SOURCE
+#include "alloc_profile.h"
+#include <libgen.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define ALLOC_NS_PER_CALL 20.0     // Rough glibc fast-path cost of one malloc or free
+#define ALLOC_VISIBLE_SHARE 0.02   // Allocator time worth acting on, as a share of CPU time
+#define ALLOC_POOL_SHARE 0.5       // One size class taking this share of calls suits a pool
+#define ALLOC_POOL_CLASS 9         // Pools pay off for classes up to 8 KiB
+#define ALLOC_SHORT_BUCKETS 4      // Lifetimes under 100 us count as short
+#define ALLOC_ARENA_SHARE 0.8      // Share of short-lived traced blocks that suits an arena
+
+static const char *const call_names[ALLOC_CALL_COUNT] = {
+    [ALLOC_MALLOC] = "malloc",
+    [ALLOC_CALLOC] = "calloc",
+    [ALLOC_REALLOC] = "realloc",
+    [ALLOC_MEMALIGN] = "aligned",
+    [ALLOC_FREE] = "free",
+};
+
+static const char *const life_names[ALLOC_LIFE_BUCKETS] = {
+    "< 100 ns", "< 1 us", "< 10 us", "< 100 us", "< 1 ms",
+    "< 10 ms", "< 100 ms", "< 1 s", "< 10 s", ">= 10 s",
+};
+
+int alloc_profiling = 1;
+
+const char *alloc_call_name(alloc_call_t call) {
+    return call < ALLOC_CALL_COUNT ? call_names[call] : "unknown";
+}
+
+size_t alloc_class_limit(int size_class) {
+    return size_class < ALLOC_SIZE_CLASSES - 1 ? (size_t)16 << size_class : 0;
+}
+
+int alloc_profile_begin(alloc_session_t *session) {
+    char exe[PATH_MAX];
+    char lib[PATH_MAX + sizeof(ALLOC_PRELOAD_LIB) + 1];
+
+    memset(session, 0, sizeof(*session));
+    ssize_t len = readlink("/proc/self/exe", exe, sizeof(exe) - 1);
+    if (len < 0) {
+        perror("readlink /proc/self/exe");
+        return -1;
+    }
+    exe[len] = '\0';
+    snprintf(lib, sizeof(lib), "%s/%s", dirname(exe), ALLOC_PRELOAD_LIB);
+    if (access(lib, R_OK) != 0) {
+        fprintf(stderr, "%s not found next to the profiler (make builds it); "
+                        "no allocation profile\n", ALLOC_PRELOAD_LIB);
+        return -1;
+    }
+
+    strcpy(session->output, "/tmp/alloc_profile.XXXXXX");
+    int fd = mkstemp(session->output);
+    if (fd < 0) {
+        perror("mkstemp");
+        return -1;
+    }
+    close(fd);
+
+    // Keep whatever the caller already preloads, after ours
+    const char *preload = getenv("LD_PRELOAD");
+    char *value = malloc(strlen(lib) + (preload != NULL ? strlen(preload) + 1 : 0) + 1);
+    if (value == NULL) {
+        perror("Failed to allocate LD_PRELOAD");
+        unlink(session->output);
+        return -1;
+    }
+    sprintf(value, preload != NULL && *preload != '\0' ? "%s:%s" : "%s", lib, preload);
+    session->saved_preload = preload != NULL ? strdup(preload) : NULL;
+    setenv("LD_PRELOAD", value, 1);
+    setenv(ALLOC_OUTPUT_ENV, session->output, 1);
+    free(value);
+    session->active = 1;
+    return 0;
+}
+
+// Fields of one "process" block; 0 once its "end" line is read
+static int parse_line(const char *line, alloc_profile_t *profile) {
+    unsigned long a, b, c;
+    int index;
+    int consumed;
+
+    if (sscanf(line, "class %d %lu %lu", &index, &a, &b) == 3 && index >= 0 && index < ALLOC_SIZE_CLASSES) {
+        profile->class_count[index] = a;
+        profile->class_bytes[index] = b;
+    } else if (sscanf(line, "life %d %lu", &index, &a) == 2 && index >= 0 && index < ALLOC_LIFE_BUCKETS) {
+        profile->life[index] = a;
+    } else if (sscanf(line, "bytes %lu %lu %lu", &a, &b, &c) == 3) {
+        profile->bytes = a;
+        profile->peak_live = b;
+        profile->live_at_exit = c;
+    } else if (sscanf(line, "traced_live %lu", &a) == 1) {
+        profile->traced_live = a;
+    } else if (strncmp(line, "calls", 5) == 0) {
+        const char *p = line + 5;
+        for (int i = 0; i < ALLOC_CALL_COUNT && sscanf(p, " %lu%n", &a, &consumed) == 1; i++) {
+            profile->calls[i] = a;
+            p += consumed;
+        }
+    } else if (sscanf(line, "site %lu %lu %n", &a, &b, &consumed) == 2 && profile->num_sites < ALLOC_TOP_SITES) {
+        alloc_site_t *site = &profile->sites[profile->num_sites++];
+        site->count = a;
+        site->bytes = b;
+        snprintf(site->text, sizeof(site->text), "%s", line + consumed);
+        site->text[strcspn(site->text, "\n")] = '\0';
+    } else if (strncmp(line, "end", 3) == 0) {
+        return 0;
+    }
+    return 1;
+}
+
+// Sum a child process into the totals; peak is the largest single process's
+static void merge_profile(alloc_profile_t *total, const alloc_profile_t *child) {
+    total->period = child->period;
+    for (int i = 0; i < ALLOC_CALL_COUNT; i++) {
+        total->calls[i] += child->calls[i];
+    }
+    for (int c = 0; c < ALLOC_SIZE_CLASSES; c++) {
+        total->class_count[c] += child->class_count[c];
+        total->class_bytes[c] += child->class_bytes[c];
+    }
+    for (int b = 0; b < ALLOC_LIFE_BUCKETS; b++) {
+        total->life[b] += child->life[b];
+    }
+    total->bytes += child->bytes;
+    total->peak_live = child->peak_live > total->peak_live ? child->peak_live : total->peak_live;
+    total->live_at_exit += child->live_at_exit;
+    total->traced_live += child->traced_live;
+
+    for (size_t s = 0; s < child->num_sites; s++) {
+        size_t t = 0;
+        while (t < total->num_sites && strcmp(total->sites[t].text, child->sites[s].text) != 0) {
+            t++;
+        }
+        if (t == total->num_sites) {
+            if (t == ALLOC_TOP_SITES) {
+                // Replace the lightest site when this one outweighs it
+                size_t lightest = 0;
+                for (size_t i = 1; i < ALLOC_TOP_SITES; i++) {
+                    lightest = total->sites[i].count < total->sites[lightest].count ? i : lightest;
+                }
+                if (total->sites[lightest].count >= child->sites[s].count) {
+                    continue;
+                }
+                t = lightest;
+            } else {
+                total->num_sites++;
+            }
+            total->sites[t] = child->sites[s];
+        } else {
+            total->sites[t].count += child->sites[s].count;
+            total->sites[t].bytes += child->sites[s].bytes;
+        }
+    }
+}
+
+static int compare_site_counts(const void *a, const void *b) {
+    const alloc_site_t *x = a;
+    const alloc_site_t *y = b;
+    return x->count < y->count ? 1 : x->count > y->count ? -1 : 0;
+}
+
+void alloc_profile_end(alloc_session_t *session, alloc_profile_t *profile) {
+    char line[ALLOC_SITE_TEXT + 64];
+
+    memset(profile, 0, sizeof(*profile));
+    if (!session->active) {
+        return;
+    }
+    if (session->saved_preload != NULL) {
+        setenv("LD_PRELOAD", session->saved_preload, 1);
+    } else {
+        unsetenv("LD_PRELOAD");
+    }
+    unsetenv(ALLOC_OUTPUT_ENV);
+    free(session->saved_preload);
+    session->saved_preload = NULL;
+    session->active = 0;
+
+    FILE *file = fopen(session->output, "r");
+    if (file == NULL) {
+        perror("fopen allocation profile");
+        unlink(session->output);
+        return;
+    }
+    // The direct child is the target; anything it spawned reports under its own pid
+    alloc_profile_t scratch;
+    alloc_profile_t children;
+    alloc_profile_t *current = NULL;
+    memset(&children, 0, sizeof(children));
+    while (fgets(line, sizeof(line), file) != NULL) {
+        int pid, ppid;
+        unsigned long period;
+        if (sscanf(line, "process %d %d %lu", &pid, &ppid, &period) == 3) {
+            if (ppid == getpid() && !profile->found) {
+                current = profile;
+                profile->found = 1;
+            } else {
+                current = &scratch;
+                memset(&scratch, 0, sizeof(scratch));
+                profile->other_processes++;
+            }
+            current->period = period;
+        } else if (current != NULL && !parse_line(line, current)) {
+            if (current == &scratch) {
+                merge_profile(&children, &scratch);
+            }
+            current = NULL;
+        }
+    }
+    fclose(file);
+    unlink(session->output);
+
+    if (!profile->found && profile->other_processes > 0) {
+        int others = profile->other_processes;
+        *profile = children;
+        qsort(profile->sites, profile->num_sites, sizeof(alloc_site_t), compare_site_counts);
+        profile->found = 1;
+        profile->merged = 1;
+        profile->other_processes = others;
+    }
+}
+
+static void print_size(double bytes) {
+    if (bytes >= 1024.0 * 1024 * 1024) {
+        printf("%.2f GiB", bytes / (1024.0 * 1024 * 1024));
+    } else if (bytes >= 1024.0 * 1024) {
+        printf("%.2f MiB", bytes / (1024.0 * 1024));
+    } else if (bytes >= 1024.0) {
+        printf("%.2f KiB", bytes / 1024.0);
+    } else {
+        printf("%.0f B", bytes);
+    }
+}
+
+void print_alloc_profile(const alloc_profile_t *profile, double wall_seconds, double cpu_seconds) {
+    if (!profile->found) {
+        printf("No allocation summary came back (statically linked target, or it did not exit normally)\n");
+        return;
+    }
+    uint64_t allocations = profile->calls[ALLOC_MALLOC] + profile->calls[ALLOC_CALLOC] +
+                           profile->calls[ALLOC_REALLOC] + profile->calls[ALLOC_MEMALIGN];
+    uint64_t calls = allocations + profile->calls[ALLOC_FREE];
+
+    printf("Calls:");
+    for (int i = 0; i < ALLOC_CALL_COUNT; i++) {
+        printf(" %s %lu%s", alloc_call_name((alloc_call_t)i), (unsigned long)profile->calls[i], i + 1 < ALLOC_CALL_COUNT ? "," : "\n");
+    }
+    printf("Requested: ");
+    print_size((double)profile->bytes);
+    printf(" in %lu allocations", (unsigned long)allocations);
+    if (wall_seconds > 0) {
+        printf(" (%.0f/s of wall time)", allocations / wall_seconds);
+    }
+    printf("\nPeak Live: ");
+    print_size((double)profile->peak_live);
+    printf(", Live at Exit: ");
+    print_size((double)profile->live_at_exit);
+    printf("\n");
+    if (profile->merged) {
+        printf("(the target exited without reporting; totals of its %d child process(es), "
+               "peak of the largest)\n", profile->other_processes);
+    } else if (profile->other_processes > 0) {
+        printf("(%d child process(es) of the target also reported; shown: the target only)\n",
+               profile->other_processes);
+    }
+    if (allocations == 0) {
+        return;
+    }
+
+    printf("\nSize Class\tAllocations\t%% Calls\tBytes\n");
+    printf("------------------------------------------------------\n");
+    int top_class = 0;
+    for (int c = 0; c < ALLOC_SIZE_CLASSES; c++) {
+        if (profile->class_count[c] == 0) {
+            continue;
+        }
+        if (profile->class_count[c] > profile->class_count[top_class]) {
+            top_class = c;
+        }
+        if (alloc_class_limit(c) != 0) {
+            printf("<= ");
+            print_size((double)alloc_class_limit(c));
+        } else {
+            printf("> ");
+            print_size((double)alloc_class_limit(c - 1));
+        }
+        printf("\t%-12lu\t%.1f\t", (unsigned long)profile->class_count[c],
+               100.0 * profile->class_count[c] / allocations);
+        print_size((double)profile->class_bytes[c]);
+        printf("\n");
+    }
+
+    uint64_t traced = profile->traced_live;
+    uint64_t short_lived = 0;
+    for (int b = 0; b < ALLOC_LIFE_BUCKETS; b++) {
+        traced += profile->life[b];
+        short_lived += b < ALLOC_SHORT_BUCKETS ? profile->life[b] : 0;
+    }
+    if (traced > 0) {
+        printf("\nLifetime (1 in %lu allocations traced)\tBlocks\t%% Traced\n", (unsigned long)profile->period);
+        printf("------------------------------------------------------\n");
+        for (int b = 0; b < ALLOC_LIFE_BUCKETS; b++) {
+            if (profile->life[b] > 0) {
+                printf("%-16s\t\t\t%lu\t%.1f\n", life_names[b], (unsigned long)profile->life[b],
+                       100.0 * profile->life[b] / traced);
+            }
+        }
+        printf("%-16s\t\t\t%lu\t%.1f\n", "live at exit", (unsigned long)profile->traced_live,
+               100.0 * profile->traced_live / traced);
+    }
+
+    if (profile->num_sites > 0) {
+        printf("\nTop Allocation Sites (estimated from traced allocations)\n");
+        printf("Allocations\tBytes\t\tSite\n");
+        printf("------------------------------------------------------\n");
+        for (size_t s = 0; s < profile->num_sites; s++) {
+            const alloc_site_t *site = &profile->sites[s];
+            printf("%-12lu\t", (unsigned long)(site->count * profile->period));
+            print_size((double)site->bytes * profile->period);
+            printf("\t%s\n", site->text);
+        }
+    }
+
+    // Verdicts: is malloc visible at all, then which replacement fits the pattern
+    // Calls from every thread add up, so they are set against CPU time rather than wall time
+    double busy_seconds = cpu_seconds > 0 ? cpu_seconds : wall_seconds;
+    double share = busy_seconds > 0 ? calls * ALLOC_NS_PER_CALL * 1e-9 / busy_seconds : 0.0;
+    share = share < 1.0 ? share : 1.0;
+    double top_share = (double)profile->class_count[top_class] / allocations;
+    double short_share = traced > 0 ? (double)short_lived / traced : 0.0;
+    printf("\nEstimated allocator time: ~%.1f%% of %s time (at ~%.0f ns per call)\n",
+           share * 100, cpu_seconds > 0 ? "CPU" : "wall", ALLOC_NS_PER_CALL);
+    if (share < ALLOC_VISIBLE_SHARE) {
+        printf("Verdict: allocation is not a visible cost; a custom allocator would not pay off\n");
+        return;
+    }
+    int pool = top_share >= ALLOC_POOL_SHARE && top_class <= ALLOC_POOL_CLASS;
+    int arena = short_share >= ALLOC_ARENA_SHARE;
+    if (pool) {
+        printf("Verdict: pool allocator: %.0f%% of allocations are <= ", top_share * 100);
+        print_size((double)alloc_class_limit(top_class));
+        printf("; a fixed-size free list for that class takes them off malloc\n");
+    }
+    if (arena) {
+        printf("Verdict: arena allocator: %.0f%% of traced blocks are freed within 100 us; "
+               "bump-allocate per request or phase and release in bulk\n", short_share * 100);
+    }
+    if (!pool && !arena) {
+        printf("Verdict: churn without one dominant size or lifetime; start with the top sites "
+               "above (reuse buffers, reserve capacity)\n");
+    }
+}
@@ -0,0 +1,73 @@
+#ifndef ALLOC_PROFILE_H
+#define ALLOC_PROFILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Shared by the profiler and the LD_PRELOAD library it launches the target with
+#define ALLOC_PRELOAD_LIB "liballoc_preload.so"   // Built next to the profiler binary
+#define ALLOC_OUTPUT_ENV "ALLOC_PROFILE_OUTPUT"   // File each process appends its summary to
+#define ALLOC_PERIOD_ENV "ALLOC_PROFILE_PERIOD"   // Mean gap between traced allocations per thread
+#define ALLOC_DEFAULT_PERIOD 256
+
+#define ALLOC_SIZE_CLASSES 24     // <=16 B, <=32 B, ... <=64 MiB, then larger
+#define ALLOC_LIFE_BUCKETS 10     // <100 ns, <1 us, ... <10 s, then longer
+#define ALLOC_TOP_SITES 10
+#define ALLOC_SITE_TEXT 256
+
+typedef enum {
+    ALLOC_MALLOC,
+    ALLOC_CALLOC,
+    ALLOC_REALLOC,
+    ALLOC_MEMALIGN,   // posix_memalign, aligned_alloc, memalign, valloc
+    ALLOC_FREE,
+    ALLOC_CALL_COUNT
+} alloc_call_t;
+
+typedef struct {
+    uint64_t count;               // Traced allocations; multiply by the period for totals
+    uint64_t bytes;
+    char text[ALLOC_SITE_TEXT];   // Caller <- its callers, symbolised where possible
+} alloc_site_t;
+
+// One process's summary, as written by the preload library at exit
+typedef struct {
+    int found;                    // 0 when nothing came back (static binary, exec failed)
+    int other_processes;          // Children of the target that reported too
+    int merged;                   // The target itself did not report (exited via _exit or exec,
+                                  // as shells do); these are its children's totals
+    uint64_t period;
+    uint64_t calls[ALLOC_CALL_COUNT];
+    uint64_t bytes;               // Requested by every allocation call
+    uint64_t peak_live;           // Usable bytes, accurate to a per-thread flush threshold
+    uint64_t live_at_exit;
+    uint64_t class_count[ALLOC_SIZE_CLASSES];
+    uint64_t class_bytes[ALLOC_SIZE_CLASSES];
+    uint64_t life[ALLOC_LIFE_BUCKETS];  // Traced blocks, by time from allocation to free
+    uint64_t traced_live;         // Traced blocks still allocated at exit
+    alloc_site_t sites[ALLOC_TOP_SITES];
+    size_t num_sites;
+} alloc_profile_t;
+
+// Environment the target is launched with, saved to be put back afterwards
+typedef struct {
+    int active;
+    char output[64];
+    char *saved_preload;
+} alloc_session_t;
+
+extern int alloc_profiling;  // Launch profiled programs under the preload library; --alloc=off clears it
+
+const char *alloc_call_name(alloc_call_t call);
+// Upper bound of a size class in bytes; 0 for the last, unbounded one
+size_t alloc_class_limit(int size_class);
+
+// Point LD_PRELOAD at the library for the next exec; -1 if it is not built
+int alloc_profile_begin(alloc_session_t *session);
+// Restore the environment and read back the direct child's summary
+void alloc_profile_end(alloc_session_t *session, alloc_profile_t *profile);
+// Histograms, top call sites, and whether a pool or arena allocator would pay off.
+// Allocator time is weighed against cpu_seconds (all threads), or wall time without it
+void print_alloc_profile(const alloc_profile_t *profile, double wall_seconds, double cpu_seconds);
+
+#endif // ALLOC_PROFILE_H
@@ -0,0 +1,317 @@
+#define _GNU_SOURCE
+#include "antagonist.h"
+#include "chase.h"
+#include "pages.h"
+#include "perf_counters.h"
+#include "profiling.h"
+#include "timing.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <x86intrin.h>
+
+#define ANTAG_CHUNK (64UL * 1024)               // Bytes touched between stop checks
+#define ANTAG_LINE 64
+#define ANTAG_LLC_DEFAULT (32UL * 1024 * 1024)  // When sysconf has no L3 size
+#define ANTAG_DRAM_MIN (64UL * 1024 * 1024)     // Streaming buffer floor, as loaded_latency's
+#define ANTAG_TLB_DEFAULT (256UL * 1024 * 1024) // 64K pages, far past any STLB
+#define ANTAG_PAGE 4096
+
+static const char *const antag_names[ANTAG_KIND_COUNT] = {
+    [ANTAG_NONE] = "none",
+    [ANTAG_LLC] = "llc",
+    [ANTAG_DRAM] = "dram",
+    [ANTAG_TLB] = "tlb",
+};
+
+antag_config_t antagonist = {.kind = ANTAG_NONE};
+
+typedef struct {
+    pthread_barrier_t ready;  // Buffers built; the target can start
+    atomic_int stop;
+    antag_kind_t kind;
+    double bytes_per_cycle;   // DRAM throttle per thread; 0 for flat out
+    bw_kernel_t kernel;
+} antag_control_t;
+
+typedef struct {
+    antag_control_t *ctl;
+    int core;
+    size_t size;
+    int failed;
+    uint64_t bytes;
+    uint64_t cycles;
+} antag_worker_t;
+
+const char *antag_kind_name(antag_kind_t kind) {
+    return kind < ANTAG_KIND_COUNT ? antag_names[kind] : "unknown";
+}
+
+// Size with an optional K/M/G suffix
+static size_t parse_size(const char *text, char **end) {
+    size_t value = strtoull(text, end, 0);
+    switch (**end) {
+    case 'k': case 'K': value <<= 10; (*end)++; break;
+    case 'm': case 'M': value <<= 20; (*end)++; break;
+    case 'g': case 'G': value <<= 30; (*end)++; break;
+    }
+    return value;
+}
+
+static size_t llc_size(void) {
+    long llc = sysconf(_SC_LEVEL3_CACHE_SIZE);
+    return llc > 0 ? (size_t)llc : ANTAG_LLC_DEFAULT;
+}
+
+int antagonist_from_spec(const char *spec, antag_config_t *config) {
+    size_t len = strcspn(spec, ":@");
+    const char *p = spec + len;
+    int kind = ANTAG_LLC;
+
+    memset(config, 0, sizeof(*config));
+    while (kind < ANTAG_KIND_COUNT &&
+           (strlen(antag_names[kind]) != len || strncmp(antag_names[kind], spec, len) != 0)) {
+        kind++;
+    }
+    if (kind == ANTAG_KIND_COUNT) {
+        return -1;
+    }
+    config->kind = (antag_kind_t)kind;
+
+    if (*p == ':') {
+        char *end;
+        if (config->kind == ANTAG_DRAM) {
+            config->gbps = strtod(p + 1, &end);
+        } else {
+            config->footprint = parse_size(p + 1, &end);
+        }
+        if (end == p + 1 || (*end != '\0' && *end != '@') || config->gbps < 0) {
+            return -1;
+        }
+        p = end;
+    }
+    if (config->kind == ANTAG_LLC && config->footprint == 0) {
+        config->footprint = llc_size();
+    } else if (config->kind == ANTAG_TLB && config->footprint == 0) {
+        config->footprint = ANTAG_TLB_DEFAULT;
+    }
+
+    if (*p == '@') {
+        config->num_cores = parse_core_list(p + 1, config->cores, MT_MAX_CORES);
+        return config->num_cores > 0 ? 0 : -1;
+    }
+    if (*p != '\0') {
+        return -1;
+    }
+    // The profiled program is pinned to ANTAG_TARGET_CORE; its neighbours get the rest of the mask
+    size_t count = parse_core_list(NULL, config->cores, MT_MAX_CORES);
+    for (size_t i = 0; i < count; i++) {
+        if (config->cores[i] != ANTAG_TARGET_CORE || count == 1) {
+            config->cores[config->num_cores++] = config->cores[i];
+        }
+    }
+    return config->num_cores > 0 ? 0 : -1;
+}
+
+static void *antagonist_thread(void *arg) {
+    antag_worker_t *worker = arg;
+    antag_control_t *ctl = worker->ctl;
+    page_policy_t policy = ctl->kind == ANTAG_TLB ? PAGE_4K : page_policy;
+    char *buf = NULL;
+    void **head = NULL;
+
+    if (try_set_cpu_affinity(worker->core) != 0) {
+        perror("sched_setaffinity");
+        worker->failed = 1;
+    } else if ((buf = page_alloc(worker->size, policy)) == NULL) {
+        fprintf(stderr, "Failed to allocate %zu byte antagonist buffer\n", worker->size);
+        worker->failed = 1;
+    } else {
+        memset(buf, 1, worker->size);
+        if (ctl->kind == ANTAG_TLB &&
+            (head = chase_build_staggered(buf, worker->size, ANTAG_PAGE, worker->core + 1)) == NULL) {
+            worker->failed = 1;
+        }
+    }
+    pthread_barrier_wait(&ctl->ready);
+
+    uint64_t bytes = 0;
+    size_t offset = 0;
+    uint64_t start = rdtsc_start();
+    while (!worker->failed && !atomic_load_explicit(&ctl->stop, memory_order_relaxed)) {
+        if (ctl->kind == ANTAG_LLC) {
+            // Dirty lines: every eviction the target suffers also costs it a writeback slot
+            for (size_t i = 0; i < ANTAG_CHUNK; i += ANTAG_LINE) {
+                ((volatile char *)buf)[offset + i]++;
+            }
+        } else if (ctl->kind == ANTAG_DRAM) {
+            kernel_op_pass(ctl->kernel, OP_LOAD, NULL, buf + offset, ANTAG_CHUNK, 1);
+        } else {
+            head = chase_walk(head, ANTAG_CHUNK / ANTAG_LINE);
+        }
+        bytes += ANTAG_CHUNK;
+        offset = (offset + ANTAG_CHUNK) % (worker->size / ANTAG_CHUNK * ANTAG_CHUNK);
+
+        if (ctl->bytes_per_cycle > 0) {
+            uint64_t due = start + (uint64_t)(bytes / ctl->bytes_per_cycle);
+            while (__rdtsc() < due && !atomic_load_explicit(&ctl->stop, memory_order_relaxed)) {
+                _mm_pause();
+            }
+        }
+    }
+    worker->cycles = timer_cycles(start, rdtsc_end());
+    worker->bytes = bytes;
+    if (head != NULL) {
+        chase_sink = head;
+    }
+
+    if (buf != NULL) {
+        page_free(buf, worker->size, policy);
+    }
+    return NULL;
+}
+
+static void print_change(const char *name, int ok, double clean, double noisy) {
+    if (!ok) {
+        printf("%-16s\tn/a\t\tn/a\t\t-\n", name);
+    } else if (clean > 0) {
+        printf("%-16s\t%-12.6g\t%-12.6g\t%+.1f%%\n", name, clean, noisy, (noisy / clean - 1) * 100);
+    } else {
+        printf("%-16s\t%-12.6g\t%-12.6g\t-\n", name, clean, noisy);
+    }
+}
+
+static void print_interference(const child_profile_t *clean, const child_profile_t *noisy) {
+    const uint64_t *c = clean->values;
+    const uint64_t *n = noisy->values;
+
+    printf("Metric          \tClean\t\tNoisy\t\tChange\n");
+    printf("------------------------------------------------------------------\n");
+    print_change("Wall Time (s)", 1, clean->wall_seconds, noisy->wall_seconds);
+    for (int i = 0; i < COUNTER_COUNT; i++) {
+        print_change(counter_name((counter_id_t)i), clean->valid[i] && noisy->valid[i], (double)c[i], (double)n[i]);
+    }
+
+    // Rates rather than totals: the noisy run may retire the same work in more cycles
+    int ipc = clean->valid[COUNTER_CYCLES] && clean->valid[COUNTER_INSTRUCTIONS] &&
+              noisy->valid[COUNTER_CYCLES] && noisy->valid[COUNTER_INSTRUCTIONS] &&
+              c[COUNTER_CYCLES] > 0 && n[COUNTER_CYCLES] > 0;
+    print_change("IPC", ipc, ipc ? (double)c[COUNTER_INSTRUCTIONS] / c[COUNTER_CYCLES] : 0,
+                 ipc ? (double)n[COUNTER_INSTRUCTIONS] / n[COUNTER_CYCLES] : 0);
+    int mpki = clean->valid[COUNTER_INSTRUCTIONS] && noisy->valid[COUNTER_INSTRUCTIONS] &&
+               clean->valid[COUNTER_LLC_MISSES] && noisy->valid[COUNTER_LLC_MISSES] &&
+               c[COUNTER_INSTRUCTIONS] > 0 && n[COUNTER_INSTRUCTIONS] > 0;
+    print_change("LLC MPKI", mpki, mpki ? c[COUNTER_LLC_MISSES] * 1000.0 / c[COUNTER_INSTRUCTIONS] : 0,
+                 mpki ? n[COUNTER_LLC_MISSES] * 1000.0 / n[COUNTER_INSTRUCTIONS] : 0);
+}
+
+void measure_interference(char *const argv[], const antag_config_t *config) {
+    double cpu_frequency = get_cpu_frequency();
+    size_t threads = config->num_cores;
+    antag_control_t ctl = {.kind = config->kind, .kernel = kernel_best()};
+    child_profile_t clean, noisy;
+
+    if (config->kind == ANTAG_NONE || threads == 0 || cpu_frequency <= 0) {
+        fprintf(stderr, "Interference needs an antagonist, a core for it and a CPU frequency\n");
+        return;
+    }
+
+    size_t total = config->footprint;
+    if (config->kind == ANTAG_DRAM) {
+        total = 2 * llc_size() > ANTAG_DRAM_MIN ? 2 * llc_size() : ANTAG_DRAM_MIN;
+        ctl.bytes_per_cycle = config->gbps * 1e9 / threads / cpu_frequency;
+    }
+    // Every thread walks whole chunks of its own share
+    size_t share = (total / threads + ANTAG_CHUNK - 1) / ANTAG_CHUNK * ANTAG_CHUNK;
+    if (config->kind == ANTAG_DRAM && share < ANTAG_DRAM_MIN) {
+        share = ANTAG_DRAM_MIN;
+    }
+
+    printf("\n=== Interference: %s", antag_kind_name(config->kind));
+    if (config->kind == ANTAG_DRAM) {
+        printf(config->gbps > 0 ? " at %.2f GB/s" : " flat out", config->gbps);
+    } else {
+        printf(" over %.1f MiB", config->footprint / (1024.0 * 1024.0));
+    }
+    printf(" on %zu core(s):", threads);
+    int shared = 0;
+    for (size_t i = 0; i < threads; i++) {
+        printf(" %d", config->cores[i]);
+        shared |= config->cores[i] == ANTAG_TARGET_CORE;
+    }
+    printf(" ===\nThe program runs pinned to core %d in both runs\n", ANTAG_TARGET_CORE);
+    if (shared) {
+        printf("Note: an antagonist shares the program's core; the slowdown includes time-slicing\n");
+    }
+
+    // Back to back, so the clean run sees the same page cache and frequency state
+    if (run_with_counters(argv, 0, ANTAG_TARGET_CORE, &clean) != 0) {
+        fprintf(stderr, "Failed to start user program\n");
+        return;
+    }
+
+    antag_worker_t *workers = calloc(threads, sizeof(antag_worker_t));
+    pthread_t *tids = calloc(threads, sizeof(pthread_t));
+    if (workers == NULL || tids == NULL) {
+        perror("Failed to allocate antagonist state");
+        free(workers);
+        free(tids);
+        free_child_profile(&clean);
+        return;
+    }
+    pthread_barrier_init(&ctl.ready, NULL, threads + 1);
+    for (size_t t = 0; t < threads; t++) {
+        workers[t].ctl = &ctl;
+        workers[t].core = config->cores[t];
+        workers[t].size = share;
+        // The barrier is sized for every thread, so a missing one would hang the rest
+        if (pthread_create(&tids[t], NULL, antagonist_thread, &workers[t]) != 0) {
+            perror("pthread_create");
+            exit(1);
+        }
+    }
+    pthread_barrier_wait(&ctl.ready);
+
+    int status = run_with_counters(argv, 0, ANTAG_TARGET_CORE, &noisy);
+    atomic_store(&ctl.stop, 1);
+    double achieved = 0.0;
+    size_t failed = 0;
+    for (size_t t = 0; t < threads; t++) {
+        pthread_join(tids[t], NULL);
+        failed += workers[t].failed;
+        if (workers[t].cycles > 0) {
+            achieved += workers[t].bytes / (workers[t].cycles / cpu_frequency);
+        }
+    }
+    pthread_barrier_destroy(&ctl.ready);
+    free(workers);
+    free(tids);
+
+    if (status != 0) {
+        fprintf(stderr, "Failed to start user program\n");
+        free_child_profile(&clean);
+        return;
+    }
+    if (failed > 0) {
+        printf("Note: %zu of %zu antagonist(s) failed to start\n", failed, threads);
+    }
+    printf("Antagonist Traffic: %.2f GB/s (%s kernel)\n", achieved / 1e9,
+           config->kind == ANTAG_DRAM ? kernel_name(ctl.kernel) : "line");
+    if (clean.exit_status != noisy.exit_status) {
+        printf("Note: exit status differs between runs (%d clean, %d noisy)\n",
+               clean.exit_status, noisy.exit_status);
+    }
+    print_interference(&clean, &noisy);
+
+    // One number per service: how much longer it takes beside this neighbour
+    if (clean.wall_seconds > 0) {
+        printf("Sensitivity: %+.1f%% wall time under %s\n",
+               (noisy.wall_seconds / clean.wall_seconds - 1) * 100, antag_kind_name(config->kind));
+    }
+    free_child_profile(&clean);
+    free_child_profile(&noisy);
+}
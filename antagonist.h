@@ -0,0 +1,37 @@
+#ifndef ANTAGONIST_H
+#define ANTAGONIST_H
+
+#include <stddef.h>
+#include "bandwidth_mt.h"
+
+#define ANTAG_TARGET_CORE 0       // The profiled program is pinned here for both runs
+
+// Noisy neighbours run on other cores while a profiled program executes
+typedef enum {
+    ANTAG_NONE,
+    ANTAG_LLC,        // Dirty every line of a footprint, evicting the target's LLC share
+    ANTAG_DRAM,       // Stream past the LLC at a target rate
+    ANTAG_TLB,        // One line per 4 KiB page in random order, missing the STLB
+    ANTAG_KIND_COUNT
+} antag_kind_t;
+
+typedef struct {
+    antag_kind_t kind;
+    size_t footprint;             // LLC/TLB: bytes, split across the threads
+    double gbps;                  // DRAM: total rate, 0 for flat out
+    int cores[MT_MAX_CORES];
+    size_t num_cores;
+} antag_config_t;
+
+extern antag_config_t antagonist;  // Set by --antagonist=; kind ANTAG_NONE when off
+
+const char *antag_kind_name(antag_kind_t kind);
+// Parse "llc[:bytes]", "dram[:GB/s]" or "tlb[:bytes]" with an optional "@core-list";
+// sizes take K/M/G. Without cores every core of the mask but ANTAG_TARGET_CORE. -1 on error
+int antagonist_from_spec(const char *spec, antag_config_t *config);
+
+// Run argv clean, then again beside the antagonists; prints the slowdown and
+// counter deltas as the program's sensitivity to that neighbour
+void measure_interference(char *const argv[], const antag_config_t *config);
+
+#endif // ANTAGONIST_H
@@ -0,0 +1,57 @@
+#define _GNU_SOURCE
+#include "arena.h"
+#include "kernels.h"
+#include "pages.h"
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#ifndef MADV_POPULATE_WRITE
+#define MADV_POPULATE_WRITE 23
+#endif
+
+static char *arena_base = NULL;
+static size_t arena_size = 0;
+static page_policy_t arena_policy = PAGE_DEFAULT;
+
+int arena_reserve(size_t size) {
+    if (arena_base != NULL && size <= arena_size && arena_policy == page_policy) {
+        return 0;
+    }
+    arena_release();
+
+    char *base = page_alloc(size, page_policy);
+    if (base == NULL) {
+        fprintf(stderr, "Failed to reserve %zu byte buffer arena\n", size);
+        return -1;
+    }
+    // Fault everything in now (Linux 5.14+); older kernels fault during the fill below
+    madvise(base, size, MADV_POPULATE_WRITE);
+    arena_fill(base, size);
+
+    arena_base = base;
+    arena_size = size;
+    arena_policy = page_policy;
+    return 0;
+}
+
+void *arena_view(size_t size, size_t offset) {
+    if (arena_reserve(offset + size) != 0) {
+        return NULL;
+    }
+    return arena_base + offset;
+}
+
+void arena_fill(void *buf, size_t size) {
+    size_t bulk = size / 256 * 256;
+    kernel_op_pass(kernel_best(), OP_STORE, buf, NULL, bulk, 1);
+    memset((char *)buf + bulk, 0, size - bulk);
+}
+
+void arena_release(void) {
+    if (arena_base != NULL) {
+        page_free(arena_base, arena_size, arena_policy);
+        arena_base = NULL;
+        arena_size = 0;
+    }
+}
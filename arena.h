@@ -0,0 +1,19 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+// One pre-faulted buffer shared by every single-threaded test, so all of them
+// run on the same physical pages and none pays for page faults in its timing
+
+// Reserve (or grow to) 'size' bytes under page_policy, populated and filled; -1 on failure
+int arena_reserve(size_t size);
+// View of 'size' bytes at 'offset' (offset 0 is page aligned), growing the arena if
+// needed. Growing remaps it and invalidates every earlier view, so sweeps and
+// callers carving sub-buffers reserve their largest span first
+void *arena_view(size_t size, size_t offset);
+// Fill with the widest store kernel this CPU has
+void arena_fill(void *buf, size_t size);
+void arena_release(void);
+
+#endif // ARENA_H
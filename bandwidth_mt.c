@@ -0,0 +1,274 @@
+#define _GNU_SOURCE
+#include "bandwidth_mt.h"
+#include "profiling.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MT_ITERATIONS 10       // Timed passes over each private buffer
+#define MT_SATURATION 0.95     // Fraction of peak that counts as saturated
+
+static const size_t granularities[] = {64, 256, 1024};  // 64B, 256B, 1024B
+static const double ratios[] = {1.0, 0.0, 0.7, 0.5};    // Read: 100%, Write: 0%, 70:30, 50:50
+static const char *ratio_labels[] = {"Read-only", "Write-only", "70:30 (R:W)", "50:50 (R:W)"};
+
+#define NUM_GRANULARITIES (sizeof(granularities) / sizeof(granularities[0]))
+#define NUM_RATIOS (sizeof(ratios) / sizeof(ratios[0]))
+#define NUM_CELLS (NUM_GRANULARITIES * NUM_RATIOS)
+
+// State shared by the controller and all workers of one thread count
+typedef struct {
+    pthread_barrier_t start;   // Cell parameters published
+    pthread_barrier_t go;      // Every worker warmed up
+    pthread_barrier_t done;    // Every worker finished its timed pass
+    bw_kernel_t kernel;
+    size_t total_size;
+    size_t block_size;
+    double read_ratio;
+    int stop;
+} mt_run_t;
+
+typedef struct {
+    mt_run_t *run;
+    int core;
+    int failed;
+    uint64_t start_cycles;
+    uint64_t end_cycles;
+} mt_worker_t;
+
+size_t parse_core_list(const char *spec, int *cores, size_t max_cores) {
+    size_t count = 0;
+
+    if (spec == NULL || *spec == '\0') {
+        cpu_set_t cpu_set;
+        CPU_ZERO(&cpu_set);
+        if (sched_getaffinity(0, sizeof(cpu_set_t), &cpu_set) != 0) {
+            perror("sched_getaffinity");
+            return 0;
+        }
+        for (int i = 0; i < CPU_SETSIZE && count < max_cores; i++) {
+            if (CPU_ISSET(i, &cpu_set)) {
+                cores[count++] = i;
+            }
+        }
+        return count;
+    }
+
+    const char *p = spec;
+    while (*p != '\0' && count < max_cores) {
+        char *end;
+        long first = strtol(p, &end, 10);
+        if (end == p || first < 0) {
+            fprintf(stderr, "Invalid core list: %s\n", spec);
+            return 0;
+        }
+        long last = first;
+        p = end;
+        if (*p == '-') {
+            last = strtol(p + 1, &end, 10);
+            if (end == p + 1 || last < first) {
+                fprintf(stderr, "Invalid core range in: %s\n", spec);
+                return 0;
+            }
+            p = end;
+        }
+        for (long core = first; core <= last && count < max_cores; core++) {
+            cores[count++] = (int)core;
+        }
+        if (*p == ',') {
+            p++;
+        }
+    }
+    return count;
+}
+
+static void *bandwidth_worker(void *arg) {
+    mt_worker_t *worker = arg;
+    mt_run_t *run = worker->run;
+    char *buf = NULL;
+
+    // Pin first so the private buffer is first-touched on the worker's node
+    if (try_set_cpu_affinity(worker->core) != 0) {
+        perror("sched_setaffinity");
+        worker->failed = 1;
+    } else if ((buf = malloc(run->total_size)) == NULL) {
+        perror("Failed to allocate memory");
+        worker->failed = 1;
+    } else {
+        memset(buf, 0, run->total_size);
+    }
+
+    // A failed worker still takes part in every barrier so the others never hang
+    for (;;) {
+        pthread_barrier_wait(&run->start);
+        if (run->stop) {
+            break;
+        }
+        if (!worker->failed) {
+            kernel_block_pass(run->kernel, buf, run->block_size, run->read_ratio, run->total_size, 1);
+        }
+        pthread_barrier_wait(&run->go);
+        if (!worker->failed) {
+            worker->start_cycles = rdtsc_start();
+            kernel_block_pass(run->kernel, buf, run->block_size, run->read_ratio, run->total_size,
+                              MT_ITERATIONS);
+            worker->end_cycles = rdtsc_end();
+        }
+        pthread_barrier_wait(&run->done);
+    }
+
+    free(buf);
+    return NULL;
+}
+
+// Run every grid cell with 'threads' workers; fills aggregate and per-thread GB/s
+static int run_thread_count(const int *cores, size_t threads, size_t total_size,
+                            bw_kernel_t kernel, double cpu_frequency, double *aggregate,
+                            double *per_thread_min, double *per_thread_avg) {
+    mt_run_t run = {.kernel = kernel, .total_size = total_size};
+    mt_worker_t *workers = calloc(threads, sizeof(mt_worker_t));
+    pthread_t *tids = calloc(threads, sizeof(pthread_t));
+    if (workers == NULL || tids == NULL) {
+        perror("Failed to allocate worker state");
+        free(workers);
+        free(tids);
+        return -1;
+    }
+
+    // The controller joins every barrier, hence threads + 1
+    pthread_barrier_init(&run.start, NULL, threads + 1);
+    pthread_barrier_init(&run.go, NULL, threads + 1);
+    pthread_barrier_init(&run.done, NULL, threads + 1);
+
+    for (size_t t = 0; t < threads; t++) {
+        workers[t].run = &run;
+        workers[t].core = cores[t];
+        // Barriers are sized for every worker, so a missing one would hang the rest
+        if (pthread_create(&tids[t], NULL, bandwidth_worker, &workers[t]) != 0) {
+            perror("pthread_create");
+            exit(1);
+        }
+    }
+
+    for (size_t g = 0; g < NUM_GRANULARITIES; g++) {
+        for (size_t r = 0; r < NUM_RATIOS; r++) {
+            size_t cell = g * NUM_RATIOS + r;
+            run.block_size = granularities[g];
+            run.read_ratio = ratios[r];
+
+            pthread_barrier_wait(&run.start);
+            pthread_barrier_wait(&run.go);
+            pthread_barrier_wait(&run.done);
+
+            double bytes_per_thread = (double)(granularities[g] * (total_size / granularities[g]) * MT_ITERATIONS);
+            uint64_t first_start = UINT64_MAX, last_end = 0;
+            double sum = 0.0, min = 0.0;
+            size_t ok = 0;
+            for (size_t t = 0; t < threads; t++) {
+                if (workers[t].failed) {
+                    continue;
+                }
+                if (workers[t].start_cycles < first_start) first_start = workers[t].start_cycles;
+                if (workers[t].end_cycles > last_end) last_end = workers[t].end_cycles;
+                double seconds = timer_cycles(workers[t].start_cycles, workers[t].end_cycles) / cpu_frequency;
+                double gbs = bytes_per_thread / seconds / 1e9;
+                sum += gbs;
+                if (ok == 0 || gbs < min) min = gbs;
+                ok++;
+            }
+
+            // Aggregate is total bytes over the span from first start to last finish
+            double span = ok ? (last_end - first_start) / cpu_frequency : 0.0;
+            aggregate[cell] = span > 0 ? bytes_per_thread * ok / span / 1e9 : 0.0;
+            per_thread_min[cell] = min;
+            per_thread_avg[cell] = ok ? sum / ok : 0.0;
+        }
+    }
+
+    run.stop = 1;
+    pthread_barrier_wait(&run.start);
+    for (size_t t = 0; t < threads; t++) {
+        pthread_join(tids[t], NULL);
+    }
+
+    pthread_barrier_destroy(&run.start);
+    pthread_barrier_destroy(&run.go);
+    pthread_barrier_destroy(&run.done);
+    free(workers);
+    free(tids);
+    return 0;
+}
+
+void measure_bandwidth_scaling(const int *cores, size_t num_cores, size_t total_size,
+                               bw_kernel_t kernel) {
+    double cpu_frequency = get_cpu_frequency();
+    if (num_cores == 0 || cpu_frequency <= 0) {
+        fprintf(stderr, "Bandwidth scaling needs at least one core and a CPU frequency\n");
+        return;
+    }
+
+    // Results indexed [threads - 1][cell]
+    double *aggregate = calloc(num_cores * NUM_CELLS, sizeof(double));
+    double *per_min = calloc(num_cores * NUM_CELLS, sizeof(double));
+    double *per_avg = calloc(num_cores * NUM_CELLS, sizeof(double));
+    if (aggregate == NULL || per_min == NULL || per_avg == NULL) {
+        perror("Failed to allocate result table");
+        free(aggregate);
+        free(per_min);
+        free(per_avg);
+        return;
+    }
+
+    printf("Multi-threaded bandwidth scaling: %zu byte private buffer per thread, %s kernel, cores:",
+           total_size, kernel_name(kernel));
+    for (size_t i = 0; i < num_cores; i++) {
+        printf(" %d", cores[i]);
+    }
+    printf("\n");
+
+    for (size_t threads = 1; threads <= num_cores; threads++) {
+        size_t row = (threads - 1) * NUM_CELLS;
+        if (run_thread_count(cores, threads, total_size, kernel, cpu_frequency,
+                             &aggregate[row], &per_min[row], &per_avg[row]) != 0) {
+            num_cores = threads - 1;
+            break;
+        }
+    }
+
+    printf("Granularity\tRatio\t\tThreads\tPer-thread Min (GB/s)\tPer-thread Avg (GB/s)\tAggregate (GB/s)\n");
+    printf("------------------------------------------------------------------------------------------------------------------\n");
+    for (size_t cell = 0; cell < NUM_CELLS; cell++) {
+        for (size_t threads = 1; threads <= num_cores; threads++) {
+            size_t idx = (threads - 1) * NUM_CELLS + cell;
+            printf(" %zuB\t\t%s\t%zu\t%.2f\t\t\t%.2f\t\t\t%.2f\n",
+                   granularities[cell / NUM_RATIOS], ratio_labels[cell % NUM_RATIOS],
+                   threads, per_min[idx], per_avg[idx], aggregate[idx]);
+        }
+    }
+
+    // Saturation: the fewest threads that already reach MT_SATURATION of peak
+    printf("\nGranularity\tRatio\t\tPeak Aggregate (GB/s)\tSaturates At (Threads)\n");
+    printf("------------------------------------------------------------------------------\n");
+    for (size_t cell = 0; cell < NUM_CELLS; cell++) {
+        double peak = 0.0;
+        for (size_t threads = 1; threads <= num_cores; threads++) {
+            double value = aggregate[(threads - 1) * NUM_CELLS + cell];
+            if (value > peak) peak = value;
+        }
+        size_t saturation = num_cores;
+        for (size_t threads = 1; threads <= num_cores; threads++) {
+            if (aggregate[(threads - 1) * NUM_CELLS + cell] >= peak * MT_SATURATION) {
+                saturation = threads;
+                break;
+            }
+        }
+        printf(" %zuB\t\t%s\t%.2f\t\t\t%zu\n",
+               granularities[cell / NUM_RATIOS], ratio_labels[cell % NUM_RATIOS], peak, saturation);
+    }
+
+    free(aggregate);
+    free(per_min);
+    free(per_avg);
+}
@@ -0,0 +1,16 @@
+#ifndef BANDWIDTH_MT_H
+#define BANDWIDTH_MT_H
+
+#include <stddef.h>
+#include "kernels.h"
+
+#define MT_MAX_CORES 256  // Upper bound on cores in a scaling run
+
+// Parse a core list such as "0,2,4-7"; NULL or "" means the current affinity mask
+size_t parse_core_list(const char *spec, int *cores, size_t max_cores);
+
+// Run the granularity x read-ratio grid on 1..num_cores pinned threads
+void measure_bandwidth_scaling(const int *cores, size_t num_cores, size_t total_size,
+                               bw_kernel_t kernel);
+
+#endif // BANDWIDTH_MT_H
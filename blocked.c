@@ -0,0 +1,400 @@
+#define _GNU_SOURCE
+#include "blocked.h"
+#include "cachesim.h"
+#include "chase.h"
+#include "harness.h"
+#include "pages.h"
+#include "profiling.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#define BLOCKED_DEFAULT_MAX_N 4096
+#define BLOCKED_SWEEP_MAX (64UL * 1024 * 1024)  // Enough for L1/L2 knees without a full DRAM sweep
+#define BLOCKED_FALLBACK_TILE 32                // When neither the OS nor the sweep gave a size
+#define BLOCKED_TOLERANCE 1e-9                  // Relative; blocked matmul sums in another order
+
+static const char *kernel_names[BLOCKED_KERNEL_COUNT] = {"transpose", "matmul", "stencil"};
+
+// A naive matmul is n^3 column walks: a couple of seconds per size is enough trials
+static const bench_config_t blocked_config = {
+    .min_trials = 3,
+    .max_trials = 20,
+    .target_ci = 0.03,
+    .time_budget = 1.0,
+    .min_trial_cycles = 1000000,
+};
+
+typedef struct {
+    blocked_kernel_t kernel;
+    size_t n;
+    size_t tile;             // 0 runs the naive form
+    double *a, *b;           // Inputs (the stencil reads a only)
+    double *out;
+} blocked_ctx_t;
+
+const char *blocked_kernel_name(blocked_kernel_t kernel) {
+    return kernel < BLOCKED_KERNEL_COUNT ? kernel_names[kernel] : "unknown";
+}
+
+void blocked_detect_caches(blocked_caches_t *caches) {
+    cache_config_t configs[SIM_MAX_LEVELS];
+    chase_point_t points[CHASE_MAX_POINTS];
+    cache_level_t levels[CHASE_MAX_LEVELS];
+
+    memset(caches, 0, sizeof(*caches));
+    size_t num_configs = cache_sim_detect(configs, SIM_MAX_LEVELS);
+    size_t largest = 0;
+    for (size_t l = 0; l < num_configs && l < 3; l++) {
+        caches->reported[l] = configs[l].size;
+        largest = configs[l].size > largest ? configs[l].size : largest;
+    }
+
+    // Twice the LLC is past its knee; VMs report host-sized LLCs, so the sweep is capped
+    size_t sweep_max = largest > 0 ? largest * 2 : BLOCKED_SWEEP_MAX;
+    sweep_max = sweep_max < BLOCKED_SWEEP_MAX ? sweep_max : BLOCKED_SWEEP_MAX;
+    sweep_max = sweep_max < chase_dram_size() ? sweep_max : chase_dram_size();
+    size_t num_points = chase_sweep(4096, sweep_max, get_cpu_frequency(), points, CHASE_MAX_POINTS);
+    size_t num_levels = detect_cache_levels(points, num_points, levels, CHASE_MAX_LEVELS);
+
+    for (size_t l = 0; l < num_levels && l < 3; l++) {
+        // A plateau running to the end of the sweep has no knee yet
+        if (strcmp(levels[l].name, "DRAM") == 0 || levels[l].last_size >= points[num_points - 1].size) {
+            break;
+        }
+        caches->knee[l] = levels[l].last_size;
+    }
+
+    for (size_t l = 0; l < 3; l++) {
+        size_t reported = caches->reported[l];
+        size_t knee = caches->knee[l];
+        // The smaller wins: a shared or non-inclusive level holds less than the OS says
+        caches->used[l] = reported == 0 || (knee > 0 && knee < reported) ? knee : reported;
+        if (caches->used[l] > 0) {
+            caches->num_levels = l + 1;
+        }
+    }
+}
+
+static void transpose_naive(const double *a, double *b, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        for (size_t j = 0; j < n; j++) {
+            b[j * n + i] = a[i * n + j];
+        }
+    }
+}
+
+static void transpose_blocked(const double *a, double *b, size_t n, size_t tile) {
+    for (size_t ii = 0; ii < n; ii += tile) {
+        size_t iend = ii + tile < n ? ii + tile : n;
+        for (size_t jj = 0; jj < n; jj += tile) {
+            size_t jend = jj + tile < n ? jj + tile : n;
+            for (size_t i = ii; i < iend; i++) {
+                for (size_t j = jj; j < jend; j++) {
+                    b[j * n + i] = a[i * n + j];
+                }
+            }
+        }
+    }
+}
+
+static void matmul_naive(const double *a, const double *b, double *c, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        for (size_t j = 0; j < n; j++) {
+            double sum = 0.0;
+            for (size_t k = 0; k < n; k++) {
+                sum += a[i * n + k] * b[k * n + j];
+            }
+            c[i * n + j] = sum;
+        }
+    }
+}
+
+// Tiles of i, k and j; inside a tile the i-k-j order streams rows of B and C
+static void matmul_blocked(const double *a, const double *b, double *c, size_t n, size_t tile) {
+    memset(c, 0, n * n * sizeof(double));
+    for (size_t ii = 0; ii < n; ii += tile) {
+        size_t iend = ii + tile < n ? ii + tile : n;
+        for (size_t kk = 0; kk < n; kk += tile) {
+            size_t kend = kk + tile < n ? kk + tile : n;
+            for (size_t jj = 0; jj < n; jj += tile) {
+                size_t jend = jj + tile < n ? jj + tile : n;
+                for (size_t i = ii; i < iend; i++) {
+                    for (size_t k = kk; k < kend; k++) {
+                        double aik = a[i * n + k];
+                        for (size_t j = jj; j < jend; j++) {
+                            c[i * n + j] += aik * b[k * n + j];
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+static inline void stencil_row(const double *in, double *out, size_t n, size_t z, size_t y) {
+    size_t plane = n * n;
+    size_t row = z * plane + y * n;
+    for (size_t x = 1; x < n - 1; x++) {
+        size_t i = row + x;
+        out[i] = 0.4 * in[i] + 0.1 * (in[i - 1] + in[i + 1] + in[i - n] + in[i + n] +
+                                      in[i - plane] + in[i + plane]);
+    }
+}
+
+// Bands of 'tile' rows swept through every plane, so the three planes a row reads stay cached.
+// The naive sweep is the single band, so both forms share one inner loop
+static void stencil_blocked(const double *in, double *out, size_t n, size_t tile) {
+    for (size_t yy = 1; yy < n - 1; yy += tile) {
+        size_t yend = yy + tile < n - 1 ? yy + tile : n - 1;
+        for (size_t z = 1; z < n - 1; z++) {
+            for (size_t y = yy; y < yend; y++) {
+                stencil_row(in, out, n, z, y);
+            }
+        }
+    }
+}
+
+static void blocked_run(const blocked_ctx_t *ctx) {
+    switch (ctx->kernel) {
+    case BLOCKED_TRANSPOSE:
+        if (ctx->tile == 0) {
+            transpose_naive(ctx->a, ctx->out, ctx->n);
+        } else {
+            transpose_blocked(ctx->a, ctx->out, ctx->n, ctx->tile);
+        }
+        break;
+    case BLOCKED_MATMUL:
+        if (ctx->tile == 0) {
+            matmul_naive(ctx->a, ctx->b, ctx->out, ctx->n);
+        } else {
+            matmul_blocked(ctx->a, ctx->b, ctx->out, ctx->n, ctx->tile);
+        }
+        break;
+    case BLOCKED_STENCIL:
+        if (ctx->tile == 0) {
+            stencil_blocked(ctx->a, ctx->out, ctx->n, ctx->n);  // One band: plane after plane
+        } else {
+            stencil_blocked(ctx->a, ctx->out, ctx->n, ctx->tile);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+static void blocked_trial(void *arg, size_t reps) {
+    for (size_t r = 0; r < reps; r++) {
+        blocked_run(arg);
+    }
+}
+
+// Elements per array: n^2, or n^3 for the stencil grid
+static size_t kernel_elements(blocked_kernel_t kernel, size_t n) {
+    return kernel == BLOCKED_STENCIL ? n * n * n : n * n;
+}
+
+// Tile that fits the kernel's working set in the cache level it targets
+static size_t tile_guess(blocked_kernel_t kernel, size_t n, const blocked_caches_t *caches, size_t *unit) {
+    size_t l1 = caches->used[0];
+    size_t l2 = caches->num_levels > 1 ? caches->used[1] : l1;
+    double guess = BLOCKED_FALLBACK_TILE;
+
+    *unit = 8;  // One 64-byte line of doubles
+    switch (kernel) {
+    case BLOCKED_TRANSPOSE:
+        // A source and a destination tile in L1
+        guess = l1 > 0 ? sqrt(l1 / (2.0 * sizeof(double))) : guess;
+        break;
+    case BLOCKED_MATMUL:
+        // Tiles of A, B and C in L2
+        guess = l2 > 0 ? sqrt(l2 / (3.0 * sizeof(double))) : guess;
+        break;
+    case BLOCKED_STENCIL:
+        // Three input planes and the output plane of a band of rows in L2
+        *unit = 1;
+        guess = l2 > 0 ? l2 / (4.0 * n * sizeof(double)) : guess;
+        break;
+    default:
+        break;
+    }
+    size_t tile = (size_t)(guess / *unit) * *unit;
+    tile = tile < *unit ? *unit : tile;
+    return tile < n ? tile : n;
+}
+
+// The guess scaled by 1/4 .. 2, rounded to the unit and clamped to [unit, n]; duplicates dropped
+static size_t tile_candidates(size_t guess, size_t unit, size_t n, size_t *tiles) {
+    static const double scales[BLOCKED_MAX_TILES] = {0.25, 0.5, 0.75, 1.0, 1.5, 2.0};
+    size_t count = 0;
+
+    for (size_t s = 0; s < BLOCKED_MAX_TILES; s++) {
+        size_t tile = (size_t)(guess * scales[s] / unit + 0.5) * unit;
+        tile = tile < unit ? unit : tile;
+        tile = tile < n ? tile : n;
+        if (count == 0 || tiles[count - 1] != tile) {
+            tiles[count++] = tile;
+        }
+    }
+    return count;
+}
+
+static int outputs_match(const double *x, const double *y, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        double scale = fabs(x[i]) > 1.0 ? fabs(x[i]) : 1.0;
+        if (fabs(x[i] - y[i]) > BLOCKED_TOLERANCE * scale) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Milliseconds per call of the kernel as ctx is set up; -1 on failure
+static double time_kernel(blocked_ctx_t *ctx, double cpu_frequency) {
+    double cycles = bench_run(blocked_trial, ctx, &blocked_config, NULL);
+    return cycles < 0 ? -1.0 : cycles / cpu_frequency * 1e3;
+}
+
+// Naive time, the tile search and the check of the winner, on buffers set up by blocked_row
+static void blocked_measure(blocked_ctx_t *ctx, double *ref, const blocked_caches_t *caches,
+                            double cpu_frequency) {
+    size_t elements = kernel_elements(ctx->kernel, ctx->n);
+    size_t bytes = elements * sizeof(double);
+
+    ctx->tile = 0;
+    double naive_ms = time_kernel(ctx, cpu_frequency);
+    memcpy(ref, ctx->out, bytes);
+
+    size_t unit;
+    size_t guess = tile_guess(ctx->kernel, ctx->n, caches, &unit);
+    size_t tiles[BLOCKED_MAX_TILES];
+    size_t num_tiles = tile_candidates(guess, unit, ctx->n, tiles);
+    double guess_ms = -1.0;
+    double best_ms = -1.0;
+    size_t best_tile = 0;
+    for (size_t t = 0; t < num_tiles; t++) {
+        ctx->tile = tiles[t];
+        double ms = time_kernel(ctx, cpu_frequency);
+        if (tiles[t] == guess) {
+            guess_ms = ms;
+        }
+        if (ms > 0 && (best_ms < 0 || ms < best_ms)) {
+            best_ms = ms;
+            best_tile = tiles[t];
+        }
+    }
+    // A winner on the edge of the range may not be the optimum: keep halving or doubling
+    size_t step = best_tile == tiles[0] ? best_tile / 2 / unit * unit
+                : best_tile == tiles[num_tiles - 1] ? best_tile * 2 : 0;
+    while (step >= unit && step <= ctx->n && step != best_tile && best_ms > 0) {
+        ctx->tile = step;
+        double ms = time_kernel(ctx, cpu_frequency);
+        if (ms <= 0 || ms >= best_ms) {
+            break;
+        }
+        best_ms = ms;
+        best_tile = step;
+        step = step < tiles[0] ? step / 2 / unit * unit : step * 2;
+    }
+    if (naive_ms <= 0 || best_ms <= 0) {
+        printf("timing failed\n");
+        return;
+    }
+
+    // The winning tile must compute what the naive loop did
+    ctx->tile = best_tile;
+    memset(ctx->out, 0, bytes);
+    blocked_run(ctx);
+    int match = outputs_match(ref, ctx->out, elements);
+
+    printf("%-12.3f%-8zu%-12.3f%-8zu%-12.3f%.2fx%s\n", naive_ms, guess, guess_ms, best_tile, best_ms,
+           naive_ms / best_ms, match ? "" : "  MISMATCH");
+}
+
+static void blocked_row(blocked_kernel_t kernel, size_t n, const blocked_caches_t *caches, double cpu_frequency) {
+    size_t elements = kernel_elements(kernel, n);
+    size_t bytes = elements * sizeof(double);
+    double *a = page_alloc(bytes, page_policy);
+    double *b = kernel == BLOCKED_MATMUL ? page_alloc(bytes, page_policy) : NULL;
+    double *out = page_alloc(bytes, page_policy);
+    double *ref = page_alloc(bytes, page_policy);
+
+    printf("%-8zu", n);
+    if (a == NULL || out == NULL || ref == NULL || (kernel == BLOCKED_MATMUL && b == NULL)) {
+        printf("allocation failed\n");
+    } else {
+        for (size_t i = 0; i < elements; i++) {
+            a[i] = (double)(i % 1000) / 1000.0;
+            out[i] = 0.0;
+            if (b != NULL) {
+                b[i] = (double)((i * 7) % 1000) / 1000.0;
+            }
+        }
+        blocked_ctx_t ctx = {kernel, n, 0, a, b, out};
+        blocked_measure(&ctx, ref, caches, cpu_frequency);
+    }
+
+    double *buffers[] = {a, b, out, ref};
+    for (size_t i = 0; i < sizeof(buffers) / sizeof(buffers[0]); i++) {
+        if (buffers[i] != NULL) {
+            page_free(buffers[i], bytes, page_policy);
+        }
+    }
+}
+
+static void print_size_kib(size_t bytes) {
+    if (bytes > 0) {
+        printf("%-16zu", bytes / 1024);
+    } else {
+        printf("%-16s", "-");
+    }
+}
+
+void measure_blocked_kernels(size_t max_n) {
+    static const char *guess_rules[BLOCKED_KERNEL_COUNT] = {
+        "T = sqrt(L1 / 16): a source and a destination tile in L1",
+        "T = sqrt(L2 / 24): tiles of A, B and C in L2",
+        "T = L2 / (32 n): four planes of a T-row band in L2",
+    };
+    // Smallest size per kernel, and the divisor of max_n that bounds it
+    static const size_t min_n[BLOCKED_KERNEL_COUNT] = {512, 128, 32};
+    static const size_t max_n_divisor[BLOCKED_KERNEL_COUNT] = {1, 8, 16};
+    double cpu_frequency = get_cpu_frequency();
+    blocked_caches_t caches;
+
+    if (cpu_frequency <= 0) {
+        fprintf(stderr, "Blocked kernels need a CPU frequency\n");
+        return;
+    }
+    if (max_n == 0) {
+        max_n = BLOCKED_DEFAULT_MAX_N;
+    }
+
+    blocked_detect_caches(&caches);
+    printf("Cache sizes (KiB): the smaller of the reported size and the latency knee sets the tiles\n");
+    printf("%-8s%-16s%-16s%s\n", "Level", "Reported", "Latency knee", "Used");
+    printf("--------------------------------------------------\n");
+    for (size_t l = 0; l < 3; l++) {
+        printf("L%-7zu", l + 1);
+        print_size_kib(caches.reported[l]);
+        print_size_kib(caches.knee[l]);
+        print_size_kib(caches.used[l]);
+        printf("\n");
+    }
+
+    for (int k = 0; k < BLOCKED_KERNEL_COUNT; k++) {
+        size_t limit = max_n / max_n_divisor[k];
+        printf("\n=== %s, %s ===\n", kernel_names[k], guess_rules[k]);
+        printf("Best of the guess x 1/4 .. 2, stepping on while an edge tile wins; median ms per call\n");
+        printf("%-8s%-12s%-8s%-12s%-8s%-12s%s\n", "N", "Naive (ms)", "Guess", "Guess (ms)", "Best",
+               "Best (ms)", "Speedup");
+        printf("----------------------------------------------------------------------\n");
+        if (limit < min_n[k]) {
+            printf("skipped: max N %zu is below %zu\n", max_n, min_n[k] * max_n_divisor[k]);
+            continue;
+        }
+        for (size_t n = min_n[k]; n <= limit; n *= 2) {
+            blocked_row((blocked_kernel_t)k, n, &caches, cpu_frequency);
+        }
+    }
+}
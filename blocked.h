@@ -0,0 +1,31 @@
+#ifndef BLOCKED_H
+#define BLOCKED_H
+
+#include <stddef.h>
+
+#define BLOCKED_MAX_TILES 6      // Candidates tried around each cache-derived guess
+
+// Reference kernels, each in a naive and a cache-blocked form
+typedef enum {
+    BLOCKED_TRANSPOSE,   // B = A^T, n x n doubles; the naive form walks B by column
+    BLOCKED_MATMUL,      // C = A * B, n x n doubles; the naive form walks B by column
+    BLOCKED_STENCIL,     // 7-point Jacobi sweep over an n^3 grid of doubles
+    BLOCKED_KERNEL_COUNT
+} blocked_kernel_t;
+
+// Cache sizes the tiles are derived from
+typedef struct {
+    size_t num_levels;
+    size_t reported[3];      // sysconf, falling back to sysfs; 0 if unknown
+    size_t knee[3];          // Last working set on the level's latency plateau; 0 if not found
+    size_t used[3];          // The smaller of the two when both are known
+} blocked_caches_t;
+
+const char *blocked_kernel_name(blocked_kernel_t kernel);
+// L1/L2/L3 from the OS, checked against the knees of a pointer-chase sweep
+void blocked_detect_caches(blocked_caches_t *caches);
+// Naive vs blocked time per size, with the tile auto-tuned around the cache-derived guess.
+// Transpose runs up to max_n (0: 4096), matmul to max_n / 8, the stencil to max_n / 16
+void measure_blocked_kernels(size_t max_n);
+
+#endif // BLOCKED_H
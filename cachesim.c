@@ -0,0 +1,615 @@
+#define _GNU_SOURCE
+#include "cachesim.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define SIM_NONE UINT32_MAX
+#define SIM_PATTERN_ACCESSES (1UL << 26)   // Accesses per built-in pattern run
+#define SIM_PATTERN_BASE 0x10000000UL      // Page-aligned start of synthetic traces
+#define SIM_SEEN_INITIAL (1UL << 16)
+
+static const char *policy_names[REPLACE_COUNT] = {"lru", "fifo", "random"};
+
+// Used only when the machine reports no caches at all
+static const cache_config_t fallback_configs[] = {
+    {32 * 1024, 8, 64, REPLACE_LRU},
+    {1024 * 1024, 16, 64, REPLACE_LRU},
+    {8 * 1024 * 1024, 16, 64, REPLACE_LRU},
+};
+
+const char *replace_policy_name(replace_policy_t policy) {
+    return policy < REPLACE_COUNT ? policy_names[policy] : "unknown";
+}
+
+static inline size_t sim_hash(uint64_t key) {
+    key *= 0x9E3779B97F4A7C15ULL;
+    return (size_t)(key ^ (key >> 29));
+}
+
+static size_t next_pow2(size_t n) {
+    size_t p = 1;
+    while (p < n) {
+        p <<= 1;
+    }
+    return p;
+}
+
+// Size with an optional K/M/G suffix; 0 on error
+static size_t parse_size(const char *text, char **end) {
+    size_t value = strtoull(text, end, 0);
+    switch (**end) {
+    case 'k': case 'K': value <<= 10; (*end)++; break;
+    case 'm': case 'M': value <<= 20; (*end)++; break;
+    case 'g': case 'G': value <<= 30; (*end)++; break;
+    }
+    return value;
+}
+
+static size_t read_sysfs_size(const char *path) {
+    FILE *file = fopen(path, "r");
+    char text[64];
+    char *end;
+    size_t value = 0;
+
+    if (file == NULL) {
+        return 0;
+    }
+    if (fgets(text, sizeof(text), file) != NULL) {
+        value = parse_size(text, &end);
+    }
+    fclose(file);
+    return value;
+}
+
+// sysfs cache indexN of cpu0, skipping instruction caches; 0 if it does not exist
+static int sysfs_cache_config(int index, cache_config_t *config) {
+    char path[128];
+    char type[32] = "";
+
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%d/type", index);
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        return 0;
+    }
+    if (fgets(type, sizeof(type), file) == NULL) {
+        type[0] = '\0';
+    }
+    fclose(file);
+    if (strncmp(type, "Instruction", 11) == 0) {
+        return -1;
+    }
+
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%d/size", index);
+    config->size = read_sysfs_size(path);
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%d/ways_of_associativity", index);
+    config->ways = (unsigned)read_sysfs_size(path);
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%d/coherency_line_size", index);
+    config->line_size = (unsigned)read_sysfs_size(path);
+    config->policy = REPLACE_LRU;
+    return 1;
+}
+
+size_t cache_sim_detect(cache_config_t *configs, size_t max_levels) {
+    static const int sysconf_names[][3] = {
+        {_SC_LEVEL1_DCACHE_SIZE, _SC_LEVEL1_DCACHE_ASSOC, _SC_LEVEL1_DCACHE_LINESIZE},
+        {_SC_LEVEL2_CACHE_SIZE, _SC_LEVEL2_CACHE_ASSOC, _SC_LEVEL2_CACHE_LINESIZE},
+        {_SC_LEVEL3_CACHE_SIZE, _SC_LEVEL3_CACHE_ASSOC, _SC_LEVEL3_CACHE_LINESIZE},
+        {_SC_LEVEL4_CACHE_SIZE, _SC_LEVEL4_CACHE_ASSOC, _SC_LEVEL4_CACHE_LINESIZE},
+    };
+    size_t count = 0;
+
+    for (size_t i = 0; i < sizeof(sysconf_names) / sizeof(sysconf_names[0]) && count < max_levels; i++) {
+        long size = sysconf(sysconf_names[i][0]);
+        long ways = sysconf(sysconf_names[i][1]);
+        long line = sysconf(sysconf_names[i][2]);
+        if (size <= 0 || ways <= 0 || line <= 0) {
+            break;
+        }
+        configs[count++] = (cache_config_t){(size_t)size, (unsigned)ways, (unsigned)line, REPLACE_LRU};
+    }
+
+    if (count == 0) {
+        for (int index = 0; count < max_levels; index++) {
+            int found = sysfs_cache_config(index, &configs[count]);
+            if (found == 0) {
+                break;
+            }
+            if (found > 0 && configs[count].size > 0 && configs[count].ways > 0 && configs[count].line_size > 0) {
+                count++;
+            }
+        }
+    }
+    return count;
+}
+
+size_t parse_cache_config(const char *spec, cache_config_t *configs, size_t max_levels) {
+    const char *p = spec;
+    size_t count = 0;
+
+    while (*p != '\0' && count < max_levels) {
+        cache_config_t *config = &configs[count];
+        char *end;
+
+        config->size = parse_size(p, &end);
+        config->ways = 0;
+        config->line_size = 64;
+        config->policy = REPLACE_LRU;
+        if (*end == '/') {
+            config->ways = (unsigned)strtoul(end + 1, &end, 0);
+        }
+        if (*end == '/') {
+            config->line_size = (unsigned)strtoul(end + 1, &end, 0);
+        }
+        if (*end == '/') {
+            const char *name = end + 1;
+            size_t len = strcspn(name, ",");
+            int policy = -1;
+            for (int r = 0; r < REPLACE_COUNT; r++) {
+                if (strlen(policy_names[r]) == len && strncmp(name, policy_names[r], len) == 0) {
+                    policy = r;
+                }
+            }
+            if (policy < 0) {
+                fprintf(stderr, "Unknown replacement policy in: %s (lru, fifo, random)\n", spec);
+                return 0;
+            }
+            config->policy = (replace_policy_t)policy;
+            end = (char *)name + len;
+        }
+        if (config->size == 0 || config->ways == 0 || (*end != ',' && *end != '\0')) {
+            fprintf(stderr, "Invalid cache config: %s (size/ways[/line[/policy]],...)\n", spec);
+            return 0;
+        }
+        count++;
+        p = *end == ',' ? end + 1 : end;
+    }
+    return count;
+}
+
+static int shadow_init(sim_shadow_t *shadow, size_t capacity) {
+    memset(shadow, 0, sizeof(*shadow));
+    if (capacity == 0 || capacity >= SIM_NONE) {
+        return -1;
+    }
+    size_t num_slots = next_pow2(capacity * 2);
+    shadow->capacity = capacity;
+    shadow->head = shadow->tail = SIM_NONE;
+    shadow->slot_mask = num_slots - 1;
+    shadow->nodes = malloc(capacity * sizeof(sim_node_t));
+    shadow->slots = calloc(num_slots, sizeof(sim_slot_t));
+    if (shadow->nodes == NULL || shadow->slots == NULL) {
+        return -1;
+    }
+    return 0;
+}
+
+static void shadow_free(sim_shadow_t *shadow) {
+    free(shadow->nodes);
+    free(shadow->slots);
+}
+
+static inline void shadow_unlink(sim_shadow_t *shadow, uint32_t node) {
+    uint32_t prev = shadow->nodes[node].prev, next = shadow->nodes[node].next;
+    if (prev != SIM_NONE) shadow->nodes[prev].next = next; else shadow->head = next;
+    if (next != SIM_NONE) shadow->nodes[next].prev = prev; else shadow->tail = prev;
+}
+
+static inline void shadow_push_front(sim_shadow_t *shadow, uint32_t node) {
+    shadow->nodes[node].prev = SIM_NONE;
+    shadow->nodes[node].next = shadow->head;
+    if (shadow->head != SIM_NONE) shadow->nodes[shadow->head].prev = node; else shadow->tail = node;
+    shadow->head = node;
+}
+
+// Linear-probing delete by backward shift, so lookups never need tombstones
+static void shadow_remove_slot(sim_shadow_t *shadow, uint64_t key) {
+    sim_slot_t *slots = shadow->slots;
+    size_t mask = shadow->slot_mask;
+    size_t i = sim_hash(key) & mask;
+
+    while (slots[i].key != key) {
+        i = (i + 1) & mask;
+    }
+    for (size_t j = i;;) {
+        j = (j + 1) & mask;
+        if (slots[j].key == 0) {
+            slots[i].key = 0;
+            return;
+        }
+        size_t home = sim_hash(slots[j].key) & mask;
+        // Move the entry back unless its home lies cyclically in (i, j]
+        int stays = i <= j ? (home > i && home <= j) : (home > i || home <= j);
+        if (!stays) {
+            slots[i] = slots[j];
+            i = j;
+        }
+    }
+}
+
+// Access 'line' in the fully-associative shadow; returns 1 on a hit
+static inline int shadow_access(sim_shadow_t *shadow, uint64_t line) {
+    sim_slot_t *slots = shadow->slots;
+    size_t mask = shadow->slot_mask;
+    uint64_t key = line + 1;
+    size_t i = sim_hash(key) & mask;
+
+    while (slots[i].key != 0) {
+        if (slots[i].key == key) {
+            uint32_t node = slots[i].node;
+            if (shadow->head != node) {
+                shadow_unlink(shadow, node);
+                shadow_push_front(shadow, node);
+            }
+            return 1;
+        }
+        i = (i + 1) & mask;
+    }
+
+    uint32_t node;
+    if (shadow->used < shadow->capacity) {
+        node = (uint32_t)shadow->used++;
+    } else {
+        node = shadow->tail;
+        shadow_unlink(shadow, node);
+        shadow_remove_slot(shadow, shadow->nodes[node].line + 1);
+        // The delete may have shifted entries; find the free slot again
+        for (i = sim_hash(key) & mask; slots[i].key != 0; i = (i + 1) & mask) {
+        }
+    }
+    shadow->nodes[node].line = line;
+    slots[i].key = key;
+    slots[i].node = node;
+    shadow_push_front(shadow, node);
+    return 0;
+}
+
+static int seen_init(sim_seen_t *seen) {
+    seen->mask = SIM_SEEN_INITIAL - 1;
+    seen->used = 0;
+    seen->keys = calloc(SIM_SEEN_INITIAL, sizeof(uint64_t));
+    return seen->keys == NULL ? -1 : 0;
+}
+
+// Record 'line'; returns 1 the first time it is seen
+static int seen_insert(sim_seen_t *seen, uint64_t line) {
+    uint64_t key = line + 1;
+    size_t i = sim_hash(key) & seen->mask;
+
+    while (seen->keys[i] != 0) {
+        if (seen->keys[i] == key) {
+            return 0;
+        }
+        i = (i + 1) & seen->mask;
+    }
+    seen->keys[i] = key;
+
+    // Keep the load under one half
+    if (++seen->used * 2 > seen->mask + 1) {
+        size_t old_size = seen->mask + 1;
+        uint64_t *old_keys = seen->keys;
+        uint64_t *keys = calloc(old_size * 2, sizeof(uint64_t));
+        if (keys == NULL) {
+            perror("Failed to grow compulsory-miss set");
+            exit(1);
+        }
+        seen->keys = keys;
+        seen->mask = old_size * 2 - 1;
+        for (size_t k = 0; k < old_size; k++) {
+            if (old_keys[k] != 0) {
+                size_t j = sim_hash(old_keys[k]) & seen->mask;
+                while (keys[j] != 0) {
+                    j = (j + 1) & seen->mask;
+                }
+                keys[j] = old_keys[k];
+            }
+        }
+        free(old_keys);
+    }
+    return 1;
+}
+
+int cache_sim_init(cache_sim_t *sim, const cache_config_t *configs, size_t num_levels) {
+    memset(sim, 0, sizeof(*sim));
+    if (num_levels == 0 || num_levels > SIM_MAX_LEVELS) {
+        fprintf(stderr, "Cache simulator needs 1 to %d levels\n", SIM_MAX_LEVELS);
+        return -1;
+    }
+
+    for (size_t i = 0; i < num_levels; i++) {
+        const cache_config_t *config = &configs[i];
+        sim_level_t *level = &sim->levels[i];
+
+        if (config->line_size == 0 || (config->line_size & (config->line_size - 1)) != 0 ||
+            config->ways == 0 || config->size < (size_t)config->ways * config->line_size) {
+            fprintf(stderr, "Invalid geometry for level %zu: %zu bytes, %u ways, %u byte lines\n",
+                    i + 1, config->size, config->ways, config->line_size);
+            cache_sim_free(sim);
+            return -1;
+        }
+
+        level->config = *config;
+        level->sets = config->size / ((size_t)config->ways * config->line_size);
+        level->set_mask = (level->sets & (level->sets - 1)) == 0 ? level->sets - 1 : 0;
+        level->line_shift = (unsigned)__builtin_ctz(config->line_size);
+        level->last_line = UINT64_MAX;
+        level->rng = 0x9E3779B97F4A7C15ULL + i;
+        level->tags = calloc(level->sets * config->ways, sizeof(uint64_t));
+        sim->num_levels = i + 1;
+        if (level->tags == NULL || shadow_init(&level->shadow, level->sets * config->ways) != 0 ||
+            seen_init(&level->seen) != 0) {
+            perror("Failed to allocate cache simulator state");
+            cache_sim_free(sim);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void cache_sim_free(cache_sim_t *sim) {
+    for (size_t i = 0; i < sim->num_levels; i++) {
+        free(sim->levels[i].tags);
+        shadow_free(&sim->levels[i].shadow);
+        free(sim->levels[i].seen.keys);
+    }
+    sim->num_levels = 0;
+}
+
+// One access at one level; returns 1 on a hit
+static inline int level_access(sim_level_t *level, uint64_t addr, int is_write) {
+    uint64_t line = addr >> level->line_shift;
+    uint64_t key = line + 1;
+    size_t set = level->set_mask ? (size_t)(line & level->set_mask) : (size_t)(line % level->sets);
+    unsigned ways = level->config.ways;
+    uint64_t *way;
+    unsigned i;
+
+    level->accesses++;
+    level->writes += is_write != 0;
+    // Same line as last time: already most recent everywhere, nothing to update
+    if (line == level->last_line) {
+        level->hits++;
+        return 1;
+    }
+    level->last_line = line;
+
+    way = &level->tags[set * ways];
+    for (i = 0; i < ways; i++) {
+        if (way[i] == key) {
+            break;
+        }
+    }
+    int shadow_hit = shadow_access(&level->shadow, line);
+
+    if (i < ways) {
+        // LRU keeps each set ordered by recency; FIFO and random leave it alone
+        if (level->config.policy == REPLACE_LRU && i > 0) {
+            memmove(way + 1, way, i * sizeof(uint64_t));
+            way[0] = key;
+        }
+        level->hits++;
+        return 1;
+    }
+
+    level->misses++;
+    // A fully-associative hit means the line was seen before, so the set is to blame
+    if (shadow_hit) {
+        level->conflict++;
+    } else if (seen_insert(&level->seen, line)) {
+        level->compulsory++;
+    } else {
+        level->capacity++;
+    }
+
+    if (level->config.policy == REPLACE_RANDOM) {
+        unsigned victim = ways;
+        for (i = 0; i < ways && victim == ways; i++) {
+            if (way[i] == 0) {
+                victim = i;
+            }
+        }
+        if (victim == ways) {
+            level->rng ^= level->rng << 13;
+            level->rng ^= level->rng >> 7;
+            level->rng ^= level->rng << 17;
+            victim = (unsigned)(level->rng % ways);
+        }
+        way[victim] = key;
+    } else {
+        memmove(way + 1, way, (ways - 1) * sizeof(uint64_t));
+        way[0] = key;
+    }
+    return 0;
+}
+
+void cache_sim_access(cache_sim_t *sim, uint64_t addr, int is_write) {
+    for (size_t i = 0; i < sim->num_levels; i++) {
+        if (level_access(&sim->levels[i], addr, is_write)) {
+            return;
+        }
+    }
+}
+
+static void print_count(uint64_t count, uint64_t misses) {
+    printf("\t%llu (%.1f%%)", (unsigned long long)count, misses ? 100.0 * count / misses : 0.0);
+}
+
+void cache_sim_report(const cache_sim_t *sim) {
+    printf("Level\tSize (KB)\tWays\tLine\tPolicy\tAccesses\tHit Rate\tMisses\t\tCompulsory\tCapacity\tConflict\n");
+    printf("----------------------------------------------------------------------------------------------------------------------------------\n");
+    for (size_t i = 0; i < sim->num_levels; i++) {
+        const sim_level_t *level = &sim->levels[i];
+        printf("L%zu\t%zu\t\t%u\t%u\t%s\t%llu\t%.2f%%\t\t%llu",
+               i + 1, level->config.size / 1024, level->config.ways, level->config.line_size,
+               replace_policy_name(level->config.policy), (unsigned long long)level->accesses,
+               level->accesses ? 100.0 * level->hits / level->accesses : 0.0,
+               (unsigned long long)level->misses);
+        print_count(level->compulsory, level->misses);
+        print_count(level->capacity, level->misses);
+        print_count(level->conflict, level->misses);
+        printf("\n");
+    }
+}
+
+// Built-in traces shaped like the tool's own kernels; 0 accesses if unknown
+static uint64_t simulate_pattern(cache_sim_t *sim, const char *pattern, size_t size) {
+    uint64_t accesses = 0;
+
+    if (strcmp(pattern, "seq") == 0) {
+        // 8-byte loads front to back, as the scalar64 read kernel issues them
+        size_t per_pass = size / 8;
+        size_t passes = per_pass ? (SIM_PATTERN_ACCESSES + per_pass - 1) / per_pass : 0;
+        for (size_t pass = 0; pass < passes; pass++) {
+            for (size_t offset = 0; offset < per_pass * 8; offset += 8) {
+                cache_sim_access(sim, SIM_PATTERN_BASE + offset, 0);
+            }
+        }
+        accesses = (uint64_t)passes * per_pass;
+    } else if (strcmp(pattern, "stride4k") == 0) {
+        // One line per 4 KiB page: every access maps to the same L1 set
+        size_t per_pass = size / 4096;
+        size_t passes = per_pass ? (SIM_PATTERN_ACCESSES + per_pass - 1) / per_pass : 0;
+        for (size_t pass = 0; pass < passes; pass++) {
+            for (size_t offset = 0; offset < per_pass * 4096; offset += 4096) {
+                cache_sim_access(sim, SIM_PATTERN_BASE + offset, 0);
+            }
+        }
+        accesses = (uint64_t)passes * per_pass;
+    } else if (strcmp(pattern, "chase") == 0) {
+        // One random cycle over every line, as the pointer chase walks it
+        size_t lines = size / 64;
+        uint32_t *order = malloc(lines * sizeof(uint32_t));
+        if (lines == 0 || order == NULL) {
+            free(order);
+            return 0;
+        }
+        uint64_t state = 0x2545F4914F6CDD1DULL;
+        for (size_t i = 0; i < lines; i++) {
+            order[i] = (uint32_t)i;
+        }
+        for (size_t i = lines - 1; i > 0; i--) {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            size_t j = state % (i + 1);
+            uint32_t tmp = order[i];
+            order[i] = order[j];
+            order[j] = tmp;
+        }
+        size_t passes = (SIM_PATTERN_ACCESSES + lines - 1) / lines;
+        for (size_t pass = 0; pass < passes; pass++) {
+            for (size_t i = 0; i < lines; i++) {
+                cache_sim_access(sim, SIM_PATTERN_BASE + (uint64_t)order[i] * 64, 0);
+            }
+        }
+        accesses = (uint64_t)passes * lines;
+        free(order);
+    }
+    return accesses;
+}
+
+// Trace file: "<op> <hex addr>[,size]" (op R/W or Valgrind lackey L/S/M; I is skipped)
+// or a bare hex address; returns the number of data accesses, -1 if it cannot be read
+static int64_t simulate_trace_file(cache_sim_t *sim, const char *path) {
+    FILE *file = fopen(path, "r");
+    char line[256];
+    int64_t accesses = 0;
+
+    if (file == NULL) {
+        perror(path);
+        return -1;
+    }
+    while (fgets(line, sizeof(line), file) != NULL) {
+        char *p = line;
+        char op = 'R';
+        while (*p == ' ' || *p == '\t') {
+            p++;
+        }
+        if (isalpha((unsigned char)p[0]) && (p[1] == ' ' || p[1] == '\t')) {
+            op = (char)toupper((unsigned char)p[0]);
+            p += 2;
+        }
+        if (!isxdigit((unsigned char)*p) && *p != ' ') {
+            continue;  // Comments and tool banners such as "==123=="
+        }
+
+        char *end;
+        uint64_t addr = strtoull(p, &end, 16);
+        if (end == p) {
+            continue;
+        }
+        switch (op) {
+        case 'R': case 'L':
+            cache_sim_access(sim, addr, 0);
+            accesses++;
+            break;
+        case 'W': case 'S':
+            cache_sim_access(sim, addr, 1);
+            accesses++;
+            break;
+        case 'M':
+            cache_sim_access(sim, addr, 0);
+            cache_sim_access(sim, addr, 1);
+            accesses += 2;
+            break;
+        default:
+            break;  // Instruction fetches and unknown records
+        }
+    }
+    fclose(file);
+    return accesses;
+}
+
+void measure_cache_sim(const char *source, size_t size, const char *config_spec) {
+    cache_config_t configs[SIM_MAX_LEVELS];
+    cache_sim_t sim;
+    struct timespec start, end;
+    int64_t accesses;
+    size_t num_levels;
+
+    if (config_spec != NULL) {
+        num_levels = parse_cache_config(config_spec, configs, SIM_MAX_LEVELS);
+        if (num_levels == 0) {
+            return;
+        }
+    } else {
+        num_levels = cache_sim_detect(configs, SIM_MAX_LEVELS);
+        if (num_levels == 0) {
+            num_levels = sizeof(fallback_configs) / sizeof(fallback_configs[0]);
+            memcpy(configs, fallback_configs, sizeof(fallback_configs));
+        }
+    }
+    if (cache_sim_init(&sim, configs, num_levels) != 0) {
+        return;
+    }
+    if (size == 0) {
+        size = num_levels > 1 ? configs[1].size : 4 * configs[0].size;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int is_pattern = strcmp(source, "seq") == 0 || strcmp(source, "stride4k") == 0 ||
+                     strcmp(source, "chase") == 0;
+    if (is_pattern) {
+        printf("Cache simulation: %s pattern over %zu bytes\n", source, size);
+        accesses = (int64_t)simulate_pattern(&sim, source, size);
+        if (accesses == 0) {
+            fprintf(stderr, "Working set of %zu bytes is too small for the %s pattern\n", size, source);
+            accesses = -1;
+        }
+    } else {
+        printf("Cache simulation: trace %s\n", source);
+        accesses = simulate_trace_file(&sim, source);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    if (accesses >= 0) {
+        double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+        cache_sim_report(&sim);
+        printf("Simulated %lld accesses in %.2f s (%.1f M accesses/s)\n",
+               (long long)accesses, seconds, seconds > 0 ? accesses / seconds / 1e6 : 0.0);
+    }
+    cache_sim_free(&sim);
+}
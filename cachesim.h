@@ -0,0 +1,88 @@
+#ifndef CACHESIM_H
+#define CACHESIM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SIM_MAX_LEVELS 4         // Upper bound on simulated cache levels
+
+typedef enum {
+    REPLACE_LRU,
+    REPLACE_FIFO,
+    REPLACE_RANDOM,
+    REPLACE_COUNT
+} replace_policy_t;
+
+// Geometry of one simulated level; sets = size / (ways * line_size)
+typedef struct {
+    size_t size;
+    unsigned ways;
+    unsigned line_size;          // Power of two
+    replace_policy_t policy;
+} cache_config_t;
+
+// Recency-list node of the shadow cache
+typedef struct {
+    uint64_t line;
+    uint32_t prev, next;
+} sim_node_t;
+
+// Hash slot: the line is kept next to its node so a probe touches one array
+typedef struct {
+    uint64_t key;                // Line address + 1, 0 is empty
+    uint32_t node;
+} sim_slot_t;
+
+// Fully-associative LRU cache of the same capacity, used to split capacity from conflict misses
+typedef struct {
+    size_t capacity;             // Lines
+    size_t used;
+    sim_node_t *nodes;           // Recency list, head is most recent
+    uint32_t head, tail;
+    sim_slot_t *slots;           // Open-addressed, linear probing
+    size_t slot_mask;
+} sim_shadow_t;
+
+// Every line a level has ever seen, for compulsory misses
+typedef struct {
+    uint64_t *keys;              // Line address + 1, 0 is empty
+    size_t mask;
+    size_t used;
+} sim_seen_t;
+
+typedef struct {
+    cache_config_t config;
+    size_t sets;
+    size_t set_mask;             // sets - 1 when sets is a power of two, else 0
+    unsigned line_shift;
+    uint64_t last_line;          // Most recent line, resident in both the cache and the shadow
+    uint64_t *tags;              // sets x ways, line address + 1, most recent first
+    uint64_t rng;
+    sim_shadow_t shadow;
+    sim_seen_t seen;
+    uint64_t accesses, writes, hits, misses;
+    uint64_t compulsory, capacity, conflict;
+} sim_level_t;
+
+// Non-inclusive hierarchy: a miss at one level is an access at the next
+typedef struct {
+    size_t num_levels;
+    sim_level_t levels[SIM_MAX_LEVELS];
+} cache_sim_t;
+
+const char *replace_policy_name(replace_policy_t policy);
+// Data/unified caches of this machine from sysconf, falling back to sysfs
+size_t cache_sim_detect(cache_config_t *configs, size_t max_levels);
+// Parse "48K/12/64/lru,2M/16,32M/16/64/random" (size/ways[/line[/policy]]); 0 on error
+size_t parse_cache_config(const char *spec, cache_config_t *configs, size_t max_levels);
+
+int cache_sim_init(cache_sim_t *sim, const cache_config_t *configs, size_t num_levels);
+void cache_sim_free(cache_sim_t *sim);
+void cache_sim_access(cache_sim_t *sim, uint64_t addr, int is_write);
+void cache_sim_report(const cache_sim_t *sim);
+
+// Simulate a built-in pattern ("seq", "stride4k", "chase") over 'size' bytes, or a
+// trace file ("R|W|L|S|M <hex addr>[,size]" or a bare hex address per line)
+void measure_cache_sim(const char *source, size_t size, const char *config_spec);
+
+#endif // CACHESIM_H
@@ -0,0 +1,472 @@
+#define _GNU_SOURCE
+#include "chase.h"
+#include "profiling.h"
+#include "pages.h"
+#include "arena.h"
+#include "events.h"
+#include "evict.h"
+#include <x86intrin.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define CHASE_MIN_LOADS (1UL << 20)   // Enough loads to amortize the rdtsc pair
+#define CHASE_MAX_LOADS (1UL << 23)   // Keeps DRAM-sized points under a second
+#define PLATEAU_STEP 1.12             // Max growth between neighbours on a plateau
+#define PLATEAU_SPAN 1.35             // Max growth across a whole plateau
+#define LEVEL_MERGE 1.20              // Adjacent plateaus closer than this are one level
+#define CHASE_TRIALS 4                // Timed laps per point; the fastest one is kept
+
+void **volatile chase_sink;  // Keeps the final pointer of every walk alive
+
+static uint64_t xorshift64(uint64_t *state) {
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *state = x;
+    return x;
+}
+
+// Line offset of slot k inside its stride: a multiplicative hash spreads the
+// slots over all cache sets instead of piling page-sized strides onto a few
+static size_t stagger_offset(size_t slot, size_t lines_per_stride) {
+    return (size_t)(((uint64_t)slot * 0x9E3779B97F4A7C15ULL) >> 32) % lines_per_stride * CHASE_STRIDE;
+}
+
+// Shuffled single-cycle chain over size / stride slots; with 'stagger' each
+// slot's element sits at a hashed line offset within its stride
+static void **build_chain(void *buf, size_t size, size_t stride, uint64_t seed, int stagger) {
+    size_t lines = size / stride;
+    size_t lines_per_stride = stride / CHASE_STRIDE;
+    if (lines == 0) {
+        return NULL;
+    }
+
+    size_t *order = malloc(lines * sizeof(size_t));
+    if (order == NULL) {
+        perror("Failed to allocate chase order");
+        return NULL;
+    }
+    for (size_t i = 0; i < lines; i++) {
+        order[i] = i;
+    }
+
+    // Fisher-Yates shuffle of the visiting order; linking it end to end gives
+    // a single cycle through every line, so no line is revisited early
+    uint64_t state = seed ? seed : 0x9E3779B97F4A7C15ULL;
+    for (size_t i = lines - 1; i > 0; i--) {
+        size_t j = (size_t)(xorshift64(&state) % (i + 1));
+        size_t tmp = order[i];
+        order[i] = order[j];
+        order[j] = tmp;
+    }
+
+    char *base = (char *)buf;
+    for (size_t i = 0; i < lines; i++) {
+        size_t from_slot = order[i], to_slot = order[(i + 1) % lines];
+        size_t from_off = stagger && lines_per_stride ? stagger_offset(from_slot, lines_per_stride) : 0;
+        size_t to_off = stagger && lines_per_stride ? stagger_offset(to_slot, lines_per_stride) : 0;
+        void **from = (void **)(base + from_slot * stride + from_off);
+        *from = base + to_slot * stride + to_off;
+    }
+
+    size_t head_off = stagger && lines_per_stride ? stagger_offset(order[0], lines_per_stride) : 0;
+    void **head = (void **)(base + order[0] * stride + head_off);
+    free(order);
+    return head;
+}
+
+void **chase_build(void *buf, size_t size, size_t stride, uint64_t seed) {
+    return build_chain(buf, size, stride, seed, 0);
+}
+
+void **chase_build_staggered(void *buf, size_t size, size_t stride, uint64_t seed) {
+    return build_chain(buf, size, stride, seed, 1);
+}
+
+#define CHASE_STEP p = (void **)*p;
+
+void **chase_walk(void **head, size_t loads) {
+    void **p = head;
+    for (size_t i = 0; i < loads; i += CHASE_UNROLL) {
+        // 16 dependent loads: each address comes from the previous load
+        CHASE_STEP CHASE_STEP CHASE_STEP CHASE_STEP
+        CHASE_STEP CHASE_STEP CHASE_STEP CHASE_STEP
+        CHASE_STEP CHASE_STEP CHASE_STEP CHASE_STEP
+        CHASE_STEP CHASE_STEP CHASE_STEP CHASE_STEP
+    }
+    return p;
+}
+
+size_t chase_dram_size(void) {
+    // Well past the LLC, but never more than a quarter of RAM
+    long llc = sysconf(_SC_LEVEL3_CACHE_SIZE);
+    size_t size = llc > 0 ? (size_t)llc * 4 : 256UL * 1024 * 1024;
+    if (size < 64UL * 1024 * 1024) size = 64UL * 1024 * 1024;
+    if (size > get_memory_size() / 4) size = get_memory_size() / 4;
+    return size;
+}
+
+double chase_head_cycles(void **head, size_t lines) {
+    size_t loads = lines * 2;
+    if (loads < CHASE_MIN_LOADS) loads = CHASE_MIN_LOADS;
+    if (loads > CHASE_MAX_LOADS) loads = CHASE_MAX_LOADS;
+    loads = (loads + CHASE_UNROLL - 1) / CHASE_UNROLL * CHASE_UNROLL;
+
+    // Warm-up: one full lap brings the working set into the hierarchy
+    size_t warm = lines < CHASE_MAX_LOADS ? lines : CHASE_MAX_LOADS;
+    head = chase_walk(head, (warm + CHASE_UNROLL - 1) / CHASE_UNROLL * CHASE_UNROLL);
+
+    // Keep the fastest trial: interrupts and migrations only ever add time
+    size_t trial_loads = (loads / CHASE_TRIALS + CHASE_UNROLL - 1) / CHASE_UNROLL * CHASE_UNROLL;
+    uint64_t best = UINT64_MAX;
+    for (int trial = 0; trial < CHASE_TRIALS; trial++) {
+        _mm_mfence();
+        uint64_t start = timer_start();
+        head = chase_walk(head, trial_loads);
+        uint64_t cycles = timer_cycles(start, timer_stop());
+        if (cycles < best) {
+            best = cycles;
+        }
+    }
+    chase_sink = head;
+
+    return (double)best / trial_loads;
+}
+
+// Cold mode: each trial walks at most one lap right after the buffer is evicted,
+// so every timed load is a first touch served from memory
+static double chase_cold_cycles(void *buf, size_t size, void **head) {
+    size_t lines = size / CHASE_STRIDE;
+    size_t loads = lines < CHASE_MAX_LOADS / CHASE_TRIALS ? lines : CHASE_MAX_LOADS / CHASE_TRIALS;
+    loads = loads / CHASE_UNROLL * CHASE_UNROLL;
+    if (loads == 0) {
+        loads = CHASE_UNROLL;
+    }
+
+    uint64_t best = UINT64_MAX;
+    for (int trial = 0; trial < CHASE_TRIALS; trial++) {
+        evict_buffer(buf, size);
+        uint64_t start = timer_start();
+        head = chase_walk(head, loads);
+        uint64_t cycles = timer_cycles(start, timer_stop());
+        if (cycles < best) {
+            best = cycles;
+        }
+    }
+    chase_sink = head;
+
+    return (double)best / loads;
+}
+
+double chase_buffer_cycles(void *buf, size_t size) {
+    void **head = chase_build(buf, size, CHASE_STRIDE, size);
+    if (head == NULL) {
+        return -1.0;
+    }
+    if (cold_mode != EVICT_OFF) {
+        return chase_cold_cycles(buf, size, head);
+    }
+    return chase_head_cycles(head, size / CHASE_STRIDE);
+}
+
+double chase_latency_cycles(size_t size) {
+    void *buf = size >= CHASE_STRIDE * 2 ? arena_view(size, 0) : NULL;
+    if (buf == NULL) {
+        fprintf(stderr, "Failed to allocate %zu byte chase buffer\n", size);
+        return -1.0;
+    }
+    return chase_buffer_cycles(buf, size);
+}
+
+size_t chase_sweep(size_t min_size, size_t max_size, double cpu_freq,
+                   chase_point_t *points, size_t max_points) {
+    size_t count = 0;
+
+    // One mapping for the whole sweep: growing the arena per size would remap it each time
+    if (arena_reserve(max_size) != 0) {
+        return 0;
+    }
+
+    // Powers of two plus the 1.5x midpoints give enough resolution to place knees
+    for (size_t pow2 = min_size; pow2 <= max_size && count < max_points; pow2 *= 2) {
+        size_t candidates[2] = {pow2, pow2 + pow2 / 2};
+        for (size_t c = 0; c < 2 && count < max_points; c++) {
+            if (candidates[c] > max_size) {
+                break;
+            }
+            double cycles = chase_latency_cycles(candidates[c]);
+            if (cycles < 0) {
+                return count;
+            }
+            points[count].size = candidates[c];
+            points[count].cycles_per_load = cycles;
+            points[count].ns_per_load = cpu_freq > 0 ? cycles * 1e9 / cpu_freq : 0.0;
+            count++;
+        }
+    }
+    return count;
+}
+
+size_t detect_cache_levels(const chase_point_t *points, size_t num_points,
+                           cache_level_t *levels, size_t max_levels) {
+    size_t num_levels = 0;
+    size_t run_start = 0;
+    if (max_levels > CHASE_MAX_LEVELS) {
+        max_levels = CHASE_MAX_LEVELS;
+    }
+
+    // Split the curve into runs of nearly flat latency; the points between
+    // runs are the transition (knee) region and belong to no level
+    for (size_t i = 1; i <= num_points && num_levels < max_levels; i++) {
+        int extends = i < num_points &&
+            points[i].cycles_per_load < points[i - 1].cycles_per_load * PLATEAU_STEP &&
+            points[i].cycles_per_load < points[run_start].cycles_per_load * PLATEAU_SPAN;
+        if (extends) {
+            continue;
+        }
+
+        size_t run_len = i - run_start;
+        // Single-point runs are transitions, except at the very end of the sweep
+        if (run_len >= 2 || i == num_points) {
+            double sum = 0.0, sum_ns = 0.0;
+            for (size_t k = run_start; k < i; k++) {
+                sum += points[k].cycles_per_load;
+                sum_ns += points[k].ns_per_load;
+            }
+            double mean = sum / run_len;
+
+            cache_level_t *prev = num_levels ? &levels[num_levels - 1] : NULL;
+            if (prev && mean < prev->cycles_per_load * LEVEL_MERGE) {
+                // Noise split one plateau in two: extend the previous level
+                prev->last_size = points[i - 1].size;
+            } else {
+                cache_level_t *level = &levels[num_levels++];
+                level->first_size = points[run_start].size;
+                level->last_size = points[i - 1].size;
+                level->cycles_per_load = mean;
+                level->ns_per_load = sum_ns / run_len;
+            }
+        }
+        run_start = i;
+    }
+
+    // Name the plateaus; the last one is DRAM when the sweep went past the LLC
+    // or found more plateaus than the OS reports cache levels (VMs often
+    // report a host-sized LLC the guest never sees)
+    static const char *names[CHASE_MAX_LEVELS] = {"L1", "L2", "L3", "L4", "L5", "L6"};
+    long llc = sysconf(_SC_LEVEL3_CACHE_SIZE);
+    size_t known_levels = 3;
+    if (llc <= 0) {
+        llc = sysconf(_SC_LEVEL2_CACHE_SIZE);
+        known_levels = 2;
+    }
+    for (size_t i = 0; i < num_levels; i++) {
+        int is_last = num_levels > 1 && i == num_levels - 1;
+        int past_llc = llc > 0 && levels[i].last_size > (size_t)llc;
+        levels[i].name = is_last && (past_llc || i >= known_levels) ? "DRAM" : names[i];
+    }
+    return num_levels;
+}
+
+// Active-set event counts per dependent load for one working set; 0 if none counted
+static int chase_event_counts(size_t size, double *values) {
+    event_set_t *set = event_active();
+    void *buf = set != NULL ? arena_view(size, 0) : NULL;
+    void **head = buf != NULL ? chase_build(buf, size, CHASE_STRIDE, size) : NULL;
+    if (head == NULL) {
+        return 0;
+    }
+    size_t lines = size / CHASE_STRIDE;
+    size_t loads = (CHASE_MIN_LOADS + CHASE_UNROLL - 1) / CHASE_UNROLL * CHASE_UNROLL;
+    head = chase_walk(head, (lines + CHASE_UNROLL - 1) / CHASE_UNROLL * CHASE_UNROLL);  // Warm-up lap
+
+    if (event_set_start(set) != 0) {
+        return 0;
+    }
+    chase_sink = chase_walk(head, loads);
+    if (event_set_stop(set, values) != 0) {
+        return 0;
+    }
+    for (int e = 0; e < EVENT_COUNT; e++) {
+        values[e] /= loads;
+    }
+    return 1;
+}
+
+void measure_latency_hierarchy(size_t max_size) {
+    chase_point_t points[CHASE_MAX_POINTS];
+    cache_level_t levels[CHASE_MAX_LEVELS];
+    double cpu_freq = get_cpu_frequency();
+
+    if (max_size == 0) {
+        max_size = chase_dram_size();
+    }
+
+    printf("Pointer-chase latency sweep (%d B stride, random cyclic order%s)\n", CHASE_STRIDE,
+           cold_mode != EVICT_OFF ? ", cold: evicted before every lap" : "");
+    printf("Working Set (Bytes)\tLatency (ns)\tLatency (Cycles)");
+    event_print_header();
+    printf("\n");
+    printf("---------------------------------------------------------------\n");
+
+    size_t num_points = chase_sweep(4096, max_size, cpu_freq, points, CHASE_MAX_POINTS);
+    for (size_t i = 0; i < num_points; i++) {
+        double values[EVENT_COUNT];
+        int counted = chase_event_counts(points[i].size, values);
+        printf("%-20zu\t%-12.2f\t%-12.2f",
+               points[i].size, points[i].ns_per_load, points[i].cycles_per_load);
+        // Each dependent load reads one 8-byte pointer
+        event_print_row(counted ? values : NULL, sizeof(void *), 1.0);
+        printf("\n");
+    }
+
+    size_t num_levels = detect_cache_levels(points, num_points, levels, CHASE_MAX_LEVELS);
+    printf("\nDetected Level\tWorking Set Range (Bytes)\tLatency (ns)\tLatency (Cycles)\n");
+    printf("---------------------------------------------------------------\n");
+    for (size_t i = 0; i < num_levels; i++) {
+        printf("%-8s\t%zu - %-20zu\t%-12.2f\t%-12.2f\n", levels[i].name,
+               levels[i].first_size, levels[i].last_size,
+               levels[i].ns_per_load, levels[i].cycles_per_load);
+    }
+}
+
+// Lockstep walk of 'chains' independent chains; with chains a compile-time
+// constant at every call site the inner loop unrolls and p[] lives in registers
+static inline __attribute__((always_inline))
+void mlp_walk_n(void ***heads, size_t steps, const size_t chains, const int dirty) {
+    void **p[MLP_MAX_CHAINS];
+    for (size_t c = 0; c < chains; c++) {
+        p[c] = heads[c];
+    }
+    for (size_t s = 0; s < steps; s++) {
+        for (size_t c = 0; c < chains; c++) {
+            void **next = (void **)*p[c];
+            if (dirty) {
+                p[c][1] = next;  // Second word of the line: dirties it, chain untouched
+            }
+            p[c] = next;
+        }
+    }
+    for (size_t c = 0; c < chains; c++) {
+        heads[c] = p[c];
+    }
+}
+
+#define MLP_CASE(n) case n: \
+    if (dirty) mlp_walk_n(heads, steps, n, 1); else mlp_walk_n(heads, steps, n, 0); break;
+
+void mlp_walk(void ***heads, size_t chains, size_t steps, int dirty) {
+    switch (chains) {
+    MLP_CASE(1)  MLP_CASE(2)  MLP_CASE(3)  MLP_CASE(4)
+    MLP_CASE(5)  MLP_CASE(6)  MLP_CASE(7)  MLP_CASE(8)
+    MLP_CASE(9)  MLP_CASE(10) MLP_CASE(11) MLP_CASE(12)
+    MLP_CASE(13) MLP_CASE(14) MLP_CASE(15) MLP_CASE(16)
+    MLP_CASE(20) MLP_CASE(24) MLP_CASE(28) MLP_CASE(32)
+    default:
+        // Uncommon counts: groups of up to 16 walked one after another, so
+        // overlap only exists within a group
+        for (size_t done = 0; done < chains; ) {
+            size_t n = chains - done > 16 ? 16 : chains - done;
+            mlp_walk(heads + done, n, steps, dirty);
+            done += n;
+        }
+        break;
+    }
+}
+
+int mlp_build(void *buf, size_t size, size_t stride, size_t chains, void ***heads) {
+    // Each chain gets its own contiguous region, so chains never share a line
+    size_t region = size / chains / stride * stride;
+    if (chains == 0 || chains > MLP_MAX_CHAINS || region < 2 * stride) {
+        return -1;
+    }
+    for (size_t c = 0; c < chains; c++) {
+        heads[c] = chase_build((char *)buf + c * region, region, stride, size + c + 1);
+        if (heads[c] == NULL) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+double mlp_cycles_per_step(void *buf, size_t size, size_t stride, size_t chains, int dirty) {
+    void **heads[MLP_MAX_CHAINS];
+    if (mlp_build(buf, size, stride, chains, heads) != 0) {
+        return -1.0;
+    }
+
+    // Same total number of loads for every chain count
+    size_t steps = CHASE_MAX_LOADS / chains;
+    size_t warm = size / stride / chains;
+    mlp_walk(heads, chains, warm < steps ? warm : steps, dirty);
+
+    uint64_t best = UINT64_MAX;
+    size_t trial_steps = steps / CHASE_TRIALS;
+    for (int trial = 0; trial < CHASE_TRIALS; trial++) {
+        _mm_mfence();
+        uint64_t start = timer_start();
+        mlp_walk(heads, chains, trial_steps, dirty);
+        uint64_t cycles = timer_cycles(start, timer_stop());
+        if (cycles < best) {
+            best = cycles;
+        }
+    }
+    chase_sink = heads[0];
+    return (double)best / trial_steps;
+}
+
+void measure_mlp(size_t size) {
+    static const size_t counts[] = {1, 2, 3, 4, 5, 6, 7, 8, 10, 12, 14, 16, 20, 24, 28, 32};
+    const size_t num_counts = sizeof(counts) / sizeof(counts[0]);
+    double cycles[sizeof(counts) / sizeof(counts[0])];
+    double gbps[sizeof(counts) / sizeof(counts[0])];
+    double cpu_freq = get_cpu_frequency();
+
+    if (size == 0) {
+        size = chase_dram_size();
+    }
+    void *buf = arena_view(size, 0);
+    if (buf == NULL) {
+        fprintf(stderr, "Failed to allocate %zu byte MLP buffer\n", size);
+        return;
+    }
+
+    printf("Memory-level parallelism: K independent chains walked in lockstep over %zu bytes\n", size);
+    printf("Chains (K)\tLatency/Step (ns)\tLatency/Step (Cycles)\tBandwidth (GB/s)\n");
+    printf("---------------------------------------------------------------\n");
+
+    double peak = 0.0;
+    for (size_t i = 0; i < num_counts; i++) {
+        cycles[i] = mlp_cycles_per_step(buf, size, CHASE_STRIDE, counts[i], 0);
+        if (cycles[i] <= 0) {
+            gbps[i] = 0.0;
+            printf("%-10zu\tn/a\n", counts[i]);
+            continue;
+        }
+        // Every step retires one line per chain
+        gbps[i] = counts[i] * CHASE_STRIDE / (cycles[i] / cpu_freq) / 1e9;
+        if (gbps[i] > peak) peak = gbps[i];
+        printf("%-10zu\t%-16.2f\t%-20.2f\t%.2f\n",
+               counts[i], cycles[i] * 1e9 / cpu_freq, cycles[i], gbps[i]);
+    }
+
+    // Saturation: the fewest chains that already reach 95% of the best bandwidth
+    for (size_t i = 0; i < num_counts && peak > 0; i++) {
+        if (gbps[i] >= peak * 0.95) {
+            printf("\nBandwidth saturates at K = %zu (%.2f GB/s); ", counts[i], peak);
+            if (cycles[0] <= 0) {
+                printf("latency at K = 1: n/a; sustained misses in flight: n/a\n");
+                break;
+            }
+            // Little's law: lines in flight = throughput x single-chain latency
+            double in_flight = peak * 1e9 / CHASE_STRIDE * (cycles[0] / cpu_freq);
+            printf("latency at K = 1: %.2f ns; sustained misses in flight: %.1f\n",
+                   cycles[0] * 1e9 / cpu_freq, in_flight);
+            break;
+        }
+    }
+
+}
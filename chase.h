@@ -0,0 +1,60 @@
+#ifndef CHASE_H
+#define CHASE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define CHASE_STRIDE 64          // One pointer per cache line
+#define CHASE_UNROLL 16          // Loads per iteration of the timed loop
+#define CHASE_MAX_POINTS 64      // Upper bound on sweep points
+#define CHASE_MAX_LEVELS 6       // Upper bound on detected cache levels
+#define MLP_MAX_CHAINS 32        // Upper bound on interleaved chains
+
+// One point of a working-set sweep
+typedef struct {
+    size_t size;             // Working set in bytes
+    double cycles_per_load;  // TSC cycles per dependent load
+    double ns_per_load;      // Nanoseconds per dependent load
+} chase_point_t;
+
+// A latency plateau found in a sweep (L1, L2, L3, DRAM, ...)
+typedef struct {
+    const char *name;
+    size_t first_size;       // Smallest working set on the plateau
+    size_t last_size;        // Largest working set on the plateau
+    double cycles_per_load;
+    double ns_per_load;
+} cache_level_t;
+
+extern void **volatile chase_sink;  // Final pointer of the last walk
+
+// Link the lines of buf into one random cycle; returns the chain head
+void **chase_build(void *buf, size_t size, size_t stride, uint64_t seed);
+// Same, but each element sits at a hashed line offset in its stride (page-sized strides)
+void **chase_build_staggered(void *buf, size_t size, size_t stride, uint64_t seed);
+// Walk a chain for 'loads' dependent loads (rounded up to CHASE_UNROLL)
+void **chase_walk(void **head, size_t loads);
+// Average TSC cycles per dependent load over a working set of 'size' bytes
+double chase_latency_cycles(size_t size);
+// Same, over a caller-provided buffer (its contents are overwritten)
+double chase_buffer_cycles(void *buf, size_t size);
+// Same, for an already built chain of 'lines' elements
+double chase_head_cycles(void **head, size_t lines);
+// Default working set that is certain to miss the LLC
+size_t chase_dram_size(void);
+
+size_t chase_sweep(size_t min_size, size_t max_size, double cpu_freq,
+                   chase_point_t *points, size_t max_points);
+size_t detect_cache_levels(const chase_point_t *points, size_t num_points,
+                           cache_level_t *levels, size_t max_levels);
+void measure_latency_hierarchy(size_t max_size);
+
+// Memory-level parallelism: 'chains' independent chains over disjoint regions of buf
+int mlp_build(void *buf, size_t size, size_t stride, size_t chains, void ***heads);
+// Advance every chain 'steps' loads in lockstep; 'dirty' also writes each visited line
+void mlp_walk(void ***heads, size_t chains, size_t steps, int dirty);
+// TSC cycles per lockstep step (one load on every chain)
+double mlp_cycles_per_step(void *buf, size_t size, size_t stride, size_t chains, int dirty);
+void measure_mlp(size_t size);
+
+#endif // CHASE_H
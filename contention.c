@@ -0,0 +1,245 @@
+#define _GNU_SOURCE
+#include "contention.h"
+#include "bandwidth_mt.h"
+#include "profiling.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <x86intrin.h>
+
+#define CONTEND_SECONDS 0.1      // Nominal run time of each mode; rates use the measured spans
+#define CONTEND_BATCH 256        // Ops between checks of the stop flag
+#define CONTEND_PAD 128          // Two lines, so the adjacent-line prefetcher cannot couple them
+
+static const char *mode_names[CONTEND_COUNT] = {
+    "packed", "padded", "xadd", "cas", "xchg", "sharded"
+};
+
+typedef struct {
+    _Alignas(CONTEND_PAD) volatile uint64_t plain;
+    _Atomic uint64_t atomic;
+} padded_counter_t;
+
+// State shared by the controller and all workers of one thread count
+typedef struct {
+    pthread_barrier_t start;
+    pthread_barrier_t done;
+    contend_mode_t mode;
+    _Alignas(64) atomic_int stop;
+    int quit;
+    _Alignas(64) volatile uint64_t packed[MT_MAX_CORES];
+    _Alignas(64) _Atomic uint64_t shared;
+    padded_counter_t padded[MT_MAX_CORES];
+} contend_run_t;
+
+typedef struct {
+    contend_run_t *run;
+    int core;
+    size_t index;
+    int failed;
+    uint64_t ops;
+    uint64_t cycles;
+} contend_worker_t;
+
+const char *contend_mode_name(contend_mode_t mode) {
+    return mode < CONTEND_COUNT ? mode_names[mode] : "unknown";
+}
+
+// Run one mode until the controller raises stop; returns the ops completed
+static uint64_t contend_loop(contend_run_t *run, size_t index) {
+    // Packed and padded run the same loop; only the line the counter sits on differs
+    volatile uint64_t *plain = run->mode == CONTEND_PACKED ? &run->packed[index] : &run->padded[index].plain;
+    _Atomic uint64_t *shard = &run->padded[index].atomic;
+    _Atomic uint64_t *shared = &run->shared;
+    uint64_t ops = 0;
+
+    while (!atomic_load_explicit(&run->stop, memory_order_relaxed)) {
+        switch (run->mode) {
+        case CONTEND_PACKED:
+        case CONTEND_PADDED:
+            for (int i = 0; i < CONTEND_BATCH; i++) *plain = *plain + 1;
+            break;
+        case CONTEND_XADD:
+            for (int i = 0; i < CONTEND_BATCH; i++) atomic_fetch_add(shared, 1);
+            break;
+        case CONTEND_CAS:
+            for (int i = 0; i < CONTEND_BATCH; i++) {
+                uint64_t expected = atomic_load_explicit(shared, memory_order_relaxed);
+                while (!atomic_compare_exchange_weak(shared, &expected, expected + 1)) {
+                }
+            }
+            break;
+        case CONTEND_XCHG:
+            for (int i = 0; i < CONTEND_BATCH; i++) atomic_exchange(shared, ops + i);
+            break;
+        case CONTEND_SHARDED:
+            for (int i = 0; i < CONTEND_BATCH; i++) atomic_fetch_add(shard, 1);
+            break;
+        default:
+            return ops;
+        }
+        ops += CONTEND_BATCH;
+    }
+    return ops;
+}
+
+static void *contend_worker(void *arg) {
+    contend_worker_t *worker = arg;
+    contend_run_t *run = worker->run;
+
+    if (try_set_cpu_affinity(worker->core) != 0) {
+        perror("sched_setaffinity");
+        worker->failed = 1;
+    }
+
+    // A failed worker still takes part in every barrier so the others never hang
+    for (;;) {
+        pthread_barrier_wait(&run->start);
+        if (run->quit) {
+            break;
+        }
+        if (!worker->failed) {
+            uint64_t start = rdtsc_start();
+            worker->ops = contend_loop(run, worker->index);
+            worker->cycles = timer_cycles(start, rdtsc_end());
+        }
+        pthread_barrier_wait(&run->done);
+    }
+    return NULL;
+}
+
+// Every mode with 'threads' workers; fills Mops/s and ns per op for each
+static int run_thread_count(const int *cores, size_t threads, double cpu_frequency,
+                            double *mops, double *ns_per_op) {
+    contend_run_t *run = aligned_alloc(CONTEND_PAD, (sizeof(contend_run_t) + CONTEND_PAD - 1) / CONTEND_PAD * CONTEND_PAD);
+    contend_worker_t *workers = calloc(threads, sizeof(contend_worker_t));
+    pthread_t *tids = calloc(threads, sizeof(pthread_t));
+    if (run == NULL || workers == NULL || tids == NULL) {
+        perror("Failed to allocate contention state");
+        free(run);
+        free(workers);
+        free(tids);
+        return -1;
+    }
+    memset(run, 0, sizeof(*run));
+
+    // The controller joins every barrier, hence threads + 1
+    pthread_barrier_init(&run->start, NULL, threads + 1);
+    pthread_barrier_init(&run->done, NULL, threads + 1);
+    for (size_t t = 0; t < threads; t++) {
+        workers[t].run = run;
+        workers[t].core = cores[t];
+        workers[t].index = t;
+        if (pthread_create(&tids[t], NULL, contend_worker, &workers[t]) != 0) {
+            perror("pthread_create");
+            exit(1);
+        }
+    }
+
+    struct timespec duration = {0, (long)(CONTEND_SECONDS * 1e9)};
+    for (int mode = 0; mode < CONTEND_COUNT; mode++) {
+        run->mode = (contend_mode_t)mode;
+        atomic_store(&run->stop, 0);
+        pthread_barrier_wait(&run->start);
+        nanosleep(&duration, NULL);
+        atomic_store(&run->stop, 1);
+        pthread_barrier_wait(&run->done);
+
+        uint64_t total_ops = 0;
+        uint64_t longest = 0;
+        double per_op = 0.0;
+        size_t ok = 0;
+        for (size_t t = 0; t < threads; t++) {
+            if (workers[t].failed || workers[t].ops == 0) {
+                continue;
+            }
+            total_ops += workers[t].ops;
+            per_op += (double)workers[t].cycles / workers[t].ops;
+            longest = workers[t].cycles > longest ? workers[t].cycles : longest;
+            ok++;
+        }
+        // The sleep overshoots and the barriers add to it, worst on busy or virtual hosts:
+        // rate over the longest worker's measured span, not the nominal one
+        mops[mode] = longest > 0 ? total_ops / (longest / cpu_frequency) / 1e6 : 0.0;
+        ns_per_op[mode] = ok ? per_op / ok * 1e9 / cpu_frequency : 0.0;
+
+        // The shards are only touched in this mode, so together they must hold every op
+        if (mode == CONTEND_SHARDED) {
+            uint64_t sum = 0;
+            for (size_t t = 0; t < threads; t++) {
+                sum += atomic_load(&run->padded[t].atomic);
+            }
+            if (sum != total_ops) {
+                fprintf(stderr, "Sharded counters sum to %lu, expected %lu\n",
+                        (unsigned long)sum, (unsigned long)total_ops);
+            }
+        }
+    }
+
+    run->quit = 1;
+    pthread_barrier_wait(&run->start);
+    for (size_t t = 0; t < threads; t++) {
+        pthread_join(tids[t], NULL);
+    }
+    pthread_barrier_destroy(&run->start);
+    pthread_barrier_destroy(&run->done);
+    free(run);
+    free(workers);
+    free(tids);
+    return 0;
+}
+
+static void print_table(const char *title, const double *values, size_t num_cores) {
+    printf("\n%s\nThreads", title);
+    for (int mode = 0; mode < CONTEND_COUNT; mode++) {
+        printf("\t%-8s", mode_names[mode]);
+    }
+    printf("\n------------------------------------------------------------------\n");
+    for (size_t threads = 1; threads <= num_cores; threads++) {
+        printf("%zu", threads);
+        for (int mode = 0; mode < CONTEND_COUNT; mode++) {
+            printf("\t%-8.2f", values[(threads - 1) * CONTEND_COUNT + mode]);
+        }
+        printf("\n");
+    }
+}
+
+void measure_contention(const int *cores, size_t num_cores) {
+    double cpu_frequency = get_cpu_frequency();
+    if (num_cores == 0 || cpu_frequency <= 0) {
+        fprintf(stderr, "Contention suite needs at least one core and a CPU frequency\n");
+        return;
+    }
+
+    // Results indexed [threads - 1][mode]
+    double *mops = calloc(num_cores * CONTEND_COUNT, sizeof(double));
+    double *ns_per_op = calloc(num_cores * CONTEND_COUNT, sizeof(double));
+    if (mops == NULL || ns_per_op == NULL) {
+        perror("Failed to allocate result table");
+        free(mops);
+        free(ns_per_op);
+        return;
+    }
+
+    printf("Coherence and atomic contention: %.0f ms per mode, cores:", CONTEND_SECONDS * 1e3);
+    for (size_t i = 0; i < num_cores; i++) {
+        printf(" %d", cores[i]);
+    }
+    printf("\n");
+
+    for (size_t threads = 1; threads <= num_cores; threads++) {
+        size_t row = (threads - 1) * CONTEND_COUNT;
+        if (run_thread_count(cores, threads, cpu_frequency, &mops[row], &ns_per_op[row]) != 0) {
+            num_cores = threads - 1;
+            break;
+        }
+    }
+
+    print_table("Aggregate throughput (Mops/s): packed vs padded shows false sharing", mops, num_cores);
+    print_table("Per-op latency per thread (ns)", ns_per_op, num_cores);
+
+    free(mops);
+    free(ns_per_op);
+}
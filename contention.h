@@ -0,0 +1,21 @@
+#ifndef CONTENTION_H
+#define CONTENTION_H
+
+#include <stddef.h>
+
+// Shared-write patterns timed on 1..num_cores pinned threads
+typedef enum {
+    CONTEND_PACKED,    // Private counters packed into shared lines (false sharing)
+    CONTEND_PADDED,    // Private counters, one per padded line
+    CONTEND_XADD,      // lock xadd on one shared counter
+    CONTEND_CAS,       // Compare-and-swap increment loop on one shared counter
+    CONTEND_XCHG,      // Exchange on one shared word
+    CONTEND_SHARDED,   // lock xadd on a per-thread padded counter, summed and checked at the end
+    CONTEND_COUNT
+} contend_mode_t;
+
+const char *contend_mode_name(contend_mode_t mode);
+// Ops/s and per-op latency of every mode versus thread count
+void measure_contention(const int *cores, size_t num_cores);
+
+#endif // CONTENTION_H
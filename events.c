@@ -0,0 +1,267 @@
+#define _GNU_SOURCE
+#include "events.h"
+#include "perf_counters.h"
+#include <linux/perf_event.h>
+#include <papi.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#define NO_PERF_EVENT PERF_TYPE_MAX  // No generic perf equivalent
+
+#define CACHE_EVENT(cache, op, result) \
+    ((cache) | ((op) << 8) | ((result) << 16))
+
+typedef struct {
+    const char *name;            // Column label
+    int papi_code;
+    uint32_t perf_type;
+    uint64_t perf_config;
+} event_def_t;
+
+static const event_def_t event_defs[EVENT_COUNT] = {
+    [EVENT_L1D_MISSES]       = {"L1D", PAPI_L1_DCM, PERF_TYPE_HW_CACHE,
+                                CACHE_EVENT(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_OP_READ,
+                                            PERF_COUNT_HW_CACHE_RESULT_MISS)},
+    [EVENT_L2_MISSES]        = {"L2", PAPI_L2_DCM, NO_PERF_EVENT, 0},
+    [EVENT_LLC_MISSES]       = {"LLC", PAPI_L3_TCM, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    [EVENT_DTLB_MISSES]      = {"DTLB", PAPI_TLB_DM, PERF_TYPE_HW_CACHE,
+                                CACHE_EVENT(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_OP_READ,
+                                            PERF_COUNT_HW_CACHE_RESULT_MISS)},
+    [EVENT_ITLB_MISSES]      = {"ITLB", PAPI_TLB_IM, PERF_TYPE_HW_CACHE,
+                                CACHE_EVENT(PERF_COUNT_HW_CACHE_ITLB, PERF_COUNT_HW_CACHE_OP_READ,
+                                            PERF_COUNT_HW_CACHE_RESULT_MISS)},
+    [EVENT_CYCLES]           = {"Cyc", PAPI_TOT_CYC, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    [EVENT_STALL_CYCLES]     = {"Stall", PAPI_RES_STL, PERF_TYPE_HARDWARE,
+                                PERF_COUNT_HW_STALLED_CYCLES_BACKEND},
+    [EVENT_MEM_STALL_CYCLES] = {"MemStall", PAPI_MEM_WCY, NO_PERF_EVENT, 0},
+    [EVENT_PREFETCH_MISSES]  = {"PfMiss", PAPI_PRF_DM, PERF_TYPE_HW_CACHE,
+                                CACHE_EVENT(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_OP_PREFETCH,
+                                            PERF_COUNT_HW_CACHE_RESULT_MISS)},
+};
+
+static const struct {
+    const char *name;
+    unsigned events;
+} group_names[] = {
+    {"cache", EVENT_GROUP_CACHE},
+    {"tlb", EVENT_GROUP_TLB},
+    {"stalls", EVENT_GROUP_STALLS},
+    {"prefetch", EVENT_GROUP_PREFETCH},
+    {"all", (1u << EVENT_COUNT) - 1},
+    {"none", 0},
+};
+
+unsigned event_groups = EVENT_GROUP_CACHE;
+
+// 0 until the first set is opened, then 1 if PAPI initialised and -1 if not
+static int papi_state = 0;
+static int papi_multiplex = 0;
+
+static event_set_t active_set;
+static int active_state = 0;  // 0 not opened yet, 1 usable, -1 nothing to count
+
+const char *event_name(event_id_t id) {
+    return id < EVENT_COUNT ? event_defs[id].name : "unknown";
+}
+
+long event_groups_from_names(const char *list) {
+    unsigned events = 0;
+    const char *p = list;
+
+    while (*p != '\0') {
+        size_t len = strcspn(p, ",");
+        size_t g = 0;
+        const size_t num_groups = sizeof(group_names) / sizeof(group_names[0]);
+        while (g < num_groups &&
+               (strlen(group_names[g].name) != len || strncmp(group_names[g].name, p, len) != 0)) {
+            g++;
+        }
+        if (g == num_groups) {
+            return -1;
+        }
+        events |= group_names[g].events;
+        p += len;
+        if (*p == ',') {
+            p++;
+        }
+    }
+    return (long)events;
+}
+
+static int papi_ready(void) {
+    if (papi_state == 0) {
+        int retval = PAPI_library_init(PAPI_VERSION);
+        papi_state = retval == PAPI_VER_CURRENT || PAPI_is_initialized() ? 1 : -1;
+        // Multiplexing is optional: without it only as many events as counters open
+        papi_multiplex = papi_state == 1 && PAPI_multiplex_init() == PAPI_OK;
+    }
+    return papi_state == 1;
+}
+
+static int open_papi(event_set_t *set, unsigned events) {
+    int requested = __builtin_popcount(events);
+
+    set->papi_set = PAPI_NULL;
+    if (!papi_ready() || PAPI_create_eventset(&set->papi_set) != PAPI_OK) {
+        return 0;
+    }
+    // A multiplexed set has to be bound to the CPU component before it is converted
+    if (papi_multiplex && requested > PAPI_num_counters() &&
+        PAPI_assign_eventset_component(set->papi_set, 0) == PAPI_OK &&
+        PAPI_set_multiplex(set->papi_set) == PAPI_OK) {
+        set->multiplexed = 1;
+    }
+
+    for (int e = 0; e < EVENT_COUNT; e++) {
+        if ((events & (1u << e)) && PAPI_add_event(set->papi_set, event_defs[e].papi_code) == PAPI_OK) {
+            set->valid[e] = 1;
+            set->backend[e] = EVENT_BACKEND_PAPI;
+            set->papi_slot[e] = set->num_papi++;
+        }
+    }
+    if (set->num_papi == 0) {
+        PAPI_cleanup_eventset(set->papi_set);
+        PAPI_destroy_eventset(&set->papi_set);
+        set->papi_set = PAPI_NULL;
+    }
+    return set->num_papi;
+}
+
+static int open_perf(event_set_t *set, unsigned events) {
+    int opened = 0;
+    for (int e = 0; e < EVENT_COUNT; e++) {
+        if ((events & (1u << e)) && event_defs[e].perf_type != NO_PERF_EVENT) {
+            set->fds[e] = perf_counter_open(event_defs[e].perf_type, event_defs[e].perf_config, 0, 0);
+            if (set->fds[e] >= 0) {
+                set->valid[e] = 1;
+                set->backend[e] = EVENT_BACKEND_PERF;
+                opened++;
+            }
+        }
+    }
+    return opened;
+}
+
+int event_set_open(event_set_t *set, unsigned events) {
+    memset(set, 0, sizeof(*set));
+    for (int e = 0; e < EVENT_COUNT; e++) {
+        set->fds[e] = -1;
+    }
+
+    int opened = open_papi(set, events);
+    unsigned missing = 0;
+    for (int e = 0; e < EVENT_COUNT; e++) {
+        if ((events & (1u << e)) && !set->valid[e]) {
+            missing |= 1u << e;
+        }
+    }
+    // The kernel multiplexes perf events on its own; the enabled/running times show it
+    return opened + open_perf(set, missing);
+}
+
+int event_set_start(event_set_t *set) {
+    int counting = 0;
+    for (int e = 0; e < EVENT_COUNT; e++) {
+        if (set->valid[e] && set->backend[e] == EVENT_BACKEND_PERF) {
+            if (perf_counter_read(set->fds[e], set->start[e]) != 0) {
+                return -1;
+            }
+            counting = 1;
+        }
+    }
+    if (set->num_papi > 0) {
+        return PAPI_start(set->papi_set) == PAPI_OK ? 0 : -1;
+    }
+    return counting ? 0 : -1;
+}
+
+int event_set_stop(event_set_t *set, double *values) {
+    memset(values, 0, EVENT_COUNT * sizeof(double));
+
+    if (set->num_papi > 0) {
+        long long counts[EVENT_COUNT];
+        if (PAPI_stop(set->papi_set, counts) != PAPI_OK) {
+            return -1;
+        }
+        for (int e = 0; e < EVENT_COUNT; e++) {
+            if (set->valid[e] && set->backend[e] == EVENT_BACKEND_PAPI) {
+                values[e] = (double)counts[set->papi_slot[e]];
+            }
+        }
+    }
+    for (int e = 0; e < EVENT_COUNT; e++) {
+        uint64_t end[3];
+        if (!set->valid[e] || set->backend[e] != EVENT_BACKEND_PERF ||
+            perf_counter_read(set->fds[e], end) != 0) {
+            continue;
+        }
+        // Scale the delta by the share of the interval the event was scheduled
+        double enabled = (double)(end[1] - set->start[e][1]);
+        double running = (double)(end[2] - set->start[e][2]);
+        double count = (double)(end[0] - set->start[e][0]);
+        values[e] = running > 0 && running < enabled ? count * enabled / running : count;
+    }
+    return 0;
+}
+
+void event_set_close(event_set_t *set) {
+    if (set->num_papi > 0) {
+        PAPI_cleanup_eventset(set->papi_set);
+        PAPI_destroy_eventset(&set->papi_set);
+        set->num_papi = 0;
+    }
+    for (int e = 0; e < EVENT_COUNT; e++) {
+        if (set->fds[e] >= 0) {
+            close(set->fds[e]);
+            set->fds[e] = -1;
+        }
+        set->valid[e] = 0;
+        set->backend[e] = EVENT_BACKEND_NONE;
+    }
+}
+
+event_set_t *event_active(void) {
+    if (active_state == 0) {
+        active_state = -1;
+        if (event_groups != 0) {
+            if (event_set_open(&active_set, event_groups) > 0) {
+                active_state = 1;
+            } else {
+                fprintf(stderr, "No hardware counters for the selected events (PAPI and perf_event_open); "
+                                "counter columns omitted\n");
+            }
+        }
+    }
+    return active_state == 1 ? &active_set : NULL;
+}
+
+void event_print_header(void) {
+    event_set_t *set = event_active();
+    if (set == NULL) {
+        return;
+    }
+    for (int e = 0; e < EVENT_COUNT; e++) {
+        if (set->valid[e]) {
+            printf("\t%s/B\t%s/acc", event_defs[e].name, event_defs[e].name);
+        }
+    }
+}
+
+void event_print_row(const double *values, double bytes, double accesses) {
+    event_set_t *set = event_active();
+    if (set == NULL) {
+        return;
+    }
+    for (int e = 0; e < EVENT_COUNT; e++) {
+        if (!set->valid[e]) {
+            continue;
+        }
+        if (values == NULL || bytes <= 0 || accesses <= 0) {
+            printf("\t-\t-");
+        } else {
+            printf("\t%.4f\t%.4f", values[e] / bytes, values[e] / accesses);
+        }
+    }
+}
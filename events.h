@@ -0,0 +1,64 @@
+#ifndef EVENTS_H
+#define EVENTS_H
+
+#include <stdint.h>
+
+// Hardware events the measurement kernels can be wrapped with
+typedef enum {
+    EVENT_L1D_MISSES,
+    EVENT_L2_MISSES,
+    EVENT_LLC_MISSES,
+    EVENT_DTLB_MISSES,
+    EVENT_ITLB_MISSES,
+    EVENT_CYCLES,
+    EVENT_STALL_CYCLES,      // Resource stalls (backend-bound cycles)
+    EVENT_MEM_STALL_CYCLES,  // Cycles waiting on memory writes
+    EVENT_PREFETCH_MISSES,   // Data prefetches that missed the L1
+    EVENT_COUNT
+} event_id_t;
+
+// Selectable groups, a bit mask of events each
+#define EVENT_GROUP_CACHE    ((1u << EVENT_L1D_MISSES) | (1u << EVENT_L2_MISSES) | (1u << EVENT_LLC_MISSES))
+#define EVENT_GROUP_TLB      ((1u << EVENT_DTLB_MISSES) | (1u << EVENT_ITLB_MISSES))
+#define EVENT_GROUP_STALLS   ((1u << EVENT_CYCLES) | (1u << EVENT_STALL_CYCLES) | (1u << EVENT_MEM_STALL_CYCLES))
+#define EVENT_GROUP_PREFETCH (1u << EVENT_PREFETCH_MISSES)
+
+typedef enum {
+    EVENT_BACKEND_NONE,
+    EVENT_BACKEND_PAPI,
+    EVENT_BACKEND_PERF,      // perf_event_open, for the events PAPI is missing or rejects
+} event_backend_t;
+
+typedef struct {
+    event_backend_t backend[EVENT_COUNT];  // Per event: one set can mix PAPI and perf events
+    int valid[EVENT_COUNT];          // Opened and counting
+    int multiplexed;                 // More events than hardware counters
+    int papi_set;
+    int papi_slot[EVENT_COUNT];      // Index into the PAPI values array
+    int num_papi;
+    int fds[EVENT_COUNT];
+    uint64_t start[EVENT_COUNT][3];  // perf value, time enabled, time running at start
+} event_set_t;
+
+extern unsigned event_groups;  // Events wrapped around the harness kernels
+
+const char *event_name(event_id_t id);
+// Parse "cache,tlb,stalls,prefetch", "all" or "none" into a mask; -1 if unknown
+long event_groups_from_names(const char *list);
+
+// PAPI is initialised once per process, then each set tries PAPI and opens the events
+// it could not add with perf_event_open. Returns the number of events opened (0: set unusable)
+int event_set_open(event_set_t *set, unsigned events);
+int event_set_start(event_set_t *set);
+// Counts since event_set_start, indexed by event_id_t (0 where not valid)
+int event_set_stop(event_set_t *set, double *values);
+void event_set_close(event_set_t *set);
+
+// The set for event_groups, opened on first use; NULL when nothing can be counted
+event_set_t *event_active(void);
+// Result-row columns: misses per byte and per access for each active event.
+// Both print nothing without an active set, so the columns are simply omitted
+void event_print_header(void);
+void event_print_row(const double *values, double bytes, double accesses);
+
+#endif // EVENTS_H
@@ -0,0 +1,104 @@
+#define _GNU_SOURCE
+#include "evict.h"
+#include "pages.h"
+#include <cpuid.h>
+#include <immintrin.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#define EVICT_LINE 64
+#define CPUID_CLFSH (1 << 19)                 // CPUID.1:EDX, not named in cpuid.h
+#define EVICT_MIN_SWEEP (64UL * 1024 * 1024)  // When the LLC size is unknown
+
+evict_mode_t cold_mode = EVICT_OFF;
+
+static const char *mode_names[EVICT_MODE_COUNT] = {"off", "flush", "sweep"};
+
+// Sweep buffer: 1.5x the LLC, allocated on first use and kept for the process
+static char *sweep_buf = NULL;
+static size_t sweep_size = 0;
+static volatile uint64_t sweep_sink;
+
+const char *evict_mode_name(evict_mode_t mode) {
+    return mode < EVICT_MODE_COUNT ? mode_names[mode] : "unknown";
+}
+
+int evict_mode_from_name(const char *name) {
+    for (int m = 0; m < EVICT_MODE_COUNT; m++) {
+        if (strcmp(name, mode_names[m]) == 0) {
+            return m;
+        }
+    }
+    return -1;
+}
+
+static int has_clflushopt(void) {
+    unsigned int eax, ebx, ecx, edx;
+    return __get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) && (ebx & bit_CLFLUSHOPT);
+}
+
+static int has_clflush(void) {
+    unsigned int eax, ebx, ecx, edx;
+    return __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (edx & CPUID_CLFSH);
+}
+
+__attribute__((target("clflushopt")))
+static void flush_opt(const char *p, const char *end) {
+    for (; p < end; p += EVICT_LINE) {
+        _mm_clflushopt((void *)p);
+    }
+}
+
+static void flush_plain(const char *p, const char *end) {
+    for (; p < end; p += EVICT_LINE) {
+        _mm_clflush(p);
+    }
+}
+
+// Touch one word per line of a buffer larger than the LLC; the LLC is not
+// strictly LRU, so this evicts most but not necessarily every line
+static void sweep(void) {
+    if (sweep_buf == NULL) {
+        long llc = sysconf(_SC_LEVEL3_CACHE_SIZE);
+        sweep_size = llc > 0 ? (size_t)llc * 3 / 2 : EVICT_MIN_SWEEP;
+        if (sweep_size < EVICT_MIN_SWEEP) {
+            sweep_size = EVICT_MIN_SWEEP;
+        }
+        sweep_buf = page_alloc(sweep_size, PAGE_DEFAULT);
+        if (sweep_buf == NULL) {
+            fprintf(stderr, "Failed to allocate %zu byte eviction buffer\n", sweep_size);
+            return;
+        }
+        memset(sweep_buf, 1, sweep_size);
+    }
+    uint64_t sum = 0;
+    for (size_t i = 0; i < sweep_size; i += EVICT_LINE) {
+        sum += *(volatile uint64_t *)(sweep_buf + i);
+    }
+    sweep_sink = sum;
+}
+
+void evict_buffer(const void *buf, size_t size) {
+    static int flush_kind = -1;  // 2 clflushopt, 1 clflush, 0 neither
+    const char *start = (const char *)((uintptr_t)buf & ~(uintptr_t)(EVICT_LINE - 1));
+    const char *end = (const char *)buf + size;
+
+    if (cold_mode == EVICT_OFF || size == 0) {
+        return;
+    }
+    if (flush_kind < 0) {
+        flush_kind = has_clflushopt() ? 2 : has_clflush() ? 1 : 0;
+    }
+
+    if (cold_mode == EVICT_FLUSH && flush_kind == 2) {
+        flush_opt(start, end);
+    } else if (cold_mode == EVICT_FLUSH && flush_kind == 1) {
+        flush_plain(start, end);
+    } else {
+        sweep();
+    }
+    // Flushes are weakly ordered: finish them before the timed pass starts
+    _mm_mfence();
+}
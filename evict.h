@@ -0,0 +1,24 @@
+#ifndef EVICT_H
+#define EVICT_H
+
+#include <stddef.h>
+
+// How a buffer is pushed out of the cache hierarchy before a cold pass
+typedef enum {
+    EVICT_OFF,         // Warm: timed passes run on whatever the last pass left cached
+    EVICT_FLUSH,       // clflushopt, or clflush on CPUs without it, for every line
+    EVICT_SWEEP,       // Read a private buffer larger than the LLC
+    EVICT_MODE_COUNT
+} evict_mode_t;
+
+extern evict_mode_t cold_mode;  // Mode used by the latency and bandwidth tests
+
+const char *evict_mode_name(evict_mode_t mode);
+// Parse "off", "flush" or "sweep"; -1 if unknown
+int evict_mode_from_name(const char *name);
+
+// Evict every line of buf under cold_mode (no-op when off). Flushing falls back
+// to the sweep when the CPU has neither flush instruction
+void evict_buffer(const void *buf, size_t size);
+
+#endif // EVICT_H
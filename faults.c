@@ -0,0 +1,265 @@
+#define _GNU_SOURCE
+#include "faults.h"
+#include "pages.h"
+#include "profiling.h"
+#include "timing.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+
+#ifndef MADV_POPULATE_WRITE
+#define MADV_POPULATE_WRITE 23
+#endif
+
+#define FAULT_MAX_SIZE (512UL * 1024 * 1024)
+#define FAULT_TOUCH 4096         // One write per base page, whatever the page size
+#define FAULT_TRIALS 3           // Median of this many fresh mappings per configuration
+
+static const char *method_names[FAULT_METHOD_COUNT] = {
+    "first-touch", "MAP_POPULATE", "WILLNEED", "POPULATE_WRITE"
+};
+
+// Page sizes compared; hugetlb rows are skipped when no pages are reserved
+static const page_policy_t fault_policies[] = {PAGE_4K, PAGE_THP, PAGE_2M};
+
+typedef struct {
+    pthread_barrier_t start;
+    pthread_barrier_t done;
+    page_policy_t policy;
+    fault_method_t method;
+    int separate;             // Each thread maps its own slice instead of sharing one mapping
+    char *shared;
+    size_t size;
+    size_t slice;
+} fault_run_t;
+
+typedef struct {
+    fault_run_t *run;
+    int core;
+    size_t index;
+    int failed;
+    uint64_t setup_cycles;    // mmap and madvise of its own mapping (separate runs)
+} fault_worker_t;
+
+typedef struct {
+    double seconds;           // Barrier release to the last thread done, plus shared setup
+    double setup_seconds;     // Slowest mapping setup
+    long faults;
+} fault_result_t;
+
+const char *fault_method_name(fault_method_t method) {
+    return method < FAULT_METHOD_COUNT ? method_names[method] : "unknown";
+}
+
+static long minor_faults(void) {
+    struct rusage usage;
+    return getrusage(RUSAGE_SELF, &usage) == 0 ? usage.ru_minflt : 0;
+}
+
+// Map 'size' bytes the way 'method' asks; NULL on failure
+static char *fault_map(page_policy_t policy, fault_method_t method, size_t size) {
+    char *buf = page_alloc_flags(size, policy, method == FAULT_MAP_POPULATE ? MAP_POPULATE : 0);
+    if (buf == NULL) {
+        return NULL;
+    }
+    if (method == FAULT_WILLNEED && madvise(buf, size, MADV_WILLNEED) != 0) {
+        perror("madvise(MADV_WILLNEED)");
+    } else if (method == FAULT_POPULATE_WRITE && madvise(buf, size, MADV_POPULATE_WRITE) != 0) {
+        perror("madvise(MADV_POPULATE_WRITE)");
+        page_free(buf, size, policy);
+        return NULL;
+    }
+    return buf;
+}
+
+static void fault_touch(volatile char *buf, size_t size) {
+    for (size_t i = 0; i < size; i += FAULT_TOUCH) {
+        buf[i] = 1;
+    }
+}
+
+static void *fault_worker(void *arg) {
+    fault_worker_t *worker = arg;
+    fault_run_t *run = worker->run;
+    size_t offset = worker->index * run->slice;
+    size_t size = offset < run->size ? run->size - offset : 0;
+    char *own = NULL;
+
+    size = size < run->slice ? size : run->slice;
+    if (try_set_cpu_affinity(worker->core) != 0) {
+        perror("sched_setaffinity");
+        worker->failed = 1;
+    }
+    pthread_barrier_wait(&run->start);
+
+    if (!worker->failed && size > 0) {
+        if (run->separate) {
+            uint64_t start = rdtsc_start();
+            own = fault_map(run->policy, run->method, size);
+            worker->setup_cycles = timer_cycles(start, rdtsc_end());
+            if (own == NULL) {
+                worker->failed = 1;
+            } else {
+                fault_touch(own, size);
+            }
+        } else if (run->shared != NULL) {
+            fault_touch(run->shared + offset, size);
+        }
+    }
+    pthread_barrier_wait(&run->done);
+
+    if (own != NULL) {
+        page_free(own, size, run->policy);
+    }
+    return NULL;
+}
+
+// One fresh mapping faulted by 'threads' pinned threads; -1 if any part failed
+static int fault_trial(fault_run_t *run, const int *cores, size_t threads, double cpu_frequency,
+                       fault_result_t *result) {
+    size_t page = page_policy_size(run->policy);
+    int failed = 0;
+
+    fault_worker_t *workers = calloc(threads, sizeof(fault_worker_t));
+    pthread_t *tids = calloc(threads, sizeof(pthread_t));
+    if (workers == NULL || tids == NULL) {
+        perror("Failed to allocate fault workers");
+        free(workers);
+        free(tids);
+        return -1;
+    }
+    run->shared = NULL;
+    run->slice = (run->size / threads + page - 1) / page * page;
+    pthread_barrier_init(&run->start, NULL, threads + 1);
+    pthread_barrier_init(&run->done, NULL, threads + 1);
+    for (size_t t = 0; t < threads; t++) {
+        workers[t].run = run;
+        workers[t].core = cores[t];
+        workers[t].index = t;
+        // Barriers are sized for every thread, so a missing one would hang the rest
+        if (pthread_create(&tids[t], NULL, fault_worker, &workers[t]) != 0) {
+            perror("pthread_create");
+            exit(1);
+        }
+    }
+
+    long faults = minor_faults();
+    uint64_t start = rdtsc_start();
+    uint64_t setup = 0;
+    if (!run->separate) {
+        // The shared mapping is set up once, by the controller, inside the timed span
+        run->shared = fault_map(run->policy, run->method, run->size);
+        setup = timer_cycles(start, rdtsc_end());
+        failed = run->shared == NULL;
+    }
+    pthread_barrier_wait(&run->start);
+    pthread_barrier_wait(&run->done);
+    uint64_t cycles = timer_cycles(start, rdtsc_end());
+    result->faults = minor_faults() - faults;
+
+    for (size_t t = 0; t < threads; t++) {
+        pthread_join(tids[t], NULL);
+        failed |= workers[t].failed;
+        setup = workers[t].setup_cycles > setup ? workers[t].setup_cycles : setup;
+    }
+    if (run->shared != NULL) {
+        page_free(run->shared, run->size, run->policy);
+        run->shared = NULL;
+    }
+    pthread_barrier_destroy(&run->start);
+    pthread_barrier_destroy(&run->done);
+    free(workers);
+    free(tids);
+
+    result->seconds = cycles / cpu_frequency;
+    result->setup_seconds = setup / cpu_frequency;
+    return failed ? -1 : 0;
+}
+
+static int compare_seconds(const void *a, const void *b) {
+    const fault_result_t *x = a;
+    const fault_result_t *y = b;
+    return x->seconds < y->seconds ? -1 : x->seconds > y->seconds;
+}
+
+static void fault_row(fault_run_t *run, const int *cores, size_t threads, double cpu_frequency) {
+    fault_result_t trials[FAULT_TRIALS];
+
+    printf("%-16s%-8zu%-10s", method_names[run->method], threads,
+           threads == 1 ? "-" : run->separate ? "separate" : "shared");
+    for (int i = 0; i < FAULT_TRIALS; i++) {
+        if (fault_trial(run, cores, threads, cpu_frequency, &trials[i]) != 0) {
+            printf("failed\n");
+            return;
+        }
+    }
+    qsort(trials, FAULT_TRIALS, sizeof(fault_result_t), compare_seconds);
+    fault_result_t *median = &trials[FAULT_TRIALS / 2];
+
+    double touches = (double)run->size / FAULT_TOUCH;
+    printf("%-10ld%-12.2f%-12.2f%-10.1f", median->faults, median->setup_seconds * 1e3,
+           median->seconds * 1e3, median->seconds * 1e9 / touches);
+    if (median->faults > 0) {
+        printf("%-10.1f", median->seconds * 1e9 / median->faults);
+    } else {
+        printf("%-10s", "-");
+    }
+    printf("%.2f\n", run->size / median->seconds / 1e9);
+}
+
+// Thread counts double up to the full list, which always runs last
+static size_t next_thread_count(size_t threads, size_t num_cores) {
+    if (threads < num_cores && threads * 2 > num_cores) {
+        return num_cores;
+    }
+    return threads * 2;
+}
+
+void measure_page_faults(size_t size, const int *cores, size_t num_cores) {
+    double cpu_frequency = get_cpu_frequency();
+
+    if (num_cores == 0 || cpu_frequency <= 0) {
+        fprintf(stderr, "Page-fault benchmark needs at least one core and a CPU frequency\n");
+        return;
+    }
+    if (size == 0) {
+        size = get_memory_size() / 4;
+        size = size < FAULT_MAX_SIZE ? size : FAULT_MAX_SIZE;
+    }
+
+    printf("Page faults: %zu bytes per mapping, one write per 4 KiB, median of %d fresh mappings\n",
+           size, FAULT_TRIALS);
+    printf("Setup is mmap plus madvise; Total runs from setup to the last thread's last write\n");
+
+    for (size_t p = 0; p < sizeof(fault_policies) / sizeof(fault_policies[0]); p++) {
+        page_policy_t policy = fault_policies[p];
+        fault_run_t run = {.policy = policy, .size = size};
+
+        // Skip page sizes this system cannot map at all
+        void *probe = page_alloc(page_policy_size(policy), policy);
+        if (probe == NULL) {
+            printf("\n%s pages: not available, skipped\n", page_policy_name(policy));
+            continue;
+        }
+        page_free(probe, page_policy_size(policy), policy);
+
+        printf("\n=== %s pages ===\n", page_policy_name(policy));
+        printf("%-16s%-8s%-10s%-10s%-12s%-12s%-10s%-10s%s\n", "Method", "Threads", "Mapping", "Faults",
+               "Setup (ms)", "Total (ms)", "ns/4KiB", "ns/Fault", "GB/s");
+        printf("------------------------------------------------------------------------------------------\n");
+        for (int method = 0; method < FAULT_METHOD_COUNT; method++) {
+            run.method = (fault_method_t)method;
+            for (size_t threads = 1; threads <= num_cores; threads = next_thread_count(threads, num_cores)) {
+                run.separate = 0;
+                fault_row(&run, cores, threads, cpu_frequency);
+                if (threads > 1) {
+                    run.separate = 1;
+                    fault_row(&run, cores, threads, cpu_frequency);
+                }
+            }
+        }
+    }
+}
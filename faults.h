@@ -0,0 +1,21 @@
+#ifndef FAULTS_H
+#define FAULTS_H
+
+#include <stddef.h>
+
+// How a fresh anonymous mapping gets its pages
+typedef enum {
+    FAULT_FIRST_TOUCH,      // Plain mmap; every page faults on its first write
+    FAULT_MAP_POPULATE,     // mmap(MAP_POPULATE): the kernel faults it all in up front
+    FAULT_WILLNEED,         // madvise(MADV_WILLNEED), then first touch
+    FAULT_POPULATE_WRITE,   // madvise(MADV_POPULATE_WRITE), as the test arena does (Linux 5.14+)
+    FAULT_METHOD_COUNT
+} fault_method_t;
+
+const char *fault_method_name(fault_method_t method);
+// Map and write one byte per 4 KiB of 'size' bytes (0: a quarter of RAM, at most 512 MiB)
+// for every method, on 4 KiB, THP and 2 MiB hugetlb pages, with 1..num_cores threads
+// faulting one shared mapping or a mapping each. Reports faults, ns per fault and GB/s
+void measure_page_faults(size_t size, const int *cores, size_t num_cores);
+
+#endif // FAULTS_H
@@ -0,0 +1,157 @@
+#include "harness.h"
+#include "timing.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BENCH_TUKEY_K 1.5        // Fence distance in interquartile ranges
+#define BENCH_MAX_REPS (1UL << 30)
+
+const bench_config_t bench_default_config = {
+    .min_trials = 5,
+    .max_trials = 200,
+    .target_ci = 0.01,
+    .time_budget = 0.5,
+    .min_trial_cycles = 200000,
+};
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Linear interpolation between the closest ranks of a sorted array
+static double percentile(const double *sorted, size_t n, double p) {
+    double pos = p * (n - 1);
+    size_t lo = (size_t)pos;
+    if (lo + 1 >= n) {
+        return sorted[n - 1];
+    }
+    return sorted[lo] + (pos - lo) * (sorted[lo + 1] - sorted[lo]);
+}
+
+// Fill stats from the samples so far; 'sorted' is scratch space of n entries
+static void compute_stats(const double *samples, size_t n, double *sorted, bench_stats_t *stats) {
+    memcpy(sorted, samples, n * sizeof(double));
+    qsort(sorted, n, sizeof(double), compare_double);
+
+    // Drop everything outside the Tukey fences; interrupts only ever push trials up
+    double q1 = percentile(sorted, n, 0.25), q3 = percentile(sorted, n, 0.75);
+    double low = q1 - BENCH_TUKEY_K * (q3 - q1), high = q3 + BENCH_TUKEY_K * (q3 - q1);
+    size_t first = 0, last = n;
+    while (first < last && sorted[first] < low) first++;
+    while (last > first && sorted[last - 1] > high) last--;
+
+    const double *kept = sorted + first;
+    size_t count = last - first;
+    double sum = 0.0, squares = 0.0;
+    for (size_t i = 0; i < count; i++) {
+        sum += kept[i];
+    }
+    double mean = sum / count;
+    for (size_t i = 0; i < count; i++) {
+        squares += (kept[i] - mean) * (kept[i] - mean);
+    }
+
+    stats->trials = n;
+    stats->outliers = n - count;
+    stats->min = sorted[0];
+    stats->median = percentile(kept, count, 0.50);
+    stats->p90 = percentile(kept, count, 0.90);
+    stats->p99 = percentile(kept, count, 0.99);
+    stats->mean = mean;
+    stats->stddev = count > 1 ? sqrt(squares / (count - 1)) : 0.0;
+    stats->ci = count > 1 ? 1.96 * stats->stddev / sqrt((double)count) : mean;
+}
+
+double bench_run(bench_fn_t fn, void *ctx, const bench_config_t *config, bench_stats_t *stats) {
+    bench_stats_t local;
+    int want_events = stats != NULL;
+    double samples[BENCH_MAX_TRIALS];
+    double sorted[BENCH_MAX_TRIALS];
+
+    if (config == NULL) {
+        config = &bench_default_config;
+    }
+    if (stats == NULL) {
+        stats = &local;
+    }
+    memset(stats, 0, sizeof(*stats));
+
+    size_t max_trials = config->max_trials < BENCH_MAX_TRIALS ? config->max_trials : BENCH_MAX_TRIALS;
+    size_t min_trials = config->min_trials < 2 ? 2 : config->min_trials;
+    if (min_trials > max_trials) {
+        min_trials = max_trials;
+    }
+    uint64_t budget = (uint64_t)(config->time_budget * tsc_frequency());
+    uint64_t begin = timer_start();
+
+    // Size the trial so timer resolution and overhead stay negligible; doubles as warm-up
+    size_t reps = 1;
+    for (;;) {
+        if (config->before_trial != NULL) {
+            config->before_trial(ctx);
+        }
+        uint64_t start = timer_start();
+        fn(ctx, reps);
+        uint64_t cycles = timer_cycles(start, timer_stop());
+        if (cycles >= config->min_trial_cycles || reps >= BENCH_MAX_REPS) {
+            break;
+        }
+        reps *= 2;
+    }
+    stats->reps = reps;
+
+    size_t n = 0;
+    while (n < max_trials) {
+        if (config->before_trial != NULL) {
+            config->before_trial(ctx);
+        }
+        uint64_t start = timer_start();
+        fn(ctx, reps);
+        uint64_t stop = timer_stop();
+        samples[n++] = (double)timer_cycles(start, stop) / reps;
+
+        if (n < min_trials) {
+            continue;
+        }
+        compute_stats(samples, n, sorted, stats);
+        if (stats->ci <= config->target_ci * stats->mean) {
+            stats->converged = 1;
+            break;
+        }
+        if (stop - begin >= budget) {
+            break;
+        }
+    }
+    stats->reps = reps;
+
+    // Counted separately, so counter reads never land inside the timed trials
+    event_set_t *set = want_events ? event_active() : NULL;
+    if (set != NULL && config->before_trial != NULL) {
+        config->before_trial(ctx);
+    }
+    if (set != NULL && event_set_start(set) == 0) {
+        fn(ctx, reps);
+        if (event_set_stop(set, stats->events) == 0) {
+            for (int e = 0; e < EVENT_COUNT; e++) {
+                stats->events[e] /= reps;
+            }
+            stats->counted = 1;
+        }
+    }
+    return n > 0 ? stats->median : -1.0;
+}
+
+void bench_print_header(void) {
+    printf("Measurement\t\tTrials\tOutliers\tMin\tMedian\tP90\tP99\tStddev\tCI (95%%)\n");
+    printf("------------------------------------------------------------------------------------------------------\n");
+}
+
+void bench_print_row(const char *label, const bench_stats_t *stats) {
+    printf("%-20s\t%zu\t%zu\t\t%.0f\t%.0f\t%.0f\t%.0f\t%.0f\t%.2f%%%s\n",
+           label, stats->trials, stats->outliers, stats->min, stats->median, stats->p90,
+           stats->p99, stats->stddev, stats->mean > 0 ? 100.0 * stats->ci / stats->mean : 0.0,
+           stats->converged ? "" : " (capped)");
+}
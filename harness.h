@@ -0,0 +1,44 @@
+#ifndef HARNESS_H
+#define HARNESS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "events.h"
+
+#define BENCH_MAX_TRIALS 1000
+
+// One trial runs the kernel 'reps' times back to back
+typedef void (*bench_fn_t)(void *ctx, size_t reps);
+
+typedef struct {
+    size_t min_trials;
+    size_t max_trials;           // At most BENCH_MAX_TRIALS
+    double target_ci;            // Stop once the 95% CI half-width is this fraction of the mean
+    double time_budget;          // Seconds per measurement, trials included
+    uint64_t min_trial_cycles;   // reps is doubled until one trial takes at least this long
+    void (*before_trial)(void *ctx);  // Untimed, before every trial (e.g. cache eviction); may be NULL
+} bench_config_t;
+
+// Cycles per rep over the trials left after outlier rejection
+typedef struct {
+    size_t trials;               // Trials run
+    size_t outliers;             // Discarded by the Tukey fences
+    size_t reps;                 // Kernel calls per trial
+    double min, median, p90, p99;
+    double mean, stddev;
+    double ci;                   // 95% confidence half-width of the mean
+    int converged;               // 0 if the budget or trial cap ran out first
+    int counted;                 // events holds one extra trial under event_active()
+    double events[EVENT_COUNT];  // Event counts per rep, indexed by event_id_t
+} bench_stats_t;
+
+extern const bench_config_t bench_default_config;
+
+// Run trials until the CI target, time budget or trial cap; config NULL uses the defaults.
+// With stats, one more trial runs under the active event set (see events.h).
+// Returns the median cycles per rep, or -1 on failure
+double bench_run(bench_fn_t fn, void *ctx, const bench_config_t *config, bench_stats_t *stats);
+void bench_print_header(void);
+void bench_print_row(const char *label, const bench_stats_t *stats);
+
+#endif // HARNESS_H
@@ -0,0 +1,463 @@
+#define _GNU_SOURCE
+#include "kernels.h"
+#include "profiling.h"
+#include "pages.h"
+#include "arena.h"
+#include "events.h"
+#include "evict.h"
+#include <immintrin.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Results of every load kernel land here so the loads cannot be discarded;
+// external linkage stops the compiler from treating the stores as dead
+char kernel_sink[64] __attribute__((aligned(64)));
+static volatile char kernel_sink_byte;
+
+typedef uint64_t __attribute__((may_alias)) u64_alias;
+
+// Compiler barrier between passes: OR-folding the same loads again is
+// idempotent, so without it the compiler may keep only the first pass
+#define KERNEL_BARRIER() __asm__ volatile("" ::: "memory")
+
+#define KERNEL_NTA_AHEAD 1024  // prefetchnta distance of the non-temporal reads
+
+// One prefetchnta per line of the next chunk
+static inline __attribute__((always_inline)) void prefetch_nta(const char *p, size_t bytes) {
+    for (size_t offset = 0; offset < bytes; offset += 64) {
+        _mm_prefetch(p + KERNEL_NTA_AHEAD + offset, _MM_HINT_NTA);
+    }
+}
+
+// 64-bit scalar: volatile accesses keep each one a single mov
+#define S64_LOAD(p) (*(volatile const u64_alias *)(p))
+#define S64_STORE(p, v) (*(volatile u64_alias *)(p) = (v))
+
+// Every kernel is generated from the same two templates, so the instruction
+// set is the only thing that differs between rows of the bandwidth table.
+// VEC/WIDTH name the register type and its size in bytes; LOAD/STORE are
+// unaligned accesses; NT_STORE is the aligned streaming store; OR folds loads
+// into an accumulator; XOR is the modify step of read-modify-write; FILL is
+// the (non byte-splat) store pattern.
+#define DEFINE_KERNELS(SUFFIX, ATTR, VEC, WIDTH, LOAD, STORE, NT_STORE, OR, XOR, ZERO, FILL) \
+ATTR static void block_pass_##SUFFIX(char *buf, size_t block_size, size_t read_count,    \
+                                     size_t total_size, size_t iterations) {             \
+    VEC acc0 = ZERO, acc1 = ZERO;                                                         \
+    VEC fill = FILL;                                                                      \
+    char tail = 0;                                                                        \
+    size_t read_vec = read_count / WIDTH * WIDTH;                                         \
+    for (size_t iter = 0; iter < iterations; iter++) {                                    \
+        KERNEL_BARRIER();                                                                 \
+        for (size_t i = 0; i + block_size <= total_size; i += block_size) {               \
+            char *block = buf + i;                                                        \
+            size_t j = 0;                                                                 \
+            for (; j + 2 * WIDTH <= read_vec; j += 2 * WIDTH) {                           \
+                acc0 = OR(acc0, LOAD(block + j));                                         \
+                acc1 = OR(acc1, LOAD(block + j + WIDTH));                                 \
+            }                                                                             \
+            for (; j < read_vec; j += WIDTH) {                                            \
+                acc0 = OR(acc0, LOAD(block + j));                                         \
+            }                                                                             \
+            /* Ragged ends of a block fall back to 8-byte, then 1-byte accesses */        \
+            for (; j + 8 <= read_count; j += 8) {                                         \
+                tail |= (char)S64_LOAD(block + j);                                        \
+            }                                                                             \
+            for (; j < read_count; j++) {                                                 \
+                tail |= ((volatile char *)block)[j];                                      \
+            }                                                                             \
+            /* Writes start where reads stopped; align them to the vector width */        \
+            for (; j < block_size && j % 8 != 0; j++) {                                   \
+                ((volatile char *)block)[j] = (char)j;                                    \
+            }                                                                             \
+            for (; j + 8 <= block_size && j % WIDTH != 0; j += 8) {                       \
+                S64_STORE(block + j, (uint64_t)j);                                        \
+            }                                                                             \
+            for (; j + WIDTH <= block_size; j += WIDTH) {                                 \
+                STORE(block + j, fill);                                                   \
+            }                                                                             \
+            for (; j + 8 <= block_size; j += 8) {                                         \
+                S64_STORE(block + j, (uint64_t)j);                                        \
+            }                                                                             \
+            for (; j < block_size; j++) {                                                 \
+                ((volatile char *)block)[j] = (char)j;                                    \
+            }                                                                             \
+        }                                                                                 \
+    }                                                                                     \
+    STORE(kernel_sink, OR(acc0, acc1));                                                   \
+    kernel_sink_byte = tail;                                                              \
+}                                                                                         \
+                                                                                          \
+ATTR static void op_pass_##SUFFIX(kernel_op_t op, char *dst, const char *src,             \
+                                  size_t size, size_t iterations) {                       \
+    VEC acc0 = ZERO, acc1 = ZERO, acc2 = ZERO, acc3 = ZERO;                               \
+    VEC fill = FILL;                                                                      \
+    for (size_t iter = 0; iter < iterations; iter++) {                                    \
+        KERNEL_BARRIER();                                                                 \
+        switch (op) {                                                                     \
+        case OP_LOAD:                                                                     \
+            for (size_t i = 0; i < size; i += 4 * WIDTH) {                                \
+                acc0 = OR(acc0, LOAD(src + i));                                           \
+                acc1 = OR(acc1, LOAD(src + i + WIDTH));                                   \
+                acc2 = OR(acc2, LOAD(src + i + 2 * WIDTH));                               \
+                acc3 = OR(acc3, LOAD(src + i + 3 * WIDTH));                               \
+            }                                                                             \
+            break;                                                                        \
+        case OP_STORE:                                                                    \
+            for (size_t i = 0; i < size; i += 4 * WIDTH) {                                \
+                STORE(dst + i, fill);                                                     \
+                STORE(dst + i + WIDTH, fill);                                             \
+                STORE(dst + i + 2 * WIDTH, fill);                                         \
+                STORE(dst + i + 3 * WIDTH, fill);                                         \
+            }                                                                             \
+            break;                                                                        \
+        case OP_COPY:                                                                     \
+            for (size_t i = 0; i < size; i += 4 * WIDTH) {                                \
+                STORE(dst + i, LOAD(src + i));                                            \
+                STORE(dst + i + WIDTH, LOAD(src + i + WIDTH));                            \
+                STORE(dst + i + 2 * WIDTH, LOAD(src + i + 2 * WIDTH));                    \
+                STORE(dst + i + 3 * WIDTH, LOAD(src + i + 3 * WIDTH));                    \
+            }                                                                             \
+            break;                                                                        \
+        case OP_RMW:                                                                      \
+            for (size_t i = 0; i < size; i += 4 * WIDTH) {                                \
+                STORE(dst + i, XOR(LOAD(dst + i), fill));                                 \
+                STORE(dst + i + WIDTH, XOR(LOAD(dst + i + WIDTH), fill));                 \
+                STORE(dst + i + 2 * WIDTH, XOR(LOAD(dst + i + 2 * WIDTH), fill));         \
+                STORE(dst + i + 3 * WIDTH, XOR(LOAD(dst + i + 3 * WIDTH), fill));         \
+            }                                                                             \
+            break;                                                                        \
+        case OP_NT_LOAD:                                                                  \
+            for (size_t i = 0; i < size; i += 4 * WIDTH) {                                \
+                prefetch_nta(src + i, 4 * WIDTH);                                         \
+                acc0 = OR(acc0, LOAD(src + i));                                           \
+                acc1 = OR(acc1, LOAD(src + i + WIDTH));                                   \
+                acc2 = OR(acc2, LOAD(src + i + 2 * WIDTH));                               \
+                acc3 = OR(acc3, LOAD(src + i + 3 * WIDTH));                               \
+            }                                                                             \
+            break;                                                                        \
+        case OP_NT_STORE:                                                                 \
+            for (size_t i = 0; i < size; i += 4 * WIDTH) {                                \
+                NT_STORE(dst + i, fill);                                                  \
+                NT_STORE(dst + i + WIDTH, fill);                                          \
+                NT_STORE(dst + i + 2 * WIDTH, fill);                                      \
+                NT_STORE(dst + i + 3 * WIDTH, fill);                                      \
+            }                                                                             \
+            _mm_sfence();  /* Drain the write-combining buffers inside the pass */        \
+            break;                                                                        \
+        case OP_NT_COPY:                                                                  \
+            for (size_t i = 0; i < size; i += 4 * WIDTH) {                                \
+                prefetch_nta(src + i, 4 * WIDTH);                                         \
+                NT_STORE(dst + i, LOAD(src + i));                                         \
+                NT_STORE(dst + i + WIDTH, LOAD(src + i + WIDTH));                         \
+                NT_STORE(dst + i + 2 * WIDTH, LOAD(src + i + 2 * WIDTH));                 \
+                NT_STORE(dst + i + 3 * WIDTH, LOAD(src + i + 3 * WIDTH));                 \
+            }                                                                             \
+            _mm_sfence();                                                                 \
+            break;                                                                        \
+        default:                                                                          \
+            break;                                                                        \
+        }                                                                                 \
+    }                                                                                     \
+    STORE(kernel_sink, OR(OR(acc0, acc1), OR(acc2, acc3)));                               \
+}
+
+#define S64_OR(a, b) ((a) | (b))
+#define S64_XOR(a, b) ((a) ^ (b))
+#define S64_NT_STORE(p, v) _mm_stream_si64((long long *)(p), (long long)(v))
+DEFINE_KERNELS(scalar64, , uint64_t, 8, S64_LOAD, S64_STORE, S64_NT_STORE, S64_OR, S64_XOR,
+               0, 0x0123456789ABCDEFULL)
+
+#define SSE2_LOAD(p) _mm_loadu_si128((const __m128i *)(p))
+#define SSE2_STORE(p, v) _mm_storeu_si128((__m128i *)(p), (v))
+#define SSE2_NT_STORE(p, v) _mm_stream_si128((__m128i *)(p), (v))
+DEFINE_KERNELS(sse2, __attribute__((target("sse2"))), __m128i, 16, SSE2_LOAD, SSE2_STORE, SSE2_NT_STORE,
+               _mm_or_si128, _mm_xor_si128, _mm_setzero_si128(),
+               _mm_set1_epi64x(0x0123456789ABCDEFLL))
+
+#define AVX2_LOAD(p) _mm256_loadu_si256((const __m256i *)(p))
+#define AVX2_STORE(p, v) _mm256_storeu_si256((__m256i *)(p), (v))
+#define AVX2_NT_STORE(p, v) _mm256_stream_si256((__m256i *)(p), (v))
+DEFINE_KERNELS(avx2, __attribute__((target("avx2"))), __m256i, 32, AVX2_LOAD, AVX2_STORE, AVX2_NT_STORE,
+               _mm256_or_si256, _mm256_xor_si256, _mm256_setzero_si256(),
+               _mm256_set1_epi64x(0x0123456789ABCDEFLL))
+
+#define AVX512_LOAD(p) _mm512_loadu_si512((const void *)(p))
+#define AVX512_STORE(p, v) _mm512_storeu_si512((void *)(p), (v))
+#define AVX512_NT_STORE(p, v) _mm512_stream_si512((void *)(p), (v))
+DEFINE_KERNELS(avx512, __attribute__((target("avx512f"))), __m512i, 64, AVX512_LOAD, AVX512_STORE, AVX512_NT_STORE,
+               _mm512_or_si512, _mm512_xor_si512, _mm512_setzero_si512(),
+               _mm512_set1_epi64(0x0123456789ABCDEFLL))
+
+// The original one-byte-at-a-time loops, kept as the baseline row
+static void block_pass_byte(char *buf, size_t block_size, size_t read_count,
+                            size_t total_size, size_t iterations) {
+    volatile char *array = buf;
+    volatile char temp;
+    size_t write_count = block_size - read_count;
+
+    for (size_t iter = 0; iter < iterations; iter++) {
+        for (size_t i = 0; i + block_size <= total_size; i += block_size) {
+            for (size_t j = 0; j < read_count; j++) {
+                temp = array[i + j];  // Read operation
+                (void)temp;
+            }
+            for (size_t j = 0; j < write_count; j++) {
+                array[i + read_count + j] = (char)((i + j) & 0xFF);  // Write operation
+            }
+        }
+    }
+}
+
+static void op_pass_byte(kernel_op_t op, char *dst, const char *src,
+                         size_t size, size_t iterations) {
+    volatile char *vdst = dst;
+    const volatile char *vsrc = src;
+    char acc = 0;
+
+    for (size_t iter = 0; iter < iterations; iter++) {
+        for (size_t i = 0; i < size; i++) {
+            switch (op) {
+            case OP_LOAD:  acc |= vsrc[i]; break;
+            case OP_STORE: vdst[i] = (char)i; break;
+            case OP_COPY:  vdst[i] = vsrc[i]; break;
+            case OP_RMW:   vdst[i] ^= 0x5A; break;
+            default: break;
+            }
+        }
+    }
+    kernel_sink_byte = acc;
+}
+
+static int always_supported(void) {
+    return 1;
+}
+
+static int sse2_supported(void) {
+    return __builtin_cpu_supports("sse2");
+}
+
+static int avx2_supported(void) {
+    return __builtin_cpu_supports("avx2");
+}
+
+static int avx512_supported(void) {
+    return __builtin_cpu_supports("avx512f");
+}
+
+typedef struct {
+    const char *name;
+    size_t width;                // Bytes per load or store instruction
+    int (*supported)(void);
+    void (*block_pass)(char *, size_t, size_t, size_t, size_t);
+    void (*op_pass)(kernel_op_t, char *, const char *, size_t, size_t);
+} kernel_entry_t;
+
+static const kernel_entry_t kernel_table[KERNEL_COUNT] = {
+    [KERNEL_BYTE]     = {"byte",     1,  always_supported, block_pass_byte,     op_pass_byte},
+    [KERNEL_SCALAR64] = {"scalar64", 8,  always_supported, block_pass_scalar64, op_pass_scalar64},
+    [KERNEL_SSE2]     = {"sse2",     16, sse2_supported,   block_pass_sse2,     op_pass_sse2},
+    [KERNEL_AVX2]     = {"avx2",     32, avx2_supported,   block_pass_avx2,     op_pass_avx2},
+    [KERNEL_AVX512]   = {"avx512",   64, avx512_supported, block_pass_avx512,   op_pass_avx512},
+};
+
+static const char *op_names[OP_COUNT] = {"Load", "Store", "Copy", "RMW", "NT Load", "NT Store", "NT Copy"};
+
+int kernel_supported(bw_kernel_t kernel) {
+    return kernel < KERNEL_COUNT && kernel_table[kernel].supported();
+}
+
+const char *kernel_name(bw_kernel_t kernel) {
+    return kernel < KERNEL_COUNT ? kernel_table[kernel].name : "unknown";
+}
+
+size_t kernel_width(bw_kernel_t kernel) {
+    return kernel < KERNEL_COUNT ? kernel_table[kernel].width : 0;
+}
+
+int kernel_op_supported(bw_kernel_t kernel, kernel_op_t op) {
+    return kernel_supported(kernel) && op < OP_COUNT && (kernel != KERNEL_BYTE || op < OP_NT_LOAD);
+}
+
+double kernel_op_bytes(kernel_op_t op, size_t size) {
+    // Copy and read-modify-write move every byte twice
+    return (op == OP_COPY || op == OP_RMW || op == OP_NT_COPY) ? 2.0 * size : (double)size;
+}
+
+const char *kernel_op_name(kernel_op_t op) {
+    return op < OP_COUNT ? op_names[op] : "unknown";
+}
+
+bw_kernel_t kernel_best(void) {
+    for (int k = KERNEL_COUNT - 1; k > KERNEL_BYTE; k--) {
+        if (kernel_supported((bw_kernel_t)k)) {
+            return (bw_kernel_t)k;
+        }
+    }
+    return KERNEL_SCALAR64;
+}
+
+int kernel_from_name(const char *name) {
+    for (int k = 0; k < KERNEL_COUNT; k++) {
+        if (strcmp(name, kernel_table[k].name) == 0) {
+            return k;
+        }
+    }
+    return -1;
+}
+
+void kernel_block_pass(bw_kernel_t kernel, char *buf, size_t block_size,
+                       double read_ratio, size_t total_size, size_t iterations) {
+    if (!kernel_supported(kernel)) {
+        kernel = KERNEL_SCALAR64;
+    }
+    size_t read_count = (size_t)(read_ratio * block_size);
+    kernel_table[kernel].block_pass(buf, block_size, read_count, total_size, iterations);
+}
+
+void kernel_op_pass(bw_kernel_t kernel, kernel_op_t op, char *dst, const char *src,
+                    size_t size, size_t iterations) {
+    if (!kernel_op_supported(kernel, op)) {
+        kernel = KERNEL_SCALAR64;
+    }
+    kernel_table[kernel].op_pass(op, dst, src, size / 256 * 256, iterations);
+}
+
+// Harness trial: 'reps' whole-buffer passes of one op
+typedef struct {
+    bw_kernel_t kernel;
+    kernel_op_t op;
+    char *dst;
+    const char *src;
+    size_t size;
+} op_trial_t;
+
+static void op_trial(void *ctx, size_t reps) {
+    op_trial_t *trial = ctx;
+    kernel_op_pass(trial->kernel, trial->op, trial->dst, trial->src, trial->size, reps);
+}
+
+// Cold mode: both buffers leave the hierarchy before every timed pass
+static void op_evict(void *ctx) {
+    op_trial_t *trial = ctx;
+    evict_buffer(trial->src, trial->size);
+    evict_buffer(trial->dst, trial->size);
+}
+
+double measure_kernel_bandwidth(bw_kernel_t kernel, kernel_op_t op, size_t total_size,
+                                bench_stats_t *stats) {
+    double cpu_frequency = get_cpu_frequency();
+    char *src = NULL, *dst = NULL;
+
+    // Failed measurements leave zero trials behind, which the callers skip
+    if (stats != NULL) {
+        memset(stats, 0, sizeof(*stats));
+    }
+    if (!kernel_op_supported(kernel, op)) {
+        return 0.0;
+    }
+    total_size = total_size / 256 * 256;
+    // Both buffers from one arena view, dst starting on the page after src ends
+    size_t span = (total_size + 4095) / 4096 * 4096;
+    if (total_size == 0) {
+        fprintf(stderr, "Buffer size must be at least 256 bytes\n");
+        return 0.0;
+    }
+    if ((src = arena_view(2 * span, 0)) == NULL) {
+        fprintf(stderr, "Failed to allocate memory\n");
+        return 0.0;
+    }
+    dst = src + span;
+
+    kernel_op_pass(kernel, op, dst, src, total_size, 1);  // Warm-up
+    op_trial_t trial = {kernel, op, dst, src, total_size};
+    bench_config_t config = bench_default_config;
+    if (cold_mode != EVICT_OFF) {
+        config.before_trial = op_evict;
+        config.min_trial_cycles = 0;  // One pass per trial, each starting cold
+    }
+    double cycles_per_pass = bench_run(op_trial, &trial, &config, stats);
+
+    double per_pass = kernel_op_bytes(op, total_size);
+    double bandwidth = cycles_per_pass > 0 ? per_pass / (cycles_per_pass / cpu_frequency) : 0.0;
+    return bandwidth;  // Bytes per second
+}
+
+void measure_kernel_peak_bandwidth(size_t total_size) {
+    bench_stats_t stats[KERNEL_COUNT][OP_COUNT];
+
+    if (total_size < 256) {
+        fprintf(stderr, "Buffer size must be at least 256 bytes\n");
+        return;
+    }
+    printf("Peak bandwidth per instruction set, %zu byte buffers%s\n", total_size,
+           cold_mode != EVICT_OFF ? ", evicted before every pass" : "");
+    printf("Kernel  ");
+    for (int op = 0; op < OP_COUNT; op++) {
+        printf("\t%s", kernel_op_name((kernel_op_t)op));
+    }
+    printf("\t(GB/s)\n");
+    printf("------------------------------------------------------------------------------------------------\n");
+
+    for (int k = 0; k < KERNEL_COUNT; k++) {
+        if (!kernel_supported((bw_kernel_t)k)) {
+            printf("%-8s\tnot supported by this CPU\n", kernel_name((bw_kernel_t)k));
+            continue;
+        }
+        printf("%-8s", kernel_name((bw_kernel_t)k));
+        for (int op = 0; op < OP_COUNT; op++) {
+            if (!kernel_op_supported((bw_kernel_t)k, (kernel_op_t)op)) {
+                printf("\t-");
+                continue;
+            }
+            double bandwidth = measure_kernel_bandwidth((bw_kernel_t)k, (kernel_op_t)op, total_size,
+                                                        &stats[k][op]);
+            if (stats[k][op].trials == 0) {
+                printf("\tn/a     ");
+            } else {
+                printf("\t%-8.2f", bandwidth / 1e9);
+            }
+        }
+        printf("\n");
+    }
+
+    // Trial distribution behind each median, in cycles per pass
+    printf("\nTrial statistics (cycles per pass)\n");
+    bench_print_header();
+    for (int k = 0; k < KERNEL_COUNT; k++) {
+        if (!kernel_supported((bw_kernel_t)k)) {
+            continue;
+        }
+        for (int op = 0; op < OP_COUNT; op++) {
+            if (!kernel_op_supported((bw_kernel_t)k, (kernel_op_t)op) || stats[k][op].trials == 0) {
+                continue;
+            }
+            char label[32];
+            snprintf(label, sizeof(label), "%s %s", kernel_name((bw_kernel_t)k), kernel_op_name((kernel_op_t)op));
+            bench_print_row(label, &stats[k][op]);
+        }
+    }
+
+    // Hardware events per byte moved and per load/store instruction
+    if (event_active() == NULL) {
+        return;
+    }
+    printf("\nCounters per pass\nKernel Op\t");
+    event_print_header();
+    printf("\n");
+    for (int k = 0; k < KERNEL_COUNT; k++) {
+        if (!kernel_supported((bw_kernel_t)k)) {
+            continue;
+        }
+        for (int op = 0; op < OP_COUNT; op++) {
+            if (!kernel_op_supported((bw_kernel_t)k, (kernel_op_t)op) || stats[k][op].trials == 0) {
+                continue;
+            }
+            const bench_stats_t *s = &stats[k][op];
+            double bytes = kernel_op_bytes((kernel_op_t)op, total_size / 256 * 256);
+            printf("%-8s %-8s\t", kernel_name((bw_kernel_t)k), kernel_op_name((kernel_op_t)op));
+            event_print_row(s->counted ? s->events : NULL, bytes, bytes / kernel_width((bw_kernel_t)k));
+            printf("\n");
+        }
+    }
+}
@@ -0,0 +1,56 @@
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "harness.h"
+
+// Instruction sets the bandwidth kernels are built for; picked at runtime by CPUID
+typedef enum {
+    KERNEL_BYTE,       // One volatile char at a time (the original loops)
+    KERNEL_SCALAR64,   // 64-bit general-purpose loads and stores
+    KERNEL_SSE2,       // 128-bit
+    KERNEL_AVX2,       // 256-bit
+    KERNEL_AVX512,     // 512-bit
+    KERNEL_COUNT
+} bw_kernel_t;
+
+// Whole-buffer access shapes for peak bandwidth
+typedef enum {
+    OP_LOAD,           // Read src
+    OP_STORE,          // Write dst
+    OP_COPY,           // Read src, write dst
+    OP_RMW,            // Read dst, modify, write back
+    OP_NT_LOAD,        // Read src behind prefetchnta, bypassing most of the hierarchy
+    OP_NT_STORE,       // Write dst with streaming (movnt) stores
+    OP_NT_COPY,        // prefetchnta reads, streaming writes
+    OP_COUNT
+} kernel_op_t;
+
+int kernel_supported(bw_kernel_t kernel);
+const char *kernel_name(bw_kernel_t kernel);
+const char *kernel_op_name(kernel_op_t op);
+// Bytes per load or store instruction of a kernel
+size_t kernel_width(bw_kernel_t kernel);
+// 0 for the byte kernel's non-temporal ops: there is no one-byte streaming store
+int kernel_op_supported(bw_kernel_t kernel, kernel_op_t op);
+// Bytes one pass of 'op' moves over a 'size' byte buffer (copies count both sides)
+double kernel_op_bytes(kernel_op_t op, size_t size);
+bw_kernel_t kernel_best(void);
+// Parse a kernel name ("byte", "scalar64", "sse2", "avx2", "avx512"); -1 if unknown
+int kernel_from_name(const char *name);
+
+// Block grid pass: in each block_size block read read_ratio of it, write the rest
+void kernel_block_pass(bw_kernel_t kernel, char *buf, size_t block_size,
+                       double read_ratio, size_t total_size, size_t iterations);
+// Whole-buffer pass; size is rounded down to 256 bytes. Streaming stores need
+// dst aligned to the kernel width
+void kernel_op_pass(bw_kernel_t kernel, kernel_op_t op, char *dst, const char *src,
+                    size_t size, size_t iterations);
+
+// Median bandwidth in bytes/s; the trial distribution goes to stats when non-NULL
+double measure_kernel_bandwidth(bw_kernel_t kernel, kernel_op_t op, size_t total_size,
+                                bench_stats_t *stats);
+void measure_kernel_peak_bandwidth(size_t total_size);
+
+#endif // KERNELS_H
@@ -0,0 +1,181 @@
+#define _GNU_SOURCE
+#include "loaded_latency.h"
+#include "chase.h"
+#include "pages.h"
+#include "profiling.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <x86intrin.h>
+
+#define GEN_BUFFER (64UL * 1024 * 1024)  // Private buffer per generator, past most LLCs
+#define GEN_CHUNK (64UL * 1024)          // Bytes moved between injected delays
+#define GEN_BLOCK 64                     // Block size of the R:W grid, as in measure_bandwidth
+#define PROBE_LOADS (1UL << 21)          // Dependent loads per latency sample
+#define IDLE_LEVEL (-1L)                 // Generators park; gives the unloaded latency
+
+// Pause instructions injected after every chunk, from flat out to nearly idle
+static const long delays[] = {IDLE_LEVEL, 200000, 50000, 20000, 10000, 5000, 2000, 1000, 500, 200, 100, 0};
+
+typedef struct {
+    pthread_barrier_t start;
+    pthread_barrier_t done;
+    atomic_int stop;          // Probe finished its sample
+    long delay;
+    int quit;
+    double read_ratio;
+    bw_kernel_t kernel;
+} gen_control_t;
+
+typedef struct {
+    gen_control_t *ctl;
+    int core;
+    int failed;
+    uint64_t bytes;
+    uint64_t cycles;
+} gen_worker_t;
+
+static void *generator(void *arg) {
+    gen_worker_t *worker = arg;
+    gen_control_t *ctl = worker->ctl;
+    char *buf = NULL;
+
+    if (try_set_cpu_affinity(worker->core) != 0) {
+        perror("sched_setaffinity");
+        worker->failed = 1;
+    } else if (posix_memalign((void **)&buf, 4096, GEN_BUFFER) != 0) {
+        perror("Failed to allocate memory");
+        worker->failed = 1;
+    } else {
+        memset(buf, 0, GEN_BUFFER);
+    }
+
+    size_t offset = 0;
+    for (;;) {
+        pthread_barrier_wait(&ctl->start);
+        if (ctl->quit) {
+            break;
+        }
+
+        uint64_t bytes = 0;
+        uint64_t start = rdtsc_start();
+        if (!worker->failed && ctl->delay != IDLE_LEVEL) {
+            while (!atomic_load_explicit(&ctl->stop, memory_order_relaxed)) {
+                kernel_block_pass(ctl->kernel, buf + offset, GEN_BLOCK, ctl->read_ratio, GEN_CHUNK, 1);
+                bytes += GEN_CHUNK;
+                offset = (offset + GEN_CHUNK) % GEN_BUFFER;
+                for (long d = 0; d < ctl->delay; d++) {
+                    _mm_pause();
+                }
+            }
+        }
+        worker->cycles = timer_cycles(start, rdtsc_end());
+        worker->bytes = bytes;
+
+        pthread_barrier_wait(&ctl->done);
+    }
+
+    free(buf);
+    return NULL;
+}
+
+void measure_loaded_latency(const int *cores, size_t num_cores, size_t probe_size,
+                            double read_ratio, bw_kernel_t kernel) {
+    double cpu_frequency = get_cpu_frequency();
+    size_t generators = num_cores > 0 ? num_cores - 1 : 0;
+    gen_control_t ctl = {.read_ratio = read_ratio, .kernel = kernel};
+    void *probe_buf = NULL;
+
+    if (num_cores == 0 || cpu_frequency <= 0) {
+        fprintf(stderr, "Loaded latency needs at least one core and a CPU frequency\n");
+        return;
+    }
+    if (probe_size == 0) {
+        probe_size = chase_dram_size();
+    }
+
+    // The calling thread is the probe
+    set_cpu_affinity(cores[0]);
+    if ((probe_buf = page_alloc(probe_size, page_policy)) == NULL) {
+        fprintf(stderr, "Failed to allocate memory\n");
+        return;
+    }
+    memset(probe_buf, 0, probe_size);
+    void **head = chase_build(probe_buf, probe_size, CHASE_STRIDE, 1);
+    if (head == NULL) {
+        page_free(probe_buf, probe_size, page_policy);
+        return;
+    }
+    head = chase_walk(head, PROBE_LOADS);  // Warm-up
+
+    gen_worker_t *workers = calloc(generators ? generators : 1, sizeof(gen_worker_t));
+    pthread_t *tids = calloc(generators ? generators : 1, sizeof(pthread_t));
+    if (workers == NULL || tids == NULL) {
+        perror("Failed to allocate generator state");
+        free(workers);
+        free(tids);
+        page_free(probe_buf, probe_size, page_policy);
+        return;
+    }
+
+    pthread_barrier_init(&ctl.start, NULL, generators + 1);
+    pthread_barrier_init(&ctl.done, NULL, generators + 1);
+    for (size_t g = 0; g < generators; g++) {
+        workers[g].ctl = &ctl;
+        workers[g].core = cores[g + 1];
+        // Barriers are sized for every generator, so a missing one would hang the rest
+        if (pthread_create(&tids[g], NULL, generator, &workers[g]) != 0) {
+            perror("pthread_create");
+            exit(1);
+        }
+    }
+
+    printf("Loaded latency: probe on core %d over %zu bytes, %zu generator(s), %s kernel, read ratio %.2f\n",
+           cores[0], probe_size, generators, kernel_name(kernel), read_ratio);
+    printf("Delay (Pause/Chunk)\tAchieved Bandwidth (GB/s)\tLatency (ns)\tLatency (Cycles)\n");
+    printf("------------------------------------------------------------------------------\n");
+
+    const size_t num_levels = sizeof(delays) / sizeof(delays[0]);
+    for (size_t level = 0; level < num_levels; level++) {
+        ctl.delay = delays[level];
+        atomic_store(&ctl.stop, 0);
+        pthread_barrier_wait(&ctl.start);
+
+        // Generators keep running until the probe has its sample
+        uint64_t start = rdtsc_start();
+        head = chase_walk(head, PROBE_LOADS);
+        uint64_t end = rdtsc_end();
+        atomic_store(&ctl.stop, 1);
+        pthread_barrier_wait(&ctl.done);
+
+        double achieved = 0.0;
+        for (size_t g = 0; g < generators; g++) {
+            if (workers[g].cycles > 0) {
+                achieved += workers[g].bytes / (workers[g].cycles / cpu_frequency);
+            }
+        }
+        double cycles = (double)timer_cycles(start, end) / PROBE_LOADS;
+
+        if (ctl.delay == IDLE_LEVEL) {
+            printf("%-20s\t", "idle");
+        } else {
+            printf("%-20ld\t", ctl.delay);
+        }
+        printf("%-24.2f\t%-12.2f\t%.2f\n", achieved / 1e9, cycles * 1e9 / cpu_frequency, cycles);
+    }
+
+    ctl.quit = 1;
+    pthread_barrier_wait(&ctl.start);
+    for (size_t g = 0; g < generators; g++) {
+        pthread_join(tids[g], NULL);
+    }
+    chase_sink = head;
+
+    pthread_barrier_destroy(&ctl.start);
+    pthread_barrier_destroy(&ctl.done);
+    free(workers);
+    free(tids);
+    page_free(probe_buf, probe_size, page_policy);
+}
@@ -0,0 +1,12 @@
+#ifndef LOADED_LATENCY_H
+#define LOADED_LATENCY_H
+
+#include <stddef.h>
+#include "kernels.h"
+
+// Latency probe on cores[0] while cores[1..] generate throttled bandwidth;
+// prints one latency-vs-achieved-bandwidth point per throttle level
+void measure_loaded_latency(const int *cores, size_t num_cores, size_t probe_size,
+                            double read_ratio, bw_kernel_t kernel);
+
+#endif // LOADED_LATENCY_H
@@ -1,10 +1,184 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "profiling.h"
+#include "chase.h"
+#include "bandwidth_mt.h"
+#include "kernels.h"
+#include "loaded_latency.h"
+#include "numa_matrix.h"
+#include "pages.h"
+#include "cachesim.h"
+#include "arena.h"
+#include "pingpong.h"
+#include "contention.h"
+#include "patterns.h"
+#include "prefetch.h"
+#include "events.h"
+#include "evict.h"
+#include "memops.h"
+#include "roofline.h"
+#include "antagonist.h"
+#include "alloc_profile.h"
+#include "faults.h"
+#include "blocked.h"
 
 int main(int argc, char **argv) {
-    if (argc > 1) {
-        profile_user_code(argv[1]);
+    double sample_interval_ms = 0.0;
+
+    save_startup_affinity();  // Before any mode pins; profiled programs get it back
+    // Global options come before the mode
+    while (argc > 1 && strncmp(argv[1], "--", 2) == 0 && strchr(argv[1], '=') != NULL) {
+        if (strncmp(argv[1], "--pages=", 8) == 0) {
+            // Page size for every test buffer
+            int policy = page_policy_from_name(argv[1] + 8);
+            if (policy < 0) {
+                fprintf(stderr, "Unknown page policy: %s (default, 4k, thp, 2m, 1g)\n", argv[1] + 8);
+                return 1;
+            }
+            page_policy = (page_policy_t)policy;
+        } else if (strncmp(argv[1], "--events=", 9) == 0) {
+            // Counter groups attached to every measurement kernel
+            long events = event_groups_from_names(argv[1] + 9);
+            if (events < 0) {
+                fprintf(stderr, "Unknown event group: %s (cache, tlb, stalls, prefetch, all, none)\n",
+                        argv[1] + 9);
+                return 1;
+            }
+            event_groups = (unsigned)events;
+        } else if (strncmp(argv[1], "--cold=", 7) == 0) {
+            // Evict test buffers before every timed pass
+            int mode = evict_mode_from_name(argv[1] + 7);
+            if (mode < 0) {
+                fprintf(stderr, "Unknown cold mode: %s (off, flush, sweep)\n", argv[1] + 7);
+                return 1;
+            }
+            cold_mode = (evict_mode_t)mode;
+        } else if (strncmp(argv[1], "--antagonist=", 13) == 0) {
+            // Noisy neighbour for a profiled program: kind[:size or GB/s][@cores]
+            if (antagonist_from_spec(argv[1] + 13, &antagonist) != 0) {
+                fprintf(stderr, "Invalid antagonist: %s (llc[:bytes], dram[:GB/s], tlb[:bytes], then @cores)\n",
+                        argv[1] + 13);
+                return 1;
+            }
+        } else if (strncmp(argv[1], "--alloc=", 8) == 0) {
+            // Allocation profile of a profiled program through the LD_PRELOAD library
+            if (strcmp(argv[1] + 8, "on") != 0 && strcmp(argv[1] + 8, "off") != 0) {
+                fprintf(stderr, "Unknown alloc mode: %s (on, off)\n", argv[1] + 8);
+                return 1;
+            }
+            alloc_profiling = strcmp(argv[1] + 8, "on") == 0;
+        } else if (strncmp(argv[1], "--sample=", 9) == 0) {
+            // Counter timeline interval (ms) for a profiled program
+            sample_interval_ms = atof(argv[1] + 9);
+        } else {
+            fprintf(stderr, "Unknown option: %s\n", argv[1]);
+            return 1;
+        }
+        argv++;
+        argc--;
+    }
+
+    if (argc > 1 && strcmp(argv[1], "--latency") == 0) {
+        // Pointer-chase sweep; optional max working set in bytes
+        size_t max_size = argc > 2 ? strtoull(argv[2], NULL, 0) : 0;
+        set_cpu_affinity(0);
+        measure_latency_hierarchy(max_size);
+    } else if (argc > 1 && strcmp(argv[1], "--mlp") == 0) {
+        // Latency and bandwidth versus number of outstanding misses
+        size_t size = argc > 2 ? strtoull(argv[2], NULL, 0) : 0;
+        set_cpu_affinity(0);
+        measure_mlp(size);
+    } else if (argc > 1 && strcmp(argv[1], "--bandwidth-threads") == 0) {
+        // Optional core list ("0,2,4-7") and per-thread buffer size in bytes
+        int cores[MT_MAX_CORES];
+        size_t num_cores = parse_core_list(argc > 2 ? argv[2] : NULL, cores, MT_MAX_CORES);
+        size_t total_size = argc > 3 ? strtoull(argv[3], NULL, 0) : 1024 * 1024 * 16;
+        int kernel = argc > 4 ? kernel_from_name(argv[4]) : (int)kernel_best();
+        if (kernel < 0) {
+            fprintf(stderr, "Unknown kernel: %s\n", argv[4]);
+            return 1;
+        }
+        measure_bandwidth_scaling(cores, num_cores, total_size, (bw_kernel_t)kernel);
+    } else if (argc > 1 && strcmp(argv[1], "--loaded-latency") == 0) {
+        // First core probes latency, the rest generate throttled bandwidth
+        int cores[MT_MAX_CORES];
+        size_t num_cores = parse_core_list(argc > 2 ? argv[2] : NULL, cores, MT_MAX_CORES);
+        size_t probe_size = argc > 3 ? strtoull(argv[3], NULL, 0) : 0;
+        double read_ratio = argc > 4 ? atof(argv[4]) : 1.0;
+        int kernel = argc > 5 ? kernel_from_name(argv[5]) : (int)kernel_best();
+        if (kernel < 0) {
+            fprintf(stderr, "Unknown kernel: %s\n", argv[5]);
+            return 1;
+        }
+        measure_loaded_latency(cores, num_cores, probe_size, read_ratio, (bw_kernel_t)kernel);
+    } else if (argc > 1 && strcmp(argv[1], "--numa") == 0) {
+        // Node x node latency and bandwidth, plus interleaved placement
+        size_t size = argc > 2 ? strtoull(argv[2], NULL, 0) : 0;
+        measure_numa_matrix(size);
+    } else if (argc > 1 && strcmp(argv[1], "--tlb") == 0) {
+        // DTLB/STLB reach and page-walk cost for every page size available
+        size_t max_size = argc > 2 ? strtoull(argv[2], NULL, 0) : 0;
+        set_cpu_affinity(0);
+        measure_tlb_reach(max_size);
+    } else if (argc > 1 && strcmp(argv[1], "--kernels") == 0) {
+        // Peak load/store/copy/RMW bandwidth per instruction set
+        size_t total_size = argc > 2 ? strtoull(argv[2], NULL, 0) : 1024 * 1024 * 16;
+        set_cpu_affinity(0);
+        measure_kernel_peak_bandwidth(total_size);
+    } else if (argc > 1 && strcmp(argv[1], "--c2c") == 0) {
+        // Cache-line round trip for every pair in an optional core list
+        int cores[MT_MAX_CORES];
+        size_t num_cores = parse_core_list(argc > 2 ? argv[2] : NULL, cores, MT_MAX_CORES);
+        measure_core_to_core(cores, num_cores);
+    } else if (argc > 1 && strcmp(argv[1], "--contention") == 0) {
+        // False sharing and contended atomics on 1..N threads of an optional core list
+        int cores[MT_MAX_CORES];
+        size_t num_cores = parse_core_list(argc > 2 ? argv[2] : NULL, cores, MT_MAX_CORES);
+        measure_contention(cores, num_cores);
+    } else if (argc > 1 && strcmp(argv[1], "--patterns") == 0) {
+        // Sequential, strided, windowed, gather and 2-D walks; optional bytes, stride, window, tile
+        pattern_params_t params = {
+            .size = argc > 2 ? strtoull(argv[2], NULL, 0) : 1024 * 1024 * 16,
+            .stride = argc > 3 ? strtoull(argv[3], NULL, 0) : 0,
+            .window = argc > 4 ? strtoull(argv[4], NULL, 0) : 0,
+            .tile = argc > 5 ? strtoull(argv[5], NULL, 0) : 0,
+        };
+        set_cpu_affinity(0);
+        measure_patterns(&params);
+    } else if (argc > 1 && strcmp(argv[1], "--prefetch") == 0) {
+        // Prefetch hint x distance sweep for gather and strided walks; optional max bytes
+        size_t max_size = argc > 2 ? strtoull(argv[2], NULL, 0) : 0;
+        set_cpu_affinity(0);
+        measure_prefetch_tuning(max_size);
+    } else if (argc > 1 && strcmp(argv[1], "--memops") == 0) {
+        // memcpy/memset implementations from 16 B to an optional max size in bytes
+        size_t max_size = argc > 2 ? strtoull(argv[2], NULL, 0) : 0;
+        set_cpu_affinity(0);
+        measure_memops(max_size);
+    } else if (argc > 1 && strcmp(argv[1], "--roofline") == 0) {
+        // Compute and bandwidth ceilings; optional --csv, then an optional program to place
+        int csv = argc > 2 && strcmp(argv[2], "--csv") == 0;
+        measure_roofline(argc > 2 + csv ? &argv[2 + csv] : NULL, csv);
+    } else if (argc > 1 && strcmp(argv[1], "--faults") == 0) {
+        // Page-fault cost per populate method and page size; optional bytes and core list
+        size_t size = argc > 2 ? strtoull(argv[2], NULL, 0) : 0;
+        int cores[MT_MAX_CORES];
+        size_t num_cores = parse_core_list(argc > 3 ? argv[3] : NULL, cores, MT_MAX_CORES);
+        measure_page_faults(size, cores, num_cores);
+    } else if (argc > 1 && strcmp(argv[1], "--blocked") == 0) {
+        // Naive vs cache-blocked transpose, matmul and stencil; optional largest transpose N
+        size_t max_n = argc > 2 ? strtoull(argv[2], NULL, 0) : 0;
+        set_cpu_affinity(0);
+        measure_blocked_kernels(max_n);
+    } else if (argc > 1 && strcmp(argv[1], "--cachesim") == 0) {
+        // Pattern ("seq", "stride4k", "chase") or trace file, bytes, optional cache config
+        const char *source = argc > 2 ? argv[2] : "chase";
+        size_t size = argc > 3 ? strtoull(argv[3], NULL, 0) : 0;
+        measure_cache_sim(source, size, argc > 4 ? argv[4] : NULL);
+    } else if (argc > 1) {
+        // Everything after the profiler's own options is the target's argv
+        profile_user_code(&argv[1], sample_interval_ms);
     } else {
         size_t sizes[] = {1024, 1024 * 64, 1024 * 1024, 1024 * 1024 * 16}; // 1KB, 64KB, 1MB, 16MB
         size_t num_sizes = sizeof(sizes) / sizeof(sizes[0]);
@@ -13,6 +187,11 @@ int main(int argc, char **argv) {
         verify_cpu_affinity();
         get_cpu_frequency();
 
+        // Reserve the largest working set once: multiply_and_measure uses 8 bytes per element
+        if (arena_reserve(sizes[num_sizes - 1] * sizeof(double)) != 0) {
+            return 1;
+        }
+
         // Print the header for latencies and bandwidth
         printf("Array Size (Bytes)\tRead Latency (Cycles)\tWrite Latency (Cycles)\n");
         printf("---------------------------------------------------------------\n");
@@ -43,10 +222,10 @@ int main(int argc, char **argv) {
 
             // measure_bandwidth_with_queue(size, 0.5, size, 4);
 
-            // Free the array after each test
-            free((void*)array);
+            // The array is an arena view; just drop the reference
             array = NULL;  // Avoid dangling pointer
         }
+        arena_release();
     }
 
     return 0;
@@ -0,0 +1,355 @@
+#define _GNU_SOURCE
+#include "memops.h"
+#include "arena.h"
+#include "chase.h"
+#include "harness.h"
+#include "profiling.h"
+#include <immintrin.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define MEMOPS_MAX_SIZES 64
+#define MEMOPS_MAX_IMPLS 8
+#define MEMOPS_FILL_BYTE 0x5A
+#define MEMOPS_TIE 0.05             // The previous winner keeps a size it is this close on
+
+// Hundreds of cells: a short budget per cell, still several trials each
+static const bench_config_t memops_config = {
+    .min_trials = 3,
+    .max_trials = 50,
+    .target_ci = 0.02,
+    .time_budget = 0.05,
+    .min_trial_cycles = 100000,
+};
+
+// Below one vector: overlapping head/tail moves, as the libc routines do
+static inline __attribute__((always_inline)) void copy_small(char *dst, const char *src, size_t n) {
+    if (n >= 16) {
+        __m128i head = _mm_loadu_si128((const __m128i *)src);
+        __m128i tail = _mm_loadu_si128((const __m128i *)(src + n - 16));
+        _mm_storeu_si128((__m128i *)dst, head);
+        _mm_storeu_si128((__m128i *)(dst + n - 16), tail);
+    } else if (n >= 8) {
+        uint64_t head, tail;
+        memcpy(&head, src, 8);
+        memcpy(&tail, src + n - 8, 8);
+        memcpy(dst, &head, 8);
+        memcpy(dst + n - 8, &tail, 8);
+    } else {
+        for (size_t i = 0; i < n; i++) {
+            dst[i] = src[i];
+        }
+    }
+}
+
+static inline __attribute__((always_inline)) void fill_small(char *dst, int c, size_t n) {
+    if (n >= 16) {
+        __m128i v = _mm_set1_epi8((char)c);
+        _mm_storeu_si128((__m128i *)dst, v);
+        _mm_storeu_si128((__m128i *)(dst + n - 16), v);
+    } else if (n >= 8) {
+        uint64_t v = 0x0101010101010101ULL * (uint8_t)c;
+        memcpy(dst, &v, 8);
+        memcpy(dst + n - 8, &v, 8);
+    } else {
+        for (size_t i = 0; i < n; i++) {
+            dst[i] = (char)c;
+        }
+    }
+}
+
+// Up to a few vectors: 16-byte chunks plus an overlapping last chunk
+static void copy_medium(char *dst, const char *src, size_t n) {
+    if (n < 16) {
+        copy_small(dst, src, n);
+        return;
+    }
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        copy_small(dst + i, src + i, 16);
+    }
+    if (i < n) {
+        copy_small(dst + n - 16, src + n - 16, 16);
+    }
+}
+
+static void fill_medium(char *dst, int c, size_t n) {
+    if (n < 16) {
+        fill_small(dst, c, n);
+        return;
+    }
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        fill_small(dst + i, c, 16);
+    }
+    if (i < n) {
+        fill_small(dst + n - 16, c, 16);
+    }
+}
+
+static void copy_glibc(void *dst, const void *src, size_t n) {
+    memcpy(dst, src, n);
+}
+
+static void copy_rep_movsb(void *dst, const void *src, size_t n) {
+    __asm__ volatile("rep movsb" : "+D"(dst), "+S"(src), "+c"(n) : : "memory");
+}
+
+// Four unaligned vectors per iteration, the last vector overlapping the end
+#define DEFINE_VECTOR_COPY(SUFFIX, ATTR, VEC, WIDTH, LOAD, STORE)                          \
+ATTR static void copy_##SUFFIX(void *dst_v, const void *src_v, size_t n) {                \
+    char *dst = dst_v;                                                                     \
+    const char *src = src_v;                                                               \
+    if (n < WIDTH) {                                                                       \
+        copy_medium(dst, src, n);                                                          \
+        return;                                                                            \
+    }                                                                                      \
+    size_t i = 0;                                                                          \
+    for (; i + 4 * WIDTH <= n; i += 4 * WIDTH) {                                           \
+        VEC a = LOAD(src + i), b = LOAD(src + i + WIDTH);                                  \
+        VEC c = LOAD(src + i + 2 * WIDTH), d = LOAD(src + i + 3 * WIDTH);                  \
+        STORE(dst + i, a);                                                                 \
+        STORE(dst + i + WIDTH, b);                                                         \
+        STORE(dst + i + 2 * WIDTH, c);                                                     \
+        STORE(dst + i + 3 * WIDTH, d);                                                     \
+    }                                                                                      \
+    for (; i + WIDTH <= n; i += WIDTH) {                                                   \
+        STORE(dst + i, LOAD(src + i));                                                     \
+    }                                                                                      \
+    if (i < n) {                                                                           \
+        STORE(dst + n - WIDTH, LOAD(src + n - WIDTH));                                     \
+    }                                                                                      \
+}                                                                                          \
+ATTR static void fill_##SUFFIX(void *dst_v, const void *src, size_t n) {                  \
+    char *dst = dst_v;                                                                     \
+    (void)src;                                                                             \
+    if (n < WIDTH) {                                                                       \
+        fill_medium(dst, MEMOPS_FILL_BYTE, n);                                             \
+        return;                                                                            \
+    }                                                                                      \
+    VEC v = SPLAT_##SUFFIX(MEMOPS_FILL_BYTE);                                              \
+    size_t i = 0;                                                                          \
+    for (; i + 4 * WIDTH <= n; i += 4 * WIDTH) {                                           \
+        STORE(dst + i, v);                                                                 \
+        STORE(dst + i + WIDTH, v);                                                         \
+        STORE(dst + i + 2 * WIDTH, v);                                                     \
+        STORE(dst + i + 3 * WIDTH, v);                                                     \
+    }                                                                                      \
+    for (; i + WIDTH <= n; i += WIDTH) {                                                   \
+        STORE(dst + i, v);                                                                 \
+    }                                                                                      \
+    if (i < n) {                                                                           \
+        STORE(dst + n - WIDTH, v);                                                         \
+    }                                                                                      \
+}
+
+#define SPLAT_avx2(c) _mm256_set1_epi8((char)(c))
+#define AVX2_LOAD(p) _mm256_loadu_si256((const __m256i *)(p))
+#define AVX2_STORE(p, v) _mm256_storeu_si256((__m256i *)(p), (v))
+DEFINE_VECTOR_COPY(avx2, __attribute__((target("avx2"))), __m256i, 32, AVX2_LOAD, AVX2_STORE)
+
+#define SPLAT_avx512(c) _mm512_set1_epi8((char)(c))
+#define AVX512_LOAD(p) _mm512_loadu_si512((const void *)(p))
+#define AVX512_STORE(p, v) _mm512_storeu_si512((void *)(p), (v))
+DEFINE_VECTOR_COPY(avx512, __attribute__((target("avx512f,avx512bw"))), __m512i, 64, AVX512_LOAD, AVX512_STORE)
+
+// Streaming stores: unaligned head up to a 16-byte dst boundary, movntdq body,
+// overlapping tail, then sfence so the data is globally visible on return
+static void copy_nt(void *dst_v, const void *src_v, size_t n) {
+    char *dst = dst_v;
+    const char *src = src_v;
+    if (n < 64) {
+        copy_medium(dst, src, n);
+        return;
+    }
+    size_t head = (16 - ((uintptr_t)dst & 15)) & 15;
+    if (head) {
+        copy_small(dst, src, 16);
+    }
+    size_t i = head;
+    for (; i + 64 <= n; i += 64) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(src + i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(src + i + 16));
+        __m128i c = _mm_loadu_si128((const __m128i *)(src + i + 32));
+        __m128i d = _mm_loadu_si128((const __m128i *)(src + i + 48));
+        _mm_stream_si128((__m128i *)(dst + i), a);
+        _mm_stream_si128((__m128i *)(dst + i + 16), b);
+        _mm_stream_si128((__m128i *)(dst + i + 32), c);
+        _mm_stream_si128((__m128i *)(dst + i + 48), d);
+    }
+    _mm_sfence();
+    copy_medium(dst + i, src + i, n - i);
+}
+
+static void fill_glibc(void *dst, const void *src, size_t n) {
+    (void)src;
+    memset(dst, MEMOPS_FILL_BYTE, n);
+}
+
+static void fill_rep_stosb(void *dst, const void *src, size_t n) {
+    (void)src;
+    __asm__ volatile("rep stosb" : "+D"(dst), "+c"(n) : "a"(MEMOPS_FILL_BYTE) : "memory");
+}
+
+static void fill_nt(void *dst_v, const void *src, size_t n) {
+    char *dst = dst_v;
+    (void)src;
+    if (n < 64) {
+        fill_medium(dst, MEMOPS_FILL_BYTE, n);
+        return;
+    }
+    __m128i v = _mm_set1_epi8((char)MEMOPS_FILL_BYTE);
+    size_t head = (16 - ((uintptr_t)dst & 15)) & 15;
+    if (head) {
+        _mm_storeu_si128((__m128i *)dst, v);
+    }
+    size_t i = head;
+    for (; i + 64 <= n; i += 64) {
+        _mm_stream_si128((__m128i *)(dst + i), v);
+        _mm_stream_si128((__m128i *)(dst + i + 16), v);
+        _mm_stream_si128((__m128i *)(dst + i + 32), v);
+        _mm_stream_si128((__m128i *)(dst + i + 48), v);
+    }
+    _mm_sfence();
+    fill_medium(dst + i, MEMOPS_FILL_BYTE, n - i);
+}
+
+static int always_supported(void) {
+    return 1;
+}
+
+static int avx2_supported(void) {
+    return __builtin_cpu_supports("avx2");
+}
+
+static int avx512_supported(void) {
+    return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw");
+}
+
+typedef struct {
+    const char *name;
+    int (*supported)(void);
+    memop_fn_t fn;
+} memop_impl_t;
+
+static const memop_impl_t copy_impls[] = {
+    {"memcpy",    always_supported, copy_glibc},
+    {"rep movsb", always_supported, copy_rep_movsb},
+    {"avx2",      avx2_supported,   copy_avx2},
+    {"avx512",    avx512_supported, copy_avx512},
+    {"nt",        always_supported, copy_nt},
+};
+
+static const memop_impl_t fill_impls[] = {
+    {"memset",    always_supported, fill_glibc},
+    {"rep stosb", always_supported, fill_rep_stosb},
+    {"avx2",      avx2_supported,   fill_avx2},
+    {"avx512",    avx512_supported, fill_avx512},
+    {"nt",        always_supported, fill_nt},
+};
+
+static const char *kind_names[MEMOP_KIND_COUNT] = {"Copy", "Fill"};
+
+// Harness trial: 'reps' back-to-back calls on the same buffers
+typedef struct {
+    memop_fn_t fn;
+    char *dst;
+    const char *src;
+    size_t size;
+} memop_trial_t;
+
+static void memop_trial(void *ctx, size_t reps) {
+    memop_trial_t *trial = ctx;
+    for (size_t r = 0; r < reps; r++) {
+        trial->fn(trial->dst, trial->src, trial->size);
+        __asm__ volatile("" ::: "memory");  // Keep every call: the stores must happen each rep
+    }
+}
+
+// One table per kind and alignment, then the sizes where the winner changes
+static void memop_table(memop_kind_t kind, const memop_impl_t *impls, size_t num_impls,
+                        char *src, char *dst, const size_t *sizes, size_t num_sizes,
+                        double cpu_frequency) {
+    int best_of[MEMOPS_MAX_SIZES];
+    printf("\n%s, src+%zu dst+%zu (GB/s of payload)\nSize (B)", kind_names[kind],
+           (size_t)((uintptr_t)src & 63), (size_t)((uintptr_t)dst & 63));
+    for (size_t m = 0; m < num_impls; m++) {
+        if (impls[m].supported()) {
+            printf("\t%-9s", impls[m].name);
+        }
+    }
+    printf("\tBest\n");
+
+    for (size_t s = 0; s < num_sizes; s++) {
+        double gbps_of[MEMOPS_MAX_IMPLS] = {0};
+        double best = 0.0;
+        best_of[s] = -1;
+        printf("%-8zu", sizes[s]);
+        for (size_t m = 0; m < num_impls; m++) {
+            if (!impls[m].supported()) {
+                continue;
+            }
+            memop_trial_t trial = {impls[m].fn, dst, src, sizes[s]};
+            memop_trial(&trial, 1);  // Warm-up
+            double cycles = bench_run(memop_trial, &trial, &memops_config, NULL);
+            double gbps = cycles > 0 ? sizes[s] / (cycles / cpu_frequency) / 1e9 : 0.0;
+            gbps_of[m] = gbps;
+            if (gbps > best) {
+                best = gbps;
+                best_of[s] = (int)m;
+            }
+            printf("\t%-9.2f", gbps);
+        }
+        // Near-ties do not count as crossovers: noise would make the winner flap
+        if (s > 0 && best_of[s - 1] >= 0 && gbps_of[best_of[s - 1]] >= (1.0 - MEMOPS_TIE) * best) {
+            best_of[s] = best_of[s - 1];
+        }
+        printf("\t%s\n", best_of[s] >= 0 ? impls[best_of[s]].name : "-");
+    }
+
+    // Sizes where the fastest implementation changes
+    printf("Crossovers:");
+    for (size_t s = 0; s < num_sizes; s++) {
+        if (best_of[s] >= 0 && (s == 0 || best_of[s] != best_of[s - 1])) {
+            printf(" %s from %zu B;", impls[best_of[s]].name, sizes[s]);
+        }
+    }
+    printf("\n");
+}
+
+void measure_memops(size_t max_size) {
+    double cpu_frequency = get_cpu_frequency();
+    size_t sizes[MEMOPS_MAX_SIZES];
+    size_t num_sizes = 0;
+
+    if (max_size == 0) {
+        max_size = chase_dram_size() / 2;  // Two buffers: the pair stays within the DRAM default
+    }
+    for (size_t size = MEMOPS_MIN_SIZE; size <= max_size && num_sizes < MEMOPS_MAX_SIZES; size *= 2) {
+        sizes[num_sizes++] = size;
+    }
+    if (num_sizes == 0) {
+        fprintf(stderr, "Largest size must be at least %d bytes\n", MEMOPS_MIN_SIZE);
+        return;
+    }
+
+    // src and dst from one arena view, dst on the page after src plus the misalignment slack
+    size_t span = (max_size + 64 + 4095) / 4096 * 4096;
+    char *src = arena_view(2 * span, 0);
+    if (src == NULL) {
+        return;
+    }
+    char *dst = src + span;
+
+    printf("memcpy/memset shootout, %d B to %zu B\n", MEMOPS_MIN_SIZE, sizes[num_sizes - 1]);
+    const size_t num_copy = sizeof(copy_impls) / sizeof(copy_impls[0]);
+    const size_t num_fill = sizeof(fill_impls) / sizeof(fill_impls[0]);
+
+    memop_table(MEMOP_COPY, copy_impls, num_copy, src, dst, sizes, num_sizes, cpu_frequency);
+    memop_table(MEMOP_COPY, copy_impls, num_copy, src + MEMOPS_MISALIGN_SRC, dst + MEMOPS_MISALIGN_DST,
+                sizes, num_sizes, cpu_frequency);
+    memop_table(MEMOP_FILL, fill_impls, num_fill, src, dst, sizes, num_sizes, cpu_frequency);
+    memop_table(MEMOP_FILL, fill_impls, num_fill, src, dst + MEMOPS_MISALIGN_DST,
+                sizes, num_sizes, cpu_frequency);
+}
@@ -0,0 +1,24 @@
+#ifndef MEMOPS_H
+#define MEMOPS_H
+
+#include <stddef.h>
+
+#define MEMOPS_MIN_SIZE 16
+#define MEMOPS_MISALIGN_SRC 1    // Byte offsets of the misaligned runs
+#define MEMOPS_MISALIGN_DST 33
+
+// Copy or fill routine under test; fills ignore src
+typedef void (*memop_fn_t)(void *dst, const void *src, size_t size);
+
+typedef enum {
+    MEMOP_COPY,
+    MEMOP_FILL,
+    MEMOP_KIND_COUNT
+} memop_kind_t;
+
+// glibc memcpy/memset against rep movsb/stosb, AVX2 and AVX-512 loops and
+// streaming stores, 16 B to max_size (0: past the LLC), aligned and misaligned.
+// Reports GB/s per size and the sizes where the fastest implementation changes
+void measure_memops(size_t max_size);
+
+#endif // MEMOPS_H
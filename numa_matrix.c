@@ -0,0 +1,235 @@
+#define _GNU_SOURCE
+#include "numa_matrix.h"
+#include "bandwidth_mt.h"
+#include "chase.h"
+#include "harness.h"
+#include "kernels.h"
+#include "profiling.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#ifdef HAVE_LIBNUMA
+#include <numa.h>
+#endif
+
+// Memory policy modes from <linux/mempolicy.h>; spelled out so the build
+// needs neither libnuma nor its headers
+#define NODE_MPOL_BIND 2
+#define NODE_MPOL_INTERLEAVE 3
+#define NODE_MPOL_MF_STRICT (1 << 0)
+#define NODE_MPOL_MF_MOVE (1 << 1)
+
+#define NODE_MASK_WORDS (NODE_MAX / (8 * sizeof(unsigned long)))
+
+// Reads a sysfs list file ("0-1,4") into ids; 0 if the file is missing or empty
+// (a memory-only node has an empty cpulist)
+static size_t read_sysfs_list(const char *path, int *ids, size_t max_ids) {
+    char line[1024];
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL) {
+        return 0;
+    }
+    if (fgets(line, sizeof(line), fp) == NULL) {
+        fclose(fp);
+        return 0;
+    }
+    fclose(fp);
+    line[strcspn(line, "\n")] = '\0';
+    return line[0] != '\0' ? parse_core_list(line, ids, max_ids) : 0;
+}
+
+size_t node_list(int *nodes, size_t max_nodes) {
+    size_t count = 0;
+#ifdef HAVE_LIBNUMA
+    if (numa_available() >= 0) {
+        for (int n = 0; n <= numa_max_node() && count < max_nodes; n++) {
+            if (numa_bitmask_isbitset(numa_all_nodes_ptr, n)) {
+                nodes[count++] = n;
+            }
+        }
+    }
+#endif
+    if (count == 0) {
+        count = read_sysfs_list("/sys/devices/system/node/online", nodes, max_nodes);
+    }
+    // Ids past NODE_MAX do not fit the policy masks
+    size_t kept = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (nodes[i] < NODE_MAX) {
+            nodes[kept++] = nodes[i];
+        }
+    }
+    if (kept == 0 && max_nodes > 0) {
+        nodes[kept++] = 0;
+    }
+    return kept;
+}
+
+size_t node_cpus(int node, int *cpus, size_t max_cpus) {
+    char path[128];
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+    size_t count = read_sysfs_list(path, cpus, max_cpus);
+    if (count == 0 && node == 0) {
+        count = parse_core_list(NULL, cpus, max_cpus);
+    }
+    return count;
+}
+
+void *node_alloc(size_t size, int node) {
+    int nodes[NODE_MAX];
+    size_t num_nodes = node_list(nodes, NODE_MAX);
+#ifdef HAVE_LIBNUMA
+    if (numa_available() >= 0) {
+        void *numa_buf = node == NODE_INTERLEAVE ? numa_alloc_interleaved(size)
+                                                 : numa_alloc_onnode(size, node);
+        if (numa_buf != NULL) {
+            memset(numa_buf, 0, size);  // Fault every page in under the policy
+        }
+        return numa_buf;
+    }
+#endif
+    void *buf = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buf == MAP_FAILED) {
+        perror("mmap");
+        return NULL;
+    }
+
+    // Policy must be set before first touch; single-node systems skip it
+    if (num_nodes > 1) {
+        unsigned long mask[NODE_MASK_WORDS] = {0};
+        int mode = NODE_MPOL_BIND;
+        if (node == NODE_INTERLEAVE) {
+            mode = NODE_MPOL_INTERLEAVE;
+            for (size_t i = 0; i < num_nodes; i++) {
+                int n = nodes[i];
+                mask[n / (8 * sizeof(unsigned long))] |= 1UL << (n % (8 * sizeof(unsigned long)));
+            }
+        } else {
+            mask[node / (8 * sizeof(unsigned long))] |= 1UL << (node % (8 * sizeof(unsigned long)));
+        }
+        if (syscall(SYS_mbind, buf, size, mode, mask, (unsigned long)NODE_MAX,
+                    NODE_MPOL_MF_STRICT | NODE_MPOL_MF_MOVE) != 0) {
+            perror("mbind");
+            munmap(buf, size);
+            return NULL;
+        }
+    }
+
+    memset(buf, 0, size);  // Fault every page in under the policy
+    return buf;
+}
+
+void node_free(void *buf, size_t size) {
+    if (buf != NULL) {
+#ifdef HAVE_LIBNUMA
+        if (numa_available() >= 0) {
+            numa_free(buf, size);
+            return;
+        }
+#endif
+        munmap(buf, size);
+    }
+}
+
+typedef struct {
+    bw_kernel_t kernel;
+    const char *buf;
+    size_t size;
+} node_read_t;
+
+static void node_read_trial(void *ctx, size_t reps) {
+    node_read_t *read = ctx;
+    kernel_op_pass(read->kernel, OP_LOAD, NULL, read->buf, read->size, reps);
+}
+
+// Single-threaded streaming read bandwidth over buf, bytes per second; -1 on failure
+static double node_read_bandwidth(void *buf, size_t size, double cpu_frequency) {
+    node_read_t read = {kernel_best(), buf, size};
+    double cycles = bench_run(node_read_trial, &read, NULL, NULL);
+    return cycles > 0 ? kernel_op_bytes(OP_LOAD, size / 256 * 256) / (cycles / cpu_frequency) : -1.0;
+}
+
+void measure_numa_matrix(size_t size) {
+    double cpu_frequency = get_cpu_frequency();
+    int node_ids[NODE_MAX];
+    size_t nodes = node_list(node_ids, NODE_MAX);
+    if (size == 0) {
+        size = chase_dram_size();
+    }
+
+    // Rows: CPU node; columns: memory node, then the interleaved policy.
+    // Cells stay -1 (printed n/a) unless they were measured
+    size_t cols = nodes + 1;
+    double *latency = malloc(nodes * cols * sizeof(double));
+    double *bandwidth = malloc(nodes * cols * sizeof(double));
+    if (latency == NULL || bandwidth == NULL) {
+        perror("Failed to allocate result matrix");
+        free(latency);
+        free(bandwidth);
+        return;
+    }
+    for (size_t i = 0; i < nodes * cols; i++) {
+        latency[i] = -1.0;
+        bandwidth[i] = -1.0;
+    }
+
+    printf("NUMA placement matrix: %zu node(s), %zu byte buffers\n", nodes, size);
+    // Rows and columns are positions in node_ids, which may skip ids
+    for (size_t cpu_node = 0; cpu_node < nodes; cpu_node++) {
+        int cpus[MT_MAX_CORES];
+        if (node_cpus(node_ids[cpu_node], cpus, MT_MAX_CORES) == 0) {
+            printf("Node %d has no CPUs; skipping its row\n", node_ids[cpu_node]);
+            continue;
+        }
+        if (try_set_cpu_affinity(cpus[0]) != 0) {
+            perror("sched_setaffinity");
+            continue;
+        }
+
+        for (size_t col = 0; col < cols; col++) {
+            int mem_node = col < nodes ? node_ids[col] : NODE_INTERLEAVE;
+            void *buf = node_alloc(size, mem_node);
+            if (buf == NULL) {
+                continue;
+            }
+            double cycles = chase_buffer_cycles(buf, size);
+            double bytes_per_second = node_read_bandwidth(buf, size, cpu_frequency);
+            if (cycles > 0) {
+                latency[cpu_node * cols + col] = cycles * 1e9 / cpu_frequency;
+            }
+            if (bytes_per_second > 0) {
+                bandwidth[cpu_node * cols + col] = bytes_per_second / 1e9;
+            }
+            node_free(buf, size);
+        }
+    }
+
+    const char *titles[2] = {"Latency (ns)", "Read Bandwidth (GB/s)"};
+    double *tables[2] = {latency, bandwidth};
+    for (int t = 0; t < 2; t++) {
+        printf("\n%s: rows = CPU node, columns = memory node\n", titles[t]);
+        printf("CPU\\Mem");
+        for (size_t col = 0; col < nodes; col++) {
+            printf("\tNode %d", node_ids[col]);
+        }
+        printf("\tInterleaved\n");
+        for (size_t row = 0; row < nodes; row++) {
+            printf("Node %d", node_ids[row]);
+            for (size_t col = 0; col < cols; col++) {
+                double value = tables[t][row * cols + col];
+                if (value < 0) {
+                    printf("\tn/a");
+                } else {
+                    printf("\t%.2f", value);
+                }
+            }
+            printf("\n");
+        }
+    }
+
+    free(latency);
+    free(bandwidth);
+}
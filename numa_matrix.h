@@ -0,0 +1,21 @@
+#ifndef NUMA_MATRIX_H
+#define NUMA_MATRIX_H
+
+#include <stddef.h>
+
+#define NODE_MAX 64         // Upper bound on NUMA nodes handled
+#define NODE_INTERLEAVE (-1) // Pseudo-node: pages spread round-robin over all nodes
+
+// Ids of the online NUMA nodes, ascending; they need not be contiguous ("0,2" after
+// hot-unplug, CPU-less CXL nodes). Just node 0 on machines (or kernels) without NUMA
+size_t node_list(int *nodes, size_t max_nodes);
+// CPUs of a node; falls back to the current affinity mask on single-node systems
+size_t node_cpus(int node, int *cpus, size_t max_cpus);
+// Page-aligned buffer whose pages are bound to 'node' (or NODE_INTERLEAVE), pre-faulted
+void *node_alloc(size_t size, int node);
+void node_free(void *buf, size_t size);
+
+// Latency and read bandwidth from the first CPU of every node to memory on every node
+void measure_numa_matrix(size_t size);
+
+#endif // NUMA_MATRIX_H
@@ -0,0 +1,215 @@
+#define _GNU_SOURCE
+#include "pages.h"
+#include "chase.h"
+#include "profiling.h"
+#include "events.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+#ifndef MAP_HUGE_2MB
+#define MAP_HUGE_2MB (21 << MAP_HUGE_SHIFT)
+#endif
+#ifndef MAP_HUGE_1GB
+#define MAP_HUGE_1GB (30 << MAP_HUGE_SHIFT)
+#endif
+
+#ifndef MADV_POPULATE_WRITE
+#define MADV_POPULATE_WRITE 23
+#endif
+
+#define TLB_STRIDE 4096          // One chain element per 4 KiB region
+#define TLB_MIN_PAGES 16
+#define TLB_COUNT_LOADS (1UL << 20)
+
+page_policy_t page_policy = PAGE_DEFAULT;
+
+static const char *policy_names[PAGE_POLICY_COUNT] = {"default", "4k", "thp", "2m", "1g"};
+static const size_t policy_sizes[PAGE_POLICY_COUNT] = {
+    4096, 4096, 2UL * 1024 * 1024, 2UL * 1024 * 1024, 1024UL * 1024 * 1024
+};
+
+const char *page_policy_name(page_policy_t policy) {
+    return policy < PAGE_POLICY_COUNT ? policy_names[policy] : "unknown";
+}
+
+int page_policy_from_name(const char *name) {
+    for (int p = 0; p < PAGE_POLICY_COUNT; p++) {
+        if (strcmp(name, policy_names[p]) == 0) {
+            return p;
+        }
+    }
+    return -1;
+}
+
+size_t page_policy_size(page_policy_t policy) {
+    return policy < PAGE_POLICY_COUNT ? policy_sizes[policy] : 4096;
+}
+
+static size_t round_up(size_t size, size_t align) {
+    return (size + align - 1) / align * align;
+}
+
+void *page_alloc(size_t size, page_policy_t policy) {
+    return page_alloc_flags(size, policy, 0);
+}
+
+void *page_alloc_flags(size_t size, page_policy_t policy, int extra_flags) {
+    size_t page = page_policy_size(policy);
+    size_t length = round_up(size, page);
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS | extra_flags;
+    void *buf;
+
+    switch (policy) {
+    case PAGE_2M:
+    case PAGE_1G:
+        flags |= MAP_HUGETLB | (policy == PAGE_2M ? MAP_HUGE_2MB : MAP_HUGE_1GB);
+        buf = mmap(NULL, length, PROT_READ | PROT_WRITE, flags, -1, 0);
+        if (buf == MAP_FAILED) {
+            fprintf(stderr, "MAP_HUGETLB %s mapping of %zu bytes failed (are huge pages reserved?)\n",
+                    page_policy_name(policy), length);
+            return NULL;
+        }
+        return buf;
+
+    case PAGE_THP: {
+        // Over-map by one huge page and trim, so the buffer starts 2 MiB aligned
+        char *raw = mmap(NULL, length + page, PROT_READ | PROT_WRITE, flags & ~MAP_POPULATE, -1, 0);
+        if (raw == MAP_FAILED) {
+            perror("mmap");
+            return NULL;
+        }
+        char *aligned = (char *)round_up((uintptr_t)raw, page);
+        if (aligned > raw) {
+            munmap(raw, aligned - raw);
+        }
+        munmap(aligned + length, raw + page - aligned);
+        if (madvise(aligned, length, MADV_HUGEPAGE) != 0) {
+            perror("madvise(MADV_HUGEPAGE)");
+        }
+        // Populating at mmap time would fault small pages before the advice applies
+        if ((extra_flags & MAP_POPULATE) && madvise(aligned, length, MADV_POPULATE_WRITE) != 0) {
+            perror("madvise(MADV_POPULATE_WRITE)");
+        }
+        return aligned;
+    }
+
+    default:
+        buf = mmap(NULL, length, PROT_READ | PROT_WRITE, flags, -1, 0);
+        if (buf == MAP_FAILED) {
+            perror("mmap");
+            return NULL;
+        }
+        if (policy == PAGE_4K && madvise(buf, length, MADV_NOHUGEPAGE) != 0) {
+            perror("madvise(MADV_NOHUGEPAGE)");
+        }
+        return buf;
+    }
+}
+
+void page_free(void *buf, size_t size, page_policy_t policy) {
+    if (buf != NULL) {
+        munmap(buf, round_up(size, page_policy_size(policy)));
+    }
+}
+
+// Data TLB miss event set, opened on first use; -1 once it is known to be unavailable
+static event_set_t tlb_events;
+static int tlb_counters_state = 0;
+
+static int tlb_counters_ready(void) {
+    if (tlb_counters_state == 0) {
+        tlb_counters_state = event_set_open(&tlb_events, 1u << EVENT_DTLB_MISSES) > 0 ? 1 : -1;
+    }
+    return tlb_counters_state == 1;
+}
+
+// Data TLB misses per load over a fixed walk, or -1 without counters
+static double tlb_misses_per_load(void **head) {
+    double values[EVENT_COUNT];
+    if (!tlb_counters_ready() || event_set_start(&tlb_events) != 0) {
+        return -1.0;
+    }
+    chase_sink = chase_walk(head, TLB_COUNT_LOADS);
+    if (event_set_stop(&tlb_events, values) != 0) {
+        return -1.0;
+    }
+    return values[EVENT_DTLB_MISSES] / TLB_COUNT_LOADS;
+}
+
+static void tlb_sweep(page_policy_t policy, size_t max_size, double cpu_freq) {
+    chase_point_t points[CHASE_MAX_POINTS];
+    double misses[CHASE_MAX_POINTS];
+    cache_level_t levels[CHASE_MAX_LEVELS];
+
+    char *buf = page_alloc(max_size, policy);
+    if (buf == NULL) {
+        printf("\n%s pages: not available, skipped\n", page_policy_name(policy));
+        return;
+    }
+    memset(buf, 0, max_size);
+
+    printf("\n%s pages (%zu bytes each)\n", page_policy_name(policy), page_policy_size(policy));
+    printf("4K Regions\tSpan (Bytes)\tLatency (ns)\tLatency (Cycles)\tDTLB Misses/Load\n");
+    printf("------------------------------------------------------------------------------\n");
+
+    size_t num_points = 0;
+    size_t max_pages = max_size / TLB_STRIDE;
+    for (size_t pow2 = TLB_MIN_PAGES; pow2 <= max_pages && num_points < CHASE_MAX_POINTS; pow2 *= 2) {
+        size_t candidates[2] = {pow2, pow2 + pow2 / 2};
+        for (size_t c = 0; c < 2 && candidates[c] <= max_pages && num_points < CHASE_MAX_POINTS; c++) {
+            size_t pages = candidates[c];
+            void **head = chase_build_staggered(buf, pages * TLB_STRIDE, TLB_STRIDE, pages);
+            if (head == NULL) {
+                break;
+            }
+            chase_point_t *point = &points[num_points];
+            point->size = pages * TLB_STRIDE;
+            point->cycles_per_load = chase_head_cycles(head, pages);
+            point->ns_per_load = point->cycles_per_load * 1e9 / cpu_freq;
+            misses[num_points] = tlb_misses_per_load(head);
+
+            printf("%-10zu\t%-12zu\t%-12.2f\t%-16.2f\t", pages, point->size,
+                   point->ns_per_load, point->cycles_per_load);
+            if (misses[num_points] < 0) {
+                printf("n/a\n");
+            } else {
+                printf("%.3f\n", misses[num_points]);
+            }
+            num_points++;
+        }
+    }
+
+    // Plateaus in order: first-level DTLB hits, STLB hits, then page walks
+    static const char *labels[] = {"DTLB", "STLB", "Walk"};
+    size_t num_levels = detect_cache_levels(points, num_points, levels, CHASE_MAX_LEVELS);
+    for (size_t i = 0; i < num_levels; i++) {
+        printf("%-6s reach up to %zu regions (%zu bytes): %.2f ns\n",
+               labels[i < 2 ? i : 2], levels[i].last_size / TLB_STRIDE,
+               levels[i].last_size, levels[i].ns_per_load);
+    }
+    if (num_levels > 1) {
+        printf("Page-walk penalty: %.2f ns (%.2f cycles) over the first plateau\n",
+               levels[num_levels - 1].ns_per_load - levels[0].ns_per_load,
+               levels[num_levels - 1].cycles_per_load - levels[0].cycles_per_load);
+    }
+
+    page_free(buf, max_size, policy);
+}
+
+void measure_tlb_reach(size_t max_size) {
+    double cpu_freq = get_cpu_frequency();
+    if (max_size == 0) {
+        max_size = 256UL * 1024 * 1024;  // 64Ki 4 KiB regions: past any STLB
+    }
+
+    printf("TLB reach sweep: one cache line per %d byte region, random order\n", TLB_STRIDE);
+    printf("(Large spans also outgrow the data caches; read the DTLB column alongside latency.)\n");
+    for (int policy = PAGE_4K; policy < PAGE_POLICY_COUNT; policy++) {
+        tlb_sweep((page_policy_t)policy, max_size, cpu_freq);
+    }
+}
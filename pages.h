@@ -0,0 +1,33 @@
+#ifndef PAGES_H
+#define PAGES_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Page-size policy for test buffers
+typedef enum {
+    PAGE_DEFAULT,   // Plain anonymous mmap; the system THP setting decides
+    PAGE_4K,        // madvise(MADV_NOHUGEPAGE): 4 KiB pages even with THP=always
+    PAGE_THP,       // 2 MiB aligned + madvise(MADV_HUGEPAGE)
+    PAGE_2M,        // MAP_HUGETLB 2 MiB (needs vm.nr_hugepages)
+    PAGE_1G,        // MAP_HUGETLB 1 GiB (needs boot-time reservation)
+    PAGE_POLICY_COUNT
+} page_policy_t;
+
+extern page_policy_t page_policy;  // Policy used by the latency and bandwidth tests
+
+const char *page_policy_name(page_policy_t policy);
+// Parse "default", "4k", "thp", "2m" or "1g"; -1 if unknown
+int page_policy_from_name(const char *name);
+size_t page_policy_size(page_policy_t policy);
+
+// Anonymous mapping of at least 'size' bytes under 'policy'; NULL on failure
+void *page_alloc(size_t size, page_policy_t policy);
+// Same, with extra mmap flags (e.g. MAP_POPULATE; under THP it is applied after the advice)
+void *page_alloc_flags(size_t size, page_policy_t policy, int extra_flags);
+void page_free(void *buf, size_t size, page_policy_t policy);
+
+// One line per 4 KiB region, random order: finds DTLB/STLB reach and walk cost
+void measure_tlb_reach(size_t max_size);
+
+#endif // PAGES_H
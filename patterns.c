@@ -0,0 +1,271 @@
+#define _GNU_SOURCE
+#include "patterns.h"
+#include "arena.h"
+#include "chase.h"
+#include "events.h"
+#include "harness.h"
+#include "profiling.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PATTERN_DEFAULT_STRIDE 256
+#define PATTERN_DEFAULT_WINDOW 4096
+#define PATTERN_DEFAULT_TILE 32
+
+volatile uint64_t pattern_sink;
+
+static const char *pattern_names[PATTERN_COUNT] = {
+    "seq", "stride", "window", "gather", "row", "column", "tiled"
+};
+
+const char *pattern_name(pattern_t pattern) {
+    return pattern < PATTERN_COUNT ? pattern_names[pattern] : "unknown";
+}
+
+int pattern_from_name(const char *name) {
+    for (int p = 0; p < PATTERN_COUNT; p++) {
+        if (strcmp(name, pattern_names[p]) == 0) {
+            return p;
+        }
+    }
+    return -1;
+}
+
+static uint64_t xorshift64(uint64_t *state) {
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *state = x;
+    return x;
+}
+
+// One kernel per pattern: plain loops, no per-access branch or RNG
+static uint64_t seq_kernel(const pattern_ctx_t *ctx) {
+    const uint64_t *buf = ctx->buf;
+    uint64_t sum = 0;
+    for (size_t i = 0; i < ctx->elements; i++) {
+        sum += buf[i];
+    }
+    return sum;
+}
+
+static uint64_t stride_kernel(const pattern_ctx_t *ctx) {
+    const uint64_t *buf = ctx->buf;
+    uint64_t sum = 0;
+    for (size_t start = 0; start < ctx->stride; start++) {
+        for (size_t i = start; i < ctx->elements; i += ctx->stride) {
+            sum += buf[i];
+        }
+    }
+    return sum;
+}
+
+static uint64_t window_kernel(const pattern_ctx_t *ctx) {
+    void **p = ctx->head;
+    for (size_t i = 0; i < ctx->accesses; i++) {
+        p = (void **)*p;
+    }
+    return (uint64_t)(uintptr_t)p;
+}
+
+static uint64_t gather_kernel(const pattern_ctx_t *ctx) {
+    const uint64_t *buf = ctx->buf;
+    const uint32_t *index = ctx->index;
+    uint64_t sum = 0;
+    for (size_t i = 0; i < ctx->accesses; i++) {
+        sum += buf[index[i]];
+    }
+    return sum;
+}
+
+static uint64_t row_kernel(const pattern_ctx_t *ctx) {
+    const uint64_t *m = ctx->buf;
+    size_t n = ctx->side;
+    uint64_t sum = 0;
+    for (size_t r = 0; r < n; r++) {
+        for (size_t c = 0; c < n; c++) {
+            sum += m[r * n + c];
+        }
+    }
+    return sum;
+}
+
+static uint64_t column_kernel(const pattern_ctx_t *ctx) {
+    const uint64_t *m = ctx->buf;
+    size_t n = ctx->side;
+    uint64_t sum = 0;
+    for (size_t c = 0; c < n; c++) {
+        for (size_t r = 0; r < n; r++) {
+            sum += m[r * n + c];
+        }
+    }
+    return sum;
+}
+
+static uint64_t tiled_kernel(const pattern_ctx_t *ctx) {
+    const uint64_t *m = ctx->buf;
+    size_t n = ctx->side, t = ctx->tile;
+    uint64_t sum = 0;
+    for (size_t rt = 0; rt < n; rt += t) {
+        size_t r_end = rt + t < n ? rt + t : n;
+        for (size_t ct = 0; ct < n; ct += t) {
+            size_t c_end = ct + t < n ? ct + t : n;
+            for (size_t r = rt; r < r_end; r++) {
+                for (size_t c = ct; c < c_end; c++) {
+                    sum += m[r * n + c];
+                }
+            }
+        }
+    }
+    return sum;
+}
+
+static uint64_t (*const pattern_kernels[PATTERN_COUNT])(const pattern_ctx_t *) = {
+    seq_kernel, stride_kernel, window_kernel, gather_kernel, row_kernel, column_kernel, tiled_kernel
+};
+
+void pattern_run(pattern_ctx_t *ctx, size_t passes) {
+    uint64_t (*kernel)(const pattern_ctx_t *) = pattern_kernels[ctx->pattern];
+    uint64_t sum = 0;
+    for (size_t pass = 0; pass < passes; pass++) {
+        sum += kernel(ctx);
+    }
+    pattern_sink = sum;
+}
+
+// Random chain inside each window; the last line of a window links to the next window's head
+static void **build_windows(char *buf, size_t size, size_t window) {
+    size_t windows = size / window;
+    size_t lines = window / CHASE_STRIDE;
+    void **first = NULL, **tail = NULL;
+
+    for (size_t w = 0; w < windows; w++) {
+        void **head = chase_build(buf + w * window, window, CHASE_STRIDE, w + 1);
+        if (head == NULL) {
+            return NULL;
+        }
+        if (tail != NULL) {
+            *tail = head;
+        } else {
+            first = head;
+        }
+        // The window's cycle closes on its head; find that element to reroute it
+        tail = head;
+        for (size_t i = 1; i < lines; i++) {
+            tail = (void **)*tail;
+        }
+    }
+    if (tail != NULL) {
+        *tail = first;
+    }
+    return first;
+}
+
+int pattern_prepare(pattern_ctx_t *ctx, pattern_t pattern, void *buf, const pattern_params_t *params) {
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->pattern = pattern;
+    ctx->buf = buf;
+    ctx->elements = params->size / sizeof(uint64_t);
+    ctx->accesses = ctx->elements;
+    if (ctx->elements == 0 || ctx->elements > UINT32_MAX) {
+        fprintf(stderr, "Pattern working set must be 8 bytes to 32 GiB\n");
+        return -1;
+    }
+
+    switch (pattern) {
+    case PATTERN_SEQ:
+        break;
+    case PATTERN_STRIDE:
+        ctx->stride = (params->stride ? params->stride : PATTERN_DEFAULT_STRIDE) / sizeof(uint64_t);
+        if (ctx->stride == 0) {
+            ctx->stride = 1;
+        }
+        break;
+    case PATTERN_WINDOW: {
+        size_t window = params->window ? params->window : PATTERN_DEFAULT_WINDOW;
+        window = window / CHASE_STRIDE * CHASE_STRIDE;
+        if (window < 2 * CHASE_STRIDE || window > params->size) {
+            fprintf(stderr, "Window must be at least %d bytes and at most the working set\n",
+                    2 * CHASE_STRIDE);
+            return -1;
+        }
+        ctx->head = build_windows(buf, params->size / window * window, window);
+        ctx->accesses = params->size / window * (window / CHASE_STRIDE);
+        if (ctx->head == NULL) {
+            return -1;
+        }
+        break;
+    }
+    case PATTERN_GATHER: {
+        ctx->index = malloc(ctx->elements * sizeof(uint32_t));
+        if (ctx->index == NULL) {
+            perror("Failed to allocate gather index");
+            return -1;
+        }
+        uint64_t state = 0x2545F4914F6CDD1DULL;
+        for (size_t i = 0; i < ctx->elements; i++) {
+            ctx->index[i] = (uint32_t)(xorshift64(&state) % ctx->elements);
+        }
+        break;
+    }
+    case PATTERN_ROW:
+    case PATTERN_COLUMN:
+    case PATTERN_TILED:
+        ctx->side = (size_t)sqrt((double)ctx->elements);
+        ctx->tile = params->tile ? params->tile : PATTERN_DEFAULT_TILE;
+        ctx->accesses = ctx->side * ctx->side;
+        break;
+    default:
+        return -1;
+    }
+    return 0;
+}
+
+void pattern_release(pattern_ctx_t *ctx) {
+    free(ctx->index);
+    ctx->index = NULL;
+}
+
+static void pattern_trial(void *ctx, size_t reps) {
+    pattern_run(ctx, reps);
+}
+
+void measure_patterns(const pattern_params_t *params) {
+    double cpu_frequency = get_cpu_frequency();
+    void *buf = arena_view(params->size, 0);
+    if (buf == NULL) {
+        return;
+    }
+    arena_fill(buf, params->size);
+
+    printf("Access patterns over %zu bytes (stride %zu B, window %zu B, tile %zu)\n", params->size,
+           params->stride ? params->stride : PATTERN_DEFAULT_STRIDE,
+           params->window ? params->window : PATTERN_DEFAULT_WINDOW,
+           params->tile ? params->tile : PATTERN_DEFAULT_TILE);
+    printf("Pattern\t\tAccesses/Pass\tLatency (ns/access)\tBandwidth (GB/s)");
+    event_print_header();
+    printf("\n");
+    printf("---------------------------------------------------------------\n");
+
+    for (int p = 0; p < PATTERN_COUNT; p++) {
+        pattern_ctx_t ctx;
+        if (pattern_prepare(&ctx, (pattern_t)p, buf, params) != 0) {
+            printf("%-8s\tskipped\n", pattern_names[p]);
+            continue;
+        }
+        pattern_run(&ctx, 1);  // Warm-up
+        bench_stats_t stats;
+        double cycles = bench_run(pattern_trial, &ctx, NULL, &stats);
+        double ns = cycles / ctx.accesses * 1e9 / cpu_frequency;
+        printf("%-8s\t%-12zu\t%-16.3f\t%.2f", pattern_names[p], ctx.accesses, ns,
+               ns > 0 ? sizeof(uint64_t) / ns : 0.0);
+        // Every access reads one 8-byte word
+        event_print_row(stats.counted ? stats.events : NULL,
+                        (double)ctx.accesses * sizeof(uint64_t), (double)ctx.accesses);
+        printf("\n");
+        pattern_release(&ctx);
+    }
+}
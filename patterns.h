@@ -0,0 +1,53 @@
+#ifndef PATTERNS_H
+#define PATTERNS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Traversal shapes over a buffer of 8-byte elements; each has its own kernel
+typedef enum {
+    PATTERN_SEQ,       // Front to back
+    PATTERN_STRIDE,    // Every stride-th element, stride passes per sweep
+    PATTERN_WINDOW,    // Dependent random walk inside each window, windows in order
+    PATTERN_GATHER,    // Independent loads through a random index array
+    PATTERN_ROW,       // Square matrix, row-major walk
+    PATTERN_COLUMN,    // Square matrix, column-major walk (the transpose's read side)
+    PATTERN_TILED,     // Square matrix, tile by tile
+    PATTERN_COUNT
+} pattern_t;
+
+typedef struct {
+    size_t size;       // Working set in bytes
+    size_t stride;     // Bytes between accesses for PATTERN_STRIDE
+    size_t window;     // Bytes per window for PATTERN_WINDOW
+    size_t tile;       // Tile side in elements for PATTERN_TILED
+} pattern_params_t;
+
+// A prepared pattern: index arrays and chains are built here, never in the timed kernel
+typedef struct {
+    pattern_t pattern;
+    uint64_t *buf;
+    size_t elements;   // Buffer length in elements
+    size_t side;       // Matrix side for the 2-D patterns
+    size_t stride;     // In elements
+    size_t tile;
+    uint32_t *index;   // PATTERN_GATHER
+    void **head;       // PATTERN_WINDOW
+    size_t accesses;   // Loads per pass
+} pattern_ctx_t;
+
+extern volatile uint64_t pattern_sink;
+
+const char *pattern_name(pattern_t pattern);
+// Parse a pattern name ("seq", "stride", ...); -1 if unknown
+int pattern_from_name(const char *name);
+// Lay out the pattern over buf (size bytes, contents overwritten); -1 on failure
+int pattern_prepare(pattern_ctx_t *ctx, pattern_t pattern, void *buf, const pattern_params_t *params);
+void pattern_release(pattern_ctx_t *ctx);
+// 'passes' full traversals
+void pattern_run(pattern_ctx_t *ctx, size_t passes);
+
+// Every pattern over one working set: ns per access and GB/s of useful data
+void measure_patterns(const pattern_params_t *params);
+
+#endif // PATTERNS_H
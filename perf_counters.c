@@ -0,0 +1,351 @@
+#define _GNU_SOURCE
+#include "perf_counters.h"
+#include "profiling.h"
+#include <errno.h>
+#include <linux/perf_event.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define CACHE_EVENT(cache, op, result) \
+    ((cache) | ((op) << 8) | ((result) << 16))
+
+typedef struct {
+    const char *name;
+    uint32_t type;
+    uint64_t config;
+} counter_def_t;
+
+static const counter_def_t counter_defs[COUNTER_COUNT] = {
+    [COUNTER_CYCLES]       = {"Cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    [COUNTER_INSTRUCTIONS] = {"Instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    [COUNTER_L1D_MISSES]   = {"L1D Misses", PERF_TYPE_HW_CACHE,
+                              CACHE_EVENT(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_OP_READ,
+                                          PERF_COUNT_HW_CACHE_RESULT_MISS)},
+    [COUNTER_LLC_MISSES]   = {"LLC Misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    [COUNTER_DTLB_MISSES]  = {"DTLB Misses", PERF_TYPE_HW_CACHE,
+                              CACHE_EVENT(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_OP_READ,
+                                          PERF_COUNT_HW_CACHE_RESULT_MISS)},
+    [COUNTER_PAGE_FAULTS]  = {"Page Faults", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS},
+};
+
+const char *counter_name(counter_id_t id) {
+    return id < COUNTER_COUNT ? counter_defs[id].name : "unknown";
+}
+
+static int perf_event_open(struct perf_event_attr *attr, pid_t pid, int cpu,
+                           int group_fd, unsigned long flags) {
+    return (int)syscall(SYS_perf_event_open, attr, pid, cpu, group_fd, flags);
+}
+
+int perf_counter_open(uint32_t type, uint64_t config, pid_t pid, int enable_on_exec) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.inherit = 1;             // Follow threads and children of the target
+    attr.exclude_kernel = 1;      // Allowed at perf_event_paranoid <= 2
+    attr.exclude_hv = 1;
+    attr.disabled = enable_on_exec;
+    attr.enable_on_exec = enable_on_exec;
+    // Separate events rather than a group: the kernel multiplexes them and
+    // the time fields let us scale, so one missing event never blocks the rest
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return perf_event_open(&attr, pid, -1, -1, 0);
+}
+
+int perf_counter_read(int fd, uint64_t data[3]) {
+    return fd >= 0 && read(fd, data, 3 * sizeof(uint64_t)) == 3 * sizeof(uint64_t) ? 0 : -1;
+}
+
+int perf_counters_open(perf_counters_t *pc, pid_t pid, int enable_on_exec) {
+    int opened = 0;
+
+    for (int i = 0; i < COUNTER_COUNT; i++) {
+        pc->fds[i] = perf_counter_open(counter_defs[i].type, counter_defs[i].config, pid, enable_on_exec);
+        if (pc->fds[i] >= 0) {
+            opened++;
+        }
+    }
+    return opened;
+}
+
+void perf_counters_read(const perf_counters_t *pc, uint64_t *values, int *valid) {
+    for (int i = 0; i < COUNTER_COUNT; i++) {
+        uint64_t data[3];  // value, time enabled, time running
+        values[i] = 0;
+        valid[i] = 0;
+        if (perf_counter_read(pc->fds[i], data) != 0) {
+            continue;
+        }
+        if (data[2] == 0) {
+            valid[i] = data[1] == 0;  // Never scheduled: zero only if never enabled
+            continue;
+        }
+        values[i] = data[2] < data[1] ? (uint64_t)((double)data[0] * data[1] / data[2]) : data[0];
+        valid[i] = 1;
+    }
+}
+
+void perf_counters_close(perf_counters_t *pc) {
+    for (int i = 0; i < COUNTER_COUNT; i++) {
+        if (pc->fds[i] >= 0) {
+            close(pc->fds[i]);
+            pc->fds[i] = -1;
+        }
+    }
+}
+
+static double elapsed_seconds(const struct timespec *from, const struct timespec *to) {
+    return (to->tv_sec - from->tv_sec) + (to->tv_nsec - from->tv_nsec) / 1e9;
+}
+
+// Timer-driven sampling: sleep to each absolute deadline, read the counters,
+// stop once the child has exited. Sampler cost is the time inside the reads.
+static void sample_until_exit(pid_t pid, const perf_counters_t *pc, double interval_ms,
+                              const struct timespec *start, child_profile_t *profile) {
+    size_t capacity = 1024;
+    long interval_ns = (long)(interval_ms * 1e6);
+    struct timespec deadline = *start;
+    int valid[COUNTER_COUNT];
+
+    profile->samples = malloc(capacity * sizeof(counter_sample_t));
+    if (profile->samples == NULL) {
+        perror("Failed to allocate sample buffer");
+        waitpid(pid, &profile->exit_status, 0);
+        return;
+    }
+
+    for (;;) {
+        deadline.tv_nsec += interval_ns;
+        while (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_nsec -= 1000000000L;
+            deadline.tv_sec++;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL);
+
+        int exited = waitpid(pid, &profile->exit_status, WNOHANG) == pid;
+        if (profile->num_samples == capacity) {
+            counter_sample_t *grown = realloc(profile->samples, 2 * capacity * sizeof(counter_sample_t));
+            if (grown == NULL) {
+                perror("Failed to grow sample buffer");
+                if (!exited) {
+                    waitpid(pid, &profile->exit_status, 0);
+                }
+                return;
+            }
+            profile->samples = grown;
+            capacity *= 2;
+        }
+
+        struct timespec before, after;
+        counter_sample_t *sample = &profile->samples[profile->num_samples++];
+        clock_gettime(CLOCK_MONOTONIC, &before);
+        perf_counters_read(pc, sample->values, valid);
+        clock_gettime(CLOCK_MONOTONIC, &after);
+        sample->seconds = elapsed_seconds(start, &before);
+        profile->sampler_seconds += elapsed_seconds(&before, &after);
+
+        if (exited) {
+            return;
+        }
+    }
+}
+
+static double rusage_seconds(const struct rusage *usage) {
+    return usage->ru_utime.tv_sec + usage->ru_stime.tv_sec +
+           (usage->ru_utime.tv_usec + usage->ru_stime.tv_usec) / 1e6;
+}
+
+int run_with_counters(char *const argv[], double interval_ms, int target_core, child_profile_t *profile) {
+    int go[2];
+    perf_counters_t pc;
+    struct timespec start, end;
+    struct rusage before, after;
+
+    memset(profile, 0, sizeof(*profile));
+    if (pipe(go) != 0) {
+        perror("pipe");
+        return -1;
+    }
+
+    fflush(stdout);  // Otherwise buffered report lines interleave with the target's output
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        close(go[0]);
+        close(go[1]);
+        return -1;
+    }
+    if (pid == 0) {
+        // Child: wait until the counters are attached, then become the target
+        char token;
+        close(go[1]);
+        if (read(go[0], &token, 1) != 1) {
+            _exit(127);
+        }
+        close(go[0]);
+        // The fork inherited the profiler's pin; never squeeze the target onto it by accident
+        if (target_core >= 0 ? try_set_cpu_affinity(target_core) != 0 : restore_startup_affinity() != 0) {
+            perror("sched_setaffinity");
+        }
+        execvp(argv[0], argv);
+        fprintf(stderr, "exec %s: %s\n", argv[0], strerror(errno));
+        _exit(127);
+    }
+
+    close(go[0]);
+    if (perf_counters_open(&pc, pid, 1) == 0) {
+        fprintf(stderr, "perf_event_open unavailable (%s); reporting wall time only\n",
+                strerror(errno));
+    }
+
+    getrusage(RUSAGE_CHILDREN, &before);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (write(go[1], "x", 1) != 1) {
+        perror("write");
+    }
+    close(go[1]);
+
+    if (interval_ms > 0) {
+        // Keep the sampler off a pinned target's core, and otherwise off the core-0 pin
+        // the profiler usually holds, which an unpinned target is free to run on
+        cpu_set_t pinned;
+        int repin = sched_getaffinity(0, sizeof(pinned), &pinned) == 0;
+        if (restore_startup_affinity_except(target_core) != 0) {
+            perror("sched_setaffinity");
+        }
+        sample_until_exit(pid, &pc, interval_ms, &start, profile);
+        if (repin && sched_setaffinity(0, sizeof(pinned), &pinned) != 0) {
+            perror("sched_setaffinity");
+        }
+    } else if (waitpid(pid, &profile->exit_status, 0) < 0) {
+        perror("waitpid");
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    profile->wall_seconds = elapsed_seconds(&start, &end);
+    // Only reaped children count, so the delta is this target alone
+    getrusage(RUSAGE_CHILDREN, &after);
+    profile->cpu_seconds = rusage_seconds(&after) - rusage_seconds(&before);
+
+    perf_counters_read(&pc, profile->values, profile->valid);
+    perf_counters_close(&pc);
+    return 0;
+}
+
+void free_child_profile(child_profile_t *profile) {
+    free(profile->samples);
+    profile->samples = NULL;
+    profile->num_samples = 0;
+}
+
+void print_child_profile(const child_profile_t *profile) {
+    const uint64_t *v = profile->values;
+    const int *ok = profile->valid;
+
+    printf("Wall Time: %.6f seconds\n", profile->wall_seconds);
+    printf("CPU Time: %.6f seconds\n", profile->cpu_seconds);
+    if (WIFEXITED(profile->exit_status)) {
+        printf("Exit Status: %d\n", WEXITSTATUS(profile->exit_status));
+    } else if (WIFSIGNALED(profile->exit_status)) {
+        printf("Terminated by signal %d\n", WTERMSIG(profile->exit_status));
+    }
+
+    for (int i = 0; i < COUNTER_COUNT; i++) {
+        if (ok[i]) {
+            printf("%-14s %llu\n", counter_defs[i].name, (unsigned long long)v[i]);
+        } else {
+            printf("%-14s n/a\n", counter_defs[i].name);
+        }
+    }
+
+    // Derived metrics need instructions; DRAM traffic is one line per LLC miss
+    if (ok[COUNTER_CYCLES] && ok[COUNTER_INSTRUCTIONS] && v[COUNTER_CYCLES] > 0) {
+        printf("IPC: %.3f\n", (double)v[COUNTER_INSTRUCTIONS] / v[COUNTER_CYCLES]);
+    }
+    if (ok[COUNTER_INSTRUCTIONS] && v[COUNTER_INSTRUCTIONS] > 0) {
+        double kilo_instructions = v[COUNTER_INSTRUCTIONS] / 1000.0;
+        if (ok[COUNTER_L1D_MISSES]) {
+            printf("L1D MPKI: %.3f\n", v[COUNTER_L1D_MISSES] / kilo_instructions);
+        }
+        if (ok[COUNTER_LLC_MISSES]) {
+            printf("LLC MPKI: %.3f\n", v[COUNTER_LLC_MISSES] / kilo_instructions);
+        }
+        if (ok[COUNTER_DTLB_MISSES]) {
+            printf("DTLB MPKI: %.3f\n", v[COUNTER_DTLB_MISSES] / kilo_instructions);
+        }
+    }
+    if (ok[COUNTER_LLC_MISSES]) {
+        double dram_bytes = (double)v[COUNTER_LLC_MISSES] * 64;
+        printf("Estimated Bytes from DRAM: %.0f (%.2f GB/s over wall time)\n",
+               dram_bytes, profile->wall_seconds > 0 ? dram_bytes / profile->wall_seconds / 1e9 : 0.0);
+    }
+}
+
+void print_child_timeline(const child_profile_t *profile) {
+    const int *ok = profile->valid;
+    if (profile->num_samples == 0) {
+        return;
+    }
+
+    printf("\n=== Counter Timeline (%zu samples) ===\n", profile->num_samples);
+    printf("Time (ms)\tIPC\tL1D MPKI\tLLC MPKI\tDRAM (GB/s)\tPage Faults\n");
+    printf("------------------------------------------------------------------------------\n");
+
+    counter_sample_t previous = {0};
+    for (size_t i = 0; i < profile->num_samples; i++) {
+        const counter_sample_t *sample = &profile->samples[i];
+        double dt = sample->seconds - previous.seconds;
+        uint64_t delta[COUNTER_COUNT];
+        for (int c = 0; c < COUNTER_COUNT; c++) {
+            // Multiplexing scaling can make a total dip slightly; clamp at zero
+            delta[c] = sample->values[c] > previous.values[c] ? sample->values[c] - previous.values[c] : 0;
+        }
+        double kilo_instructions = delta[COUNTER_INSTRUCTIONS] / 1000.0;
+
+        printf("%-9.2f", sample->seconds * 1e3);
+        if (ok[COUNTER_CYCLES] && ok[COUNTER_INSTRUCTIONS] && delta[COUNTER_CYCLES] > 0) {
+            printf("\t%.3f", (double)delta[COUNTER_INSTRUCTIONS] / delta[COUNTER_CYCLES]);
+        } else {
+            printf("\tn/a");
+        }
+        if (ok[COUNTER_L1D_MISSES] && kilo_instructions > 0) {
+            printf("\t%.3f\t", delta[COUNTER_L1D_MISSES] / kilo_instructions);
+        } else {
+            printf("\tn/a\t");
+        }
+        if (ok[COUNTER_LLC_MISSES] && kilo_instructions > 0) {
+            printf("\t%.3f\t", delta[COUNTER_LLC_MISSES] / kilo_instructions);
+        } else {
+            printf("\tn/a\t");
+        }
+        if (ok[COUNTER_LLC_MISSES] && dt > 0) {
+            printf("\t%.3f\t", delta[COUNTER_LLC_MISSES] * 64.0 / dt / 1e9);
+        } else {
+            printf("\tn/a\t");
+        }
+        if (ok[COUNTER_PAGE_FAULTS]) {
+            printf("\t%llu\n", (unsigned long long)delta[COUNTER_PAGE_FAULTS]);
+        } else {
+            printf("\tn/a\n");
+        }
+        previous = *sample;
+    }
+
+    // The sampler runs in the profiler process, on the startup mask (minus a pinned
+    // target's core). Whenever it lands on a CPU the target wants, as it always does
+    // on a one-CPU machine, each read is time taken from the target
+    double per_read_us = profile->sampler_seconds / profile->num_samples * 1e6;
+    printf("Sampler overhead: %.2f us per sample, %.3f ms total (%.3f%% of wall time)\n",
+           per_read_us, profile->sampler_seconds * 1e3,
+           profile->wall_seconds > 0 ? 100.0 * profile->sampler_seconds / profile->wall_seconds : 0.0);
+    printf("Note: counts of the target's threads and children join the totals only when they exit.\n");
+}
@@ -0,0 +1,62 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+// Hardware events counted for a profiled program
+typedef enum {
+    COUNTER_CYCLES,
+    COUNTER_INSTRUCTIONS,
+    COUNTER_L1D_MISSES,
+    COUNTER_LLC_MISSES,
+    COUNTER_DTLB_MISSES,
+    COUNTER_PAGE_FAULTS,      // Software event: works even without a PMU (e.g. in VMs)
+    COUNTER_COUNT
+} counter_id_t;
+
+typedef struct {
+    int fds[COUNTER_COUNT];  // -1 where the event could not be opened
+} perf_counters_t;
+
+// Counter totals read at one point of the run
+typedef struct {
+    double seconds;           // Since exec
+    uint64_t values[COUNTER_COUNT];
+} counter_sample_t;
+
+// Result of running a program under the counters
+typedef struct {
+    uint64_t values[COUNTER_COUNT];
+    int valid[COUNTER_COUNT];
+    double wall_seconds;
+    double cpu_seconds;       // User plus system time of the target and the children it waited for
+    int exit_status;          // As returned by waitpid
+    counter_sample_t *samples; // Timeline, when sampling was requested
+    size_t num_samples;
+    double sampler_seconds;   // Time spent inside the sampler's counter reads
+} child_profile_t;
+
+const char *counter_name(counter_id_t id);
+
+// One event on 'pid' (0 = this process) with enabled/running times; fd or -1
+int perf_counter_open(uint32_t type, uint64_t config, pid_t pid, int enable_on_exec);
+// Raw value, time enabled, time running; -1 on failure
+int perf_counter_read(int fd, uint64_t data[3]);
+// Open every event on 'pid' (inherited by its children); with enable_on_exec
+// counting starts when the target calls exec. Returns how many events opened.
+int perf_counters_open(perf_counters_t *pc, pid_t pid, int enable_on_exec);
+// Multiplexing-scaled totals; valid[i] is 0 where the event is unavailable
+void perf_counters_read(const perf_counters_t *pc, uint64_t *values, int *valid);
+void perf_counters_close(perf_counters_t *pc);
+
+// fork/exec argv (no shell) with the counters attached; a non-zero interval
+// also reads them every interval_ms into profile->samples. The target runs pinned
+// to target_core, or with the profiler's startup mask when it is -1 (the profiler
+// itself is usually pinned by then). -1 if it cannot start
+int run_with_counters(char *const argv[], double interval_ms, int target_core, child_profile_t *profile);
+void print_child_profile(const child_profile_t *profile);
+void print_child_timeline(const child_profile_t *profile);
+void free_child_profile(child_profile_t *profile);
+
+#endif // PERF_COUNTERS_H
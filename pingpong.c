@@ -0,0 +1,232 @@
+#define _GNU_SOURCE
+#include "pingpong.h"
+#include "harness.h"
+#include "profiling.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <x86intrin.h>
+
+#define PINGPONG_STOP UINT64_MAX
+
+// The bounced line; nothing else lives on it
+typedef struct {
+    _Alignas(64) _Atomic uint64_t value;
+    char pad[64 - sizeof(uint64_t)];
+} pingpong_line_t;
+
+typedef struct {
+    pingpong_line_t *line;
+    int core;
+    atomic_int ready;            // Responder's affinity result: 1 pinned, -1 failed, 0 not yet
+    uint64_t sequence;           // Initiator's next odd value
+} pingpong_pair_t;
+
+// Fewer, shorter trials than the default: the matrix has n(n-1)/2 cells
+static const bench_config_t pingpong_config = {
+    .min_trials = 5,
+    .max_trials = 50,
+    .target_ci = 0.02,
+    .time_budget = 0.05,
+    .min_trial_cycles = 100000,
+};
+
+// Responder: turn every odd value into the next even one until told to stop.
+// STOP is written only after the last trial, so the initiator never waits on it
+static void *pingpong_responder(void *arg) {
+    pingpong_pair_t *pair = arg;
+    _Atomic uint64_t *value = &pair->line->value;
+
+    if (try_set_cpu_affinity(pair->core) != 0) {
+        perror("sched_setaffinity");
+        atomic_store(&pair->ready, -1);
+        return NULL;
+    }
+    atomic_store(&pair->ready, 1);
+    for (;;) {
+        uint64_t seen = atomic_load_explicit(value, memory_order_acquire);
+        if (seen == PINGPONG_STOP) {
+            break;
+        }
+        if (seen & 1) {
+            atomic_store_explicit(value, seen + 1, memory_order_release);
+        } else {
+            _mm_pause();
+        }
+    }
+    return NULL;
+}
+
+// Harness trial: 'reps' round trips, each a write by us and one by the responder
+static void pingpong_trial(void *ctx, size_t reps) {
+    pingpong_pair_t *pair = ctx;
+    _Atomic uint64_t *value = &pair->line->value;
+
+    for (size_t r = 0; r < reps; r++) {
+        uint64_t sent = pair->sequence;
+        atomic_store_explicit(value, sent, memory_order_release);
+        while (atomic_load_explicit(value, memory_order_acquire) == sent) {
+            _mm_pause();
+        }
+        pair->sequence += 2;
+    }
+}
+
+// Median round trip in cycles between the calling thread's core and 'core'; -1 on failure
+static double pingpong_cycles(int core) {
+    pingpong_line_t *line = aligned_alloc(64, sizeof(pingpong_line_t));
+    pthread_t tid;
+
+    if (line == NULL) {
+        perror("Failed to allocate ping-pong line");
+        return -1.0;
+    }
+    atomic_init(&line->value, 0);
+    pingpong_pair_t pair = {.line = line, .core = core, .sequence = 1};
+    atomic_init(&pair.ready, 0);
+    if (pthread_create(&tid, NULL, pingpong_responder, &pair) != 0) {
+        perror("pthread_create");
+        free(line);
+        return -1.0;
+    }
+
+    // No trial starts until the responder is pinned: a failed responder never answers
+    int ready;
+    while ((ready = atomic_load(&pair.ready)) == 0) {
+        sched_yield();
+    }
+    double cycles = ready > 0 ? bench_run(pingpong_trial, &pair, &pingpong_config, NULL) : -1.0;
+
+    atomic_store(&line->value, PINGPONG_STOP);
+    pthread_join(tid, NULL);
+    free(line);
+    return cycles;
+}
+
+static int find_root(int *parent, int i) {
+    while (parent[i] != i) {
+        parent[i] = parent[parent[i]];
+        i = parent[i];
+    }
+    return i;
+}
+
+// Group cores whose round trip is within 'threshold' (single linkage) and print the groups
+static void print_domains(const int *cores, size_t n, const double *ns, double threshold) {
+    int *parent = malloc(n * sizeof(int));
+    if (parent == NULL) {
+        return;
+    }
+    for (size_t i = 0; i < n; i++) {
+        parent[i] = (int)i;
+    }
+    for (size_t i = 0; i < n; i++) {
+        for (size_t j = i + 1; j < n; j++) {
+            if (ns[i * n + j] > 0 && ns[i * n + j] <= threshold) {
+                parent[find_root(parent, (int)i)] = find_root(parent, (int)j);
+            }
+        }
+    }
+    for (size_t i = 0; i < n; i++) {
+        if (find_root(parent, (int)i) != (int)i) {
+            continue;
+        }
+        printf(" {");
+        const char *sep = "";
+        for (size_t j = 0; j < n; j++) {
+            if (find_root(parent, (int)j) == (int)i) {
+                printf("%s%d", sep, cores[j]);
+                sep = ",";
+            }
+        }
+        printf("}");
+    }
+    printf("\n");
+    free(parent);
+}
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+void measure_core_to_core(const int *cores, size_t num_cores) {
+    double cpu_frequency = get_cpu_frequency();
+    if (num_cores < 2) {
+        fprintf(stderr, "Core-to-core latency needs at least two cores\n");
+        return;
+    }
+
+    double *ns = calloc(num_cores * num_cores, sizeof(double));
+    double *sorted = calloc(num_cores * num_cores, sizeof(double));
+    if (ns == NULL || sorted == NULL) {
+        perror("Failed to allocate latency matrix");
+        free(ns);
+        free(sorted);
+        return;
+    }
+
+    printf("Core-to-core cache-line round trip (ns), %zu cores\n", num_cores);
+    for (size_t i = 0; i < num_cores; i++) {
+        // The initiator runs on this thread, pinned to row core i
+        if (try_set_cpu_affinity(cores[i]) != 0) {
+            perror("sched_setaffinity");
+            // Pairs with earlier rows were measured from their side; the rest never will be
+            for (size_t j = i + 1; j < num_cores; j++) {
+                ns[i * num_cores + j] = ns[j * num_cores + i] = -1.0;
+            }
+            continue;
+        }
+        for (size_t j = i + 1; j < num_cores; j++) {
+            double cycles = pingpong_cycles(cores[j]);
+            double value = cycles > 0 ? cycles * 1e9 / cpu_frequency : -1.0;
+            ns[i * num_cores + j] = ns[j * num_cores + i] = value;
+        }
+    }
+
+    printf("From\\To");
+    for (size_t j = 0; j < num_cores; j++) {
+        printf("\t%d", cores[j]);
+    }
+    printf("\n");
+    for (size_t i = 0; i < num_cores; i++) {
+        printf("%d", cores[i]);
+        for (size_t j = 0; j < num_cores; j++) {
+            double value = ns[i * num_cores + j];
+            if (i == j) {
+                printf("\t-");
+            } else if (value < 0) {
+                printf("\tn/a");
+            } else {
+                printf("\t%.1f", value);
+            }
+        }
+        printf("\n");
+    }
+
+    // A tier ends wherever the sorted pair latencies jump by PINGPONG_BREAK
+    size_t count = 0;
+    for (size_t i = 0; i < num_cores; i++) {
+        for (size_t j = i + 1; j < num_cores; j++) {
+            if (ns[i * num_cores + j] > 0) {
+                sorted[count++] = ns[i * num_cores + j];
+            }
+        }
+    }
+    qsort(sorted, count, sizeof(double), compare_double);
+
+    printf("\nInferred sharing domains (cores whose round trip stays within the tier)\n");
+    int tier = 1;
+    for (size_t k = 0; k < count; k++) {
+        if (k + 1 == count || sorted[k + 1] > sorted[k] * PINGPONG_BREAK) {
+            printf("Tier %d (<= %.1f ns):", tier++, sorted[k]);
+            print_domains(cores, num_cores, ns, sorted[k]);
+        }
+    }
+
+    free(ns);
+    free(sorted);
+}
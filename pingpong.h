@@ -0,0 +1,12 @@
+#ifndef PINGPONG_H
+#define PINGPONG_H
+
+#include <stddef.h>
+
+#define PINGPONG_BREAK 1.30      // Latency jump that separates two sharing tiers
+
+// Round trip of one cache line between every pair of cores, plus the
+// sharing domains (SMT, L2, L3/CCX, socket) that the latency tiers imply
+void measure_core_to_core(const int *cores, size_t num_cores);
+
+#endif // PINGPONG_H
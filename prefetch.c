@@ -0,0 +1,194 @@
+#define _GNU_SOURCE
+#include "prefetch.h"
+#include "arena.h"
+#include "chase.h"
+#include "harness.h"
+#include "patterns.h"
+#include "profiling.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <xmmintrin.h>
+
+#define NUM_HINTS 4
+
+static const size_t distances[] = {1, 2, 4, 8, 16, 32, 64, 128, 256};  // In accesses
+static const size_t strides[] = {256, 4096};                           // Bytes, for the strided walk
+static const char *hint_names[NUM_HINTS] = {"T0", "T1", "T2", "NTA"};
+
+#define NUM_DISTANCES (sizeof(distances) / sizeof(distances[0]))
+#define NUM_STRIDES (sizeof(strides) / sizeof(strides[0]))
+
+// Shorter than the default harness budget: the sweep has hundreds of cells
+static const bench_config_t prefetch_config = {
+    .min_trials = 3,
+    .max_trials = 20,
+    .target_ci = 0.02,
+    .time_budget = 0.1,
+    .min_trial_cycles = 200000,
+};
+
+// The hint is an immediate, so each one gets its own copy of both kernels. The
+// access loop is split so the prefetch never reaches past the end of the walk
+#define DEFINE_PREFETCH_KERNELS(NAME, HINT)                                          \
+static uint64_t gather_##NAME(const pattern_ctx_t *ctx, size_t dist) {              \
+    const uint64_t *buf = ctx->buf;                                                  \
+    const uint32_t *index = ctx->index;                                              \
+    size_t n = ctx->accesses, split = n > dist ? n - dist : 0;                       \
+    uint64_t sum = 0;                                                                \
+    size_t i = 0;                                                                    \
+    for (; i < split; i++) {                                                         \
+        _mm_prefetch((const char *)&buf[index[i + dist]], HINT);                     \
+        sum += buf[index[i]];                                                        \
+    }                                                                                \
+    for (; i < n; i++) {                                                             \
+        sum += buf[index[i]];                                                        \
+    }                                                                                \
+    return sum;                                                                      \
+}                                                                                    \
+static uint64_t stride_##NAME(const pattern_ctx_t *ctx, size_t dist) {              \
+    const uint64_t *buf = ctx->buf;                                                  \
+    size_t n = ctx->elements, step = ctx->stride, ahead = dist * step;               \
+    uint64_t sum = 0;                                                                \
+    for (size_t start = 0; start < step; start++) {                                  \
+        size_t i = start;                                                            \
+        for (; i + ahead < n; i += step) {                                           \
+            _mm_prefetch((const char *)&buf[i + ahead], HINT);                       \
+            sum += buf[i];                                                           \
+        }                                                                            \
+        for (; i < n; i += step) {                                                   \
+            sum += buf[i];                                                           \
+        }                                                                            \
+    }                                                                                \
+    return sum;                                                                      \
+}
+
+// Baselines with the same loop shape, so the comparison isolates the prefetch
+static uint64_t gather_none(const pattern_ctx_t *ctx, size_t dist) {
+    (void)dist;
+    uint64_t sum = 0;
+    for (size_t i = 0; i < ctx->accesses; i++) {
+        sum += ctx->buf[ctx->index[i]];
+    }
+    return sum;
+}
+
+static uint64_t stride_none(const pattern_ctx_t *ctx, size_t dist) {
+    (void)dist;
+    uint64_t sum = 0;
+    for (size_t start = 0; start < ctx->stride; start++) {
+        for (size_t i = start; i < ctx->elements; i += ctx->stride) {
+            sum += ctx->buf[i];
+        }
+    }
+    return sum;
+}
+
+DEFINE_PREFETCH_KERNELS(t0, _MM_HINT_T0)
+DEFINE_PREFETCH_KERNELS(t1, _MM_HINT_T1)
+DEFINE_PREFETCH_KERNELS(t2, _MM_HINT_T2)
+DEFINE_PREFETCH_KERNELS(nta, _MM_HINT_NTA)
+
+typedef uint64_t (*prefetch_kernel_t)(const pattern_ctx_t *, size_t);
+
+static const prefetch_kernel_t gather_kernels[NUM_HINTS] = {gather_t0, gather_t1, gather_t2, gather_nta};
+static const prefetch_kernel_t stride_kernels[NUM_HINTS] = {stride_t0, stride_t1, stride_t2, stride_nta};
+
+typedef struct {
+    pattern_ctx_t *pattern;
+    prefetch_kernel_t kernel;
+    size_t distance;
+} prefetch_trial_t;
+
+static void prefetch_trial(void *ctx, size_t reps) {
+    prefetch_trial_t *trial = ctx;
+    uint64_t sum = 0;
+    for (size_t r = 0; r < reps; r++) {
+        sum += trial->kernel(trial->pattern, trial->distance);
+    }
+    pattern_sink = sum;
+}
+
+static double trial_ns(prefetch_trial_t *trial, double cpu_frequency) {
+    prefetch_trial(trial, 1);  // Warm-up
+    double cycles = bench_run(prefetch_trial, trial, &prefetch_config, NULL);
+    return cycles / trial->pattern->accesses * 1e9 / cpu_frequency;
+}
+
+// Baseline and every hint x distance for one prepared pattern
+static void tune_pattern(const char *label, pattern_ctx_t *pattern,
+                         prefetch_kernel_t baseline_kernel, const prefetch_kernel_t *kernels,
+                         double cpu_frequency) {
+    prefetch_trial_t trial = {pattern, baseline_kernel, 0};
+    double baseline = trial_ns(&trial, cpu_frequency);
+    double best = 1.0;
+    size_t best_distance = 0;
+    int best_hint = -1;
+
+    printf("\n%s: %.3f ns/access without prefetch\n", label, baseline);
+    printf("Distance");
+    for (int h = 0; h < NUM_HINTS; h++) {
+        printf("\t%s", hint_names[h]);
+    }
+    printf("\t(speedup over no prefetch)\n");
+
+    for (size_t d = 0; d < NUM_DISTANCES; d++) {
+        printf("%zu", distances[d]);
+        for (int h = 0; h < NUM_HINTS; h++) {
+            trial.kernel = kernels[h];
+            trial.distance = distances[d];
+            double ns = trial_ns(&trial, cpu_frequency);
+            double speedup = ns > 0 ? baseline / ns : 0.0;
+            if (speedup > best) {
+                best = speedup;
+                best_distance = distances[d];
+                best_hint = h;
+            }
+            printf("\t%.2fx", speedup);
+        }
+        printf("\n");
+    }
+
+    if (best_hint < 0 || best < PREFETCH_COVERED) {
+        printf("Best: no prefetch (best gain %.2fx) - hardware prefetch or caches already cover it\n", best);
+    } else {
+        printf("Best: %s at distance %zu (%.2fx)\n", hint_names[best_hint], best_distance, best);
+    }
+}
+
+void measure_prefetch_tuning(size_t max_size) {
+    double cpu_frequency = get_cpu_frequency();
+    if (max_size == 0) {
+        max_size = chase_dram_size();
+    }
+    size_t sizes[] = {max_size / 256, max_size / 16, max_size};
+    const size_t num_sizes = sizeof(sizes) / sizeof(sizes[0]);
+
+    void *buf = arena_view(max_size, 0);
+    if (buf == NULL) {
+        return;
+    }
+
+    printf("Software-prefetch distance sweep, working sets up to %zu bytes\n", max_size);
+    for (size_t s = 0; s < num_sizes; s++) {
+        pattern_params_t params = {.size = sizes[s]};
+        pattern_ctx_t pattern;
+        char label[96];
+
+        printf("\n=== Working set %zu bytes ===\n", sizes[s]);
+        if (pattern_prepare(&pattern, PATTERN_GATHER, buf, &params) == 0) {
+            snprintf(label, sizeof(label), "Gather (random index)");
+            tune_pattern(label, &pattern, gather_none, gather_kernels, cpu_frequency);
+            pattern_release(&pattern);
+        }
+        for (size_t t = 0; t < NUM_STRIDES; t++) {
+            params.stride = strides[t];
+            if (pattern_prepare(&pattern, PATTERN_STRIDE, buf, &params) != 0) {
+                continue;
+            }
+            snprintf(label, sizeof(label), "Stride %zu B", strides[t]);
+            tune_pattern(label, &pattern, stride_none, stride_kernels, cpu_frequency);
+            pattern_release(&pattern);
+        }
+    }
+}
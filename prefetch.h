@@ -0,0 +1,12 @@
+#ifndef PREFETCH_H
+#define PREFETCH_H
+
+#include <stddef.h>
+
+#define PREFETCH_COVERED 1.10    // Best software speedup below this: hardware already covers it
+
+// Gather and strided walks with _mm_prefetch (T0/T1/T2/NTA) over a sweep of
+// distances; speedup curve and best distance per working-set size up to max_size
+void measure_prefetch_tuning(size_t max_size);
+
+#endif // PREFETCH_H
@@ -1,52 +1,78 @@
 #define _GNU_SOURCE
 #include "profiling.h"
 #include "user_code.h"
+#include "chase.h"
+#include "kernels.h"
+#include "pages.h"
+#include "harness.h"
+#include "arena.h"
+#include "events.h"
+#include "evict.h"
 #include <x86intrin.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sched.h>
 #include <unistd.h>
-#include <papi.h>
 #include <time.h>
 
 volatile char *array;  // Global array, type matches declaration in profiling.h
 
+static cpu_set_t startup_mask;
+static int startup_saved = 0;
+
 uint64_t rdtsc_start() {
-    return __rdtsc();
+    return timer_start();
 }
 
+// Rate of the TSC that every rdtsc_start/rdtsc_end pair counts in. Calibrated
+// once; "cpu MHz" in /proc/cpuinfo is a per-core snapshot under turbo/powersave
 double get_cpu_frequency() {
-    FILE *fp;
-    char buffer[256];
-    double cpu_mhz = 0.0;
-
-    // Open the /proc/cpuinfo file
-    fp = fopen("/proc/cpuinfo", "r");
-    if (fp == NULL) {
-        perror("Failed to open /proc/cpuinfo");
-        return 0.0; // Return 0 on failure
-    }
-
-    // Read through the file to find the "cpu MHz" entry
-    while (fgets(buffer, sizeof(buffer), fp) != NULL) {
-        if (sscanf(buffer, "cpu MHz : %lf", &cpu_mhz) == 1) {
-            fclose(fp);
-            return cpu_mhz * 1e6; // Convert MHz to Hz
-        }
-    }
-
-    fclose(fp);
-    return 0.0; // Return 0 if not found
+    return tsc_frequency();
 }
 
 
-void set_cpu_affinity(int cpu_id) {
+// Pin the calling thread to one core; returns 0 on success
+int try_set_cpu_affinity(int cpu_id) {
     cpu_set_t cpu_set;
     CPU_ZERO(&cpu_set);         // Clear all CPUs from the set
     CPU_SET(cpu_id, &cpu_set);  // Add the desired CPU to the set
 
+    // pid 0 applies the mask to the calling thread only
+    return sched_setaffinity(0, sizeof(cpu_set_t), &cpu_set);
+}
+
+
+void save_startup_affinity(void) {
+    CPU_ZERO(&startup_mask);
+    startup_saved = sched_getaffinity(0, sizeof(cpu_set_t), &startup_mask) == 0;
+}
+
+
+// Back to the startup mask on the calling thread; -1 if it was never saved
+int restore_startup_affinity(void) {
+    if (!startup_saved) {
+        return -1;
+    }
+    return sched_setaffinity(0, sizeof(cpu_set_t), &startup_mask);
+}
+
+
+int restore_startup_affinity_except(int cpu_id) {
+    if (!startup_saved) {
+        return -1;
+    }
+    cpu_set_t cpu_set = startup_mask;
+    if (cpu_id >= 0 && cpu_id < CPU_SETSIZE && CPU_COUNT(&cpu_set) > 1) {
+        CPU_CLR(cpu_id, &cpu_set);
+    }
+    return sched_setaffinity(0, sizeof(cpu_set_t), &cpu_set);
+}
+
+
+void set_cpu_affinity(int cpu_id) {
     // Set CPU affinity for the current process
-    if (sched_setaffinity(0, sizeof(cpu_set_t), &cpu_set) != 0) {
+    if (try_set_cpu_affinity(cpu_id) != 0) {
         perror("sched_setaffinity");
         exit(1);
     } else {
@@ -76,83 +102,85 @@ void verify_cpu_affinity() {
 
 
 uint64_t rdtsc_end() {
-    return __rdtsc();
+    return timer_stop();
 }
 
+// Point the global array at the arena; it stays valid until the arena grows
 void initialize_memory(size_t size) {
-    array = (volatile char *)malloc(size);
+    array = (volatile char *)arena_view(size, 0);
     if (array == NULL) {
         printf("Memory allocation failed\n");
         exit(1);
     }
-    // Warm-up loop to initialize memory and avoid cold-cache effects
-    for (size_t i = 0; i < size; i++) {
-        array[i] = (char)(i & 0xFF);
-    }
+    // Warm-up fill with vector stores to avoid cold-cache effects
+    arena_fill((void *)array, size);
 }
 
 
-double measure_bandwidth(size_t block_size, double read_ratio, size_t total_size) {
+// One timed pass of the block read/write loop over buf; returns elapsed cycles
+uint64_t bandwidth_pass(bw_kernel_t kernel, char *buf, size_t block_size, double read_ratio,
+                        size_t total_size, size_t iterations) {
     uint64_t start, end;
-    uint64_t total_cycles = 0;
-    double cpu_frequency = get_cpu_frequency(); // Get the CPU frequency dynamically
-    // // Print the CPU frequency
-    // printf("CPU Frequency: %.2f GHz\n", cpu_frequency / 1e9);
-    size_t iterations = 100;  // Number of iterations for averaging
-    volatile char temp;
-    char *array = malloc(total_size); // Allocate memory for the array
 
-    // Check if allocation succeeded
-    if (array == NULL) {
-        perror("Failed to allocate memory");
-        return 0.0; // Return 0 on failure
-    }
+    start = rdtsc_start();
+    kernel_block_pass(kernel, buf, block_size, read_ratio, total_size, iterations);
+    end = rdtsc_end();
 
-    // Calculate read and write counts based on the specified ratio
-    size_t read_count = (size_t)(read_ratio * block_size);
-    size_t write_count = block_size - read_count;
+    return timer_cycles(start, end);
+}
 
-    // Warm-up to avoid cold-cache effects
-    for (size_t warmup = 0; warmup < 5; warmup++) {
-        for (size_t i = 0; i < total_size; i += block_size) {
-            for (size_t j = 0; j < read_count; j++) {
-                temp = array[i + j];  // Warm-up read operation
-                (void)temp;  // Suppress unused variable warning
-            }
-            for (size_t j = 0; j < write_count; j++) {
-                array[i + j] = (char)((i + j) & 0xFF);  // Warm-up write operation
-            }
-        }
-    }
+// Harness trial: 'reps' block-grid passes over one buffer
+typedef struct {
+    bw_kernel_t kernel;
+    char *buf;
+    size_t block_size;
+    double read_ratio;
+    size_t total_size;
+} block_trial_t;
+
+static void block_trial(void *ctx, size_t reps) {
+    block_trial_t *trial = ctx;
+    kernel_block_pass(trial->kernel, trial->buf, trial->block_size, trial->read_ratio,
+                      trial->total_size, reps);
+}
 
-    // Start measuring cycles
-    start = rdtsc_start();
-    for (size_t iter = 0; iter < iterations; iter++) {
-        for (size_t i = 0; i < total_size; i += block_size) {
-            // Perform reads
-            for (size_t j = 0; j < read_count; j++) {
-                temp = array[i + j];  // Read operation
-                (void)temp;  // Suppress unused variable warning
-            }
+static void block_evict(void *ctx) {
+    block_trial_t *trial = ctx;
+    evict_buffer(trial->buf, trial->total_size);
+}
 
-            // Perform writes
-            for (size_t j = 0; j < write_count; j++) {
-                array[i + j] = (char)((i + j) & 0xFF);  // Write operation
-            }
-        }
+double measure_bandwidth(size_t block_size, double read_ratio, size_t total_size) {
+    return measure_bandwidth_kernel(block_size, read_ratio, total_size, kernel_best());
+}
+
+double measure_bandwidth_kernel(size_t block_size, double read_ratio, size_t total_size,
+                                bw_kernel_t kernel) {
+    double cpu_frequency = get_cpu_frequency(); // Calibrated TSC rate
+    // Page aligned (so never splitting a line), pre-faulted, shared with every other test
+    char *buffer = arena_view(total_size, 0);
+    if (buffer == NULL) {
+        return 0.0; // Return 0 on failure
     }
-    end = rdtsc_end();
 
-    // Calculate the total time in cycles
-    total_cycles = end - start;
+    // Warm-up to avoid cold-cache effects
+    bandwidth_pass(kernel, buffer, block_size, read_ratio, total_size, 5);
+
+    // Repeat passes until the median is stable rather than a fixed count
+    block_trial_t trial = {kernel, buffer, block_size, read_ratio, total_size};
+    bench_config_t config = bench_default_config;
+    if (cold_mode != EVICT_OFF) {
+        // Cold mode: one pass per trial, each on an evicted buffer
+        config.before_trial = block_evict;
+        config.min_trial_cycles = 0;
+    }
+    double cycles_per_pass = bench_run(block_trial, &trial, &config, NULL);
 
-    // Total data accessed in bytes
-    double data_accessed = (double)((read_count + write_count) * iterations * (total_size / block_size));
+    // Data accessed by one pass in bytes
+    double data_accessed = (double)(block_size * (total_size / block_size));
 
-    // Calculate bandwidth in bytes per second using the dynamic CPU frequency
-    double bandwidth = data_accessed / (total_cycles / cpu_frequency);
+    // Calculate bandwidth in bytes per second from the median pass
+    double bandwidth = cycles_per_pass > 0 ? data_accessed / (cycles_per_pass / cpu_frequency) : 0.0;
 
-    free(array); // Free the allocated memory
     return bandwidth;  // Bandwidth in bytes per second
 }
 
@@ -163,29 +191,38 @@ void measure_maximum_bandwidth(size_t total_size) {
     double cpu_frequency = get_cpu_frequency();
     // Print the CPU frequency
     printf("CPU Frequency: %.2f GHz\n", cpu_frequency / 1e9); // Convert Hz to GHz
-    printf("Granularity\tRatio\t\tBandwidth (Gbps)\tRead Latency (Cycles)\tWrite Latency (Cycles)\n");
-    printf("------------------------------------------------------------------------------------------------------------------\n");
+    printf("Granularity\tRatio\t\tKernel\t\tBandwidth (Gbps)\tRead Latency (Cycles)\tWrite Latency (Cycles)\n");
+    printf("----------------------------------------------------------------------------------------------------------------------------------\n");
 
     const size_t num_granularities = sizeof(granularities) / sizeof(granularities[0]);
     const size_t num_ratios = sizeof(ratios) / sizeof(ratios[0]);
 
     for (size_t i = 0; i < num_granularities; i++) {
+        // Measure latencies
+        double read_latency = measure_read_latency(granularities[i]);
+        double write_latency = measure_write_latency(granularities[i]);
+
         for (size_t j = 0; j < num_ratios; j++) {
-            // Measure bandwidth
-            double bandwidth_bytes_per_second = measure_bandwidth(granularities[i], ratios[j], total_size);
-            if (bandwidth_bytes_per_second < 0) {
-                fprintf(stderr, "Error measuring bandwidth for %zuB and ratio %.2f\n", granularities[i], ratios[j]);
-                continue; // Skip to next iteration
+            // One row per instruction set this CPU supports
+            for (int k = 0; k < KERNEL_COUNT; k++) {
+                if (!kernel_supported((bw_kernel_t)k)) {
+                    continue;
+                }
+
+                // Measure bandwidth
+                double bandwidth_bytes_per_second =
+                    measure_bandwidth_kernel(granularities[i], ratios[j], total_size, (bw_kernel_t)k);
+                if (bandwidth_bytes_per_second <= 0) {
+                    fprintf(stderr, "Error measuring bandwidth for %zuB and ratio %.2f\n", granularities[i], ratios[j]);
+                    continue; // Skip to next iteration
+                }
+                double bandwidth_gbps = (bandwidth_bytes_per_second * 8) / 1e9;  // Convert to Gbps
+
+                // Print results in the specified format
+                printf(" %zuB\t\t%s\t%-8s\t%.2f\t\t\t%.2f\t\t\t%.2f\n",
+                       granularities[i], ratio_labels[j], kernel_name((bw_kernel_t)k),
+                       bandwidth_gbps, read_latency, write_latency);
             }
-            double bandwidth_gbps = (bandwidth_bytes_per_second * 8) / 1e9;  // Convert to Gbps
-
-            // Measure latencies
-            double read_latency = measure_read_latency(granularities[i]);
-            double write_latency = measure_write_latency(granularities[i]);
-
-            // Print results in the specified format
-            printf(" %zuB\t\t%s\t%.2f\t\t\t%.2f\t\t\t%.2f\n",
-                   granularities[i], ratio_labels[j], bandwidth_gbps, read_latency, write_latency);
         }
     }
 }
@@ -194,6 +231,9 @@ double measure_read_latency(size_t size) {
     uint64_t start, end, total_cycles = 0;
     volatile char temp;
 
+    // Cold mode: start from a buffer that is in no cache level
+    evict_buffer((const char *)array, size);
+
     // Memory barrier to avoid CPU reordering optimizations
     _mm_mfence();
 
@@ -201,7 +241,7 @@ double measure_read_latency(size_t size) {
         start = rdtsc_start();
         temp = array[i];  // Read value
         end = rdtsc_end();
-        total_cycles += (end - start);
+        total_cycles += timer_cycles(start, end);
     }
 
     _mm_mfence();  // Memory barrier after the loop
@@ -212,6 +252,8 @@ double measure_read_latency(size_t size) {
 double measure_write_latency(size_t size) {
     uint64_t start, end, total_cycles = 0;
 
+    evict_buffer((const char *)array, size);
+
     // Memory barrier to avoid CPU reordering optimizations
     _mm_mfence();
 
@@ -219,7 +261,7 @@ double measure_write_latency(size_t size) {
         start = rdtsc_start();
         array[i] = (char)(i & 0xFF);  // Write value
         end = rdtsc_end();
-        total_cycles += (end - start);
+        total_cycles += timer_cycles(start, end);
     }
 
     _mm_mfence();  // Memory barrier after the loop
@@ -228,68 +270,48 @@ double measure_write_latency(size_t size) {
 
 }
 
+// Bandwidth with 'queue_depth' misses kept in flight: that many independent
+// pointer chains (one block per request) are walked in lockstep, so depth is
+// the number of outstanding loads rather than a repeat count. A read ratio
+// below 1.0 also dirties every visited block, adding write-back traffic.
 double measure_bandwidth_with_queue(size_t block_size, double read_ratio, size_t total_size, size_t queue_depth) {
-    uint64_t start, end;
-    uint64_t total_cycles = 0;
     double cpu_frequency = get_cpu_frequency();  // Get actual CPU frequency
-    size_t iterations = 100;  // Number of iterations for averaging
-    volatile char temp;
+    int dirty = read_ratio < 1.0;
+    char *buffer = NULL;
 
-    // Calculate read and write counts based on the specified ratio
-    size_t read_count = (size_t)(read_ratio * block_size);
-    size_t write_count = block_size - read_count;
+    if (block_size < 64 || queue_depth == 0 || queue_depth > MLP_MAX_CHAINS) {
+        fprintf(stderr, "Queue depth must be 1..%d and block size at least 64B\n", MLP_MAX_CHAINS);
+        return 0.0;
+    }
 
     printf("Measuring bandwidth for block size: %zuB, read ratio: %.2f, queue depth: %zu\n", block_size, read_ratio, queue_depth);
-    printf("Read count: %zu, Write count: %zu\n", read_count, write_count);
-
-    // Simulate multiple outstanding requests by splitting work into 'queue_depth' parts
-    printf("Starting warm-up phase...\n");
-    for (size_t q = 0; q < queue_depth; q++) {
-        for (size_t i = 0; i < total_size; i += block_size) {
-            for (size_t j = 0; j < read_count; j++) {
-                temp = array[i + j];  // Warm-up read operation
-                (void)temp;
-            }
-            for (size_t j = 0; j < write_count; j++) {
-                array[i + j] = (char)((i + j) & 0xFF);  // Warm-up write operation
-            }
-        }
+
+    if ((buffer = arena_view(total_size, 0)) == NULL) {
+        return 0.0;
     }
 
-    // Start measuring cycles
-    printf("Starting measurement phase...\n");
-    start = rdtsc_start();
-    for (size_t iter = 0; iter < iterations; iter++) {
-        // Perform reads and writes in a loop
-        for (size_t i = 0; i < total_size; i += block_size) {
-            for (size_t j = 0; j < read_count; j++) {
-                temp = array[i + j];  // Read operation
-                (void)temp;
-            }
-            for (size_t j = 0; j < write_count; j++) {
-                array[i + j] = (char)((i + j) & 0xFF);  // Write operation
-            }
-        }
+    double cycles_per_step = mlp_cycles_per_step(buffer, total_size, block_size, queue_depth, dirty);
+    if (cycles_per_step <= 0) {
+        fprintf(stderr, "Buffer of %zu bytes is too small for %zu chains\n", total_size, queue_depth);
+        return 0.0;
     }
-    end = rdtsc_end();
-    total_cycles = end - start;
 
-    // Calculate data accessed and bandwidth
-    double data_accessed = (double)((read_count + write_count) * iterations * (total_size / block_size));
-    double bandwidth = data_accessed / (total_cycles / cpu_frequency);
+    // Each step retires one line per chain, plus its write-back when dirty
+    double bytes_per_step = (double)queue_depth * 64 * (dirty ? 2 : 1);
+    double bandwidth = bytes_per_step / (cycles_per_step / cpu_frequency);
     double bandwidth_gbps = (bandwidth * 8) / 1e9;  // Convert bytes/s to Gbps
 
-    printf("Total cycles: %lu, Data accessed: %.2f bytes\n", total_cycles, data_accessed);
+    printf("Cycles per request: %.2f, Latency under load: %.2f ns\n",
+           cycles_per_step, cycles_per_step * 1e9 / cpu_frequency);
     printf("Bandwidth: %.2f GBps (%.2f Gbps)\n", bandwidth / 1e9, bandwidth_gbps);
 
     return bandwidth;
 }
 
 void multiply_and_measure(size_t array_size) {
-    // Allocate memory for the array
-    double *array = malloc(array_size * sizeof(double));
+    // Take the array from the arena; no allocation or page faults in the timing
+    double *array = arena_view(array_size * sizeof(double), 0);
     if (!array) {
-        perror("Failed to allocate memory");
         return;
     }
 
@@ -298,29 +320,10 @@ void multiply_and_measure(size_t array_size) {
         array[i] = (double)(i + 1);
     }
 
-    // Initialize PAPI
-    int retval = PAPI_library_init(PAPI_VERSION);
-    if (retval != PAPI_VER_CURRENT) {
-        fprintf(stderr, "PAPI library init error!\n");
-        free(array);
-        return;
-    }
-
-    // Declare variables to hold PAPI event values
-    long long values[4]; // For cache misses and TLB misses
-    int event_set = PAPI_NULL;
-
-    // Create an event set
-    PAPI_create_eventset(&event_set);
-
-    // Add cache miss event (PAPI_L1_DCM for Level 1 Data Cache Miss)
-    PAPI_add_event(event_set, PAPI_L1_DCM);
-    // Add TLB miss events
-    PAPI_add_event(event_set, PAPI_TLB_DM); // Data TLB misses
-    PAPI_add_event(event_set, PAPI_TLB_IM); // Instruction TLB misses
-
-    // Start counting events
-    PAPI_start(event_set);
+    // Count the selected event groups (--events=); NULL when no counters are available
+    event_set_t *set = event_active();
+    double values[EVENT_COUNT];
+    int counted = set != NULL && event_set_start(set) == 0;
 
     // Start the timer
     clock_t start_time = clock();
@@ -332,22 +335,21 @@ void multiply_and_measure(size_t array_size) {
     }
 
     // Stop counting events
-    PAPI_stop(event_set, values);
+    counted = counted && event_set_stop(set, values) == 0;
 
     // Stop the timer
     clock_t end_time = clock();
     double elapsed_time = (double)(end_time - start_time) / CLOCKS_PER_SEC;
 
-    // Print the results
-    printf("Array Size: %zu bytes, Execution Time: %.6f seconds, Result: %.2f, "
-           "Cache Misses: %lld, Data TLB Misses: %lld, Instruction TLB Misses: %lld\n",
-           array_size * sizeof(double), elapsed_time, result,
-           values[0], values[1], values[2]);
-
-    // Cleanup
-    PAPI_cleanup_eventset(event_set);
-    PAPI_destroy_eventset(&event_set);
-    free(array);
+    // Print the results; counters only where they were actually read
+    printf("Array Size: %zu bytes, Execution Time: %.6f seconds, Result: %.2f",
+           array_size * sizeof(double), elapsed_time, result);
+    for (int e = 0; counted && e < EVENT_COUNT; e++) {
+        if (set->valid[e]) {
+            printf(", %s: %.0f", event_name((event_id_t)e), values[e]);
+        }
+    }
+    printf("\n");
 }
 
 size_t get_cache_size() {
@@ -364,85 +366,25 @@ size_t get_memory_size() {
 
 
 uint64_t measure_rdtsc_overhead() {
-    uint64_t start, end;
-    start = __rdtsc();
-    end = __rdtsc();
-    return end - start;  // Overhead in cycles
+    return timer_overhead();  // Overhead in cycles, subtracted by timer_cycles
 }
 
 
-// Measure cache memory latency
+// Measure cache memory latency with a dependent pointer chase over 'size' bytes
 double measure_cache_latency(size_t size, double cpu_freq) {
-    volatile char *array = NULL;  // Declare array only once
-
-    // Allocate aligned memory
-    if (posix_memalign((void **)&array, 64, size) != 0) {
-        perror("Failed to allocate memory");
-        exit(1);
-    }
-
-    // Initialize the array
-    for (size_t i = 0; i < size; i++) {
-        array[i] = (char)(i & 0xFF);
-    }
-
-    uint64_t overhead = measure_rdtsc_overhead();
-
-    // Measure latency
-    uint64_t start, end;
-    double total_time = 0.0;
-
-    // Warm-up loop (linear access for cache)
-    for (size_t i = 0; i < size; i++) {
-        (void)array[i];
-    }
-
-    // Timing access
-    for (size_t i = 0; i < size; i++) {
-        start = __rdtsc();
-        (void)array[i];
-        end = __rdtsc();
-        total_time += (end - start - overhead);  // Subtract overhead
+    double cycles = chase_latency_cycles(size);
+    if (cycles < 0) {
+        return -1;
     }
-
-    free((void *)array);
-
-    // Convert cycles to nanoseconds
-    return (total_time / size) * (1e9 / cpu_freq);  // Average latency in ns
+    return cycles * (1e9 / cpu_freq);  // Average latency in ns
 }
 
 
-
-// Measure main memory latency
+// Measure main memory latency; 'size' should be well past the LLC
 double measure_memory_latency(size_t size, double cpu_freq) {
-    volatile char *array = malloc(size);
-    if (array == NULL) {
-        perror("Failed to allocate memory");
+    double cycles = chase_latency_cycles(size);
+    if (cycles < 0) {
         return -1;
     }
-
-    // Initialize the array
-    for (size_t i = 0; i < size; i++) {
-        array[i] = (char)(i & 0xFF);
-    }
-
-    uint64_t start, end;
-    double total_time_ns = 0.0;
-
-    // Warm-up loop
-    for (size_t i = 0; i < size; i++) {
-        (void)array[rand() % size]; // Random access to warm the memory
-    }
-
-    // Timing random access
-    for (size_t i = 0; i < size; i++) {
-        size_t index = rand() % size; // Random index
-        start = __rdtsc();
-        (void)array[index]; // Access to measure latency
-        end = __rdtsc();
-        total_time_ns += (end - start) * (1e9 / cpu_freq);
-    }
-
-    free((void *)array);
-    return total_time_ns / size; // Return average latency in nanoseconds
+    return cycles * (1e9 / cpu_freq);  // Average latency in nanoseconds
 }
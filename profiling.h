@@ -3,17 +3,33 @@
 
 #include <stdint.h>
 #include <stdlib.h>
+#include "kernels.h"
+#include "timing.h"
 
 extern volatile char *array;  // Global array
 
 #define ARRAY_SIZE (32 * 1024 * 1024)  // 32MB
 
+uint64_t rdtsc_start();
+uint64_t rdtsc_end();
 void initialize_memory(size_t size);
 double measure_read_latency(size_t size);
 double measure_write_latency(size_t size);
 void set_cpu_affinity(int core_id);
+int try_set_cpu_affinity(int core_id);
 void verify_cpu_affinity();
+// The mask the profiler was started with, saved by main before anything pins;
+// profiled programs get it back so they run the way they normally would
+void save_startup_affinity(void);
+int restore_startup_affinity(void);
+// The startup mask minus one core (kept when it is the only one), e.g. for a thread
+// that must stay off a pinned target's core
+int restore_startup_affinity_except(int core_id);
 double measure_bandwidth(size_t block_size, double read_ratio, size_t total_size);
+double measure_bandwidth_kernel(size_t block_size, double read_ratio, size_t total_size,
+                                bw_kernel_t kernel);
+uint64_t bandwidth_pass(bw_kernel_t kernel, char *buf, size_t block_size, double read_ratio,
+                        size_t total_size, size_t iterations);
 void measure_maximum_bandwidth(size_t total_size);
 double get_cpu_frequency();
 double measure_bandwidth_with_queue(size_t block_size, double read_ratio, size_t total_size, size_t queue_depth);
@@ -24,6 +40,6 @@ double measure_cache_latency(size_t size, double cpu_freq);
 double measure_memory_latency(size_t size, double cpu_freq);
 
 // Consistent declaration with user_code.c
-void profile_user_code(const char *arg);
+void profile_user_code(char *const user_argv[], double sample_interval_ms);
 
 #endif // PROFILING_H
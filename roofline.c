@@ -0,0 +1,425 @@
+#define _GNU_SOURCE
+#include "roofline.h"
+#include "bandwidth_mt.h"
+#include "cachesim.h"
+#include "chase.h"
+#include "harness.h"
+#include "kernels.h"
+#include "perf_counters.h"
+#include "profiling.h"
+#include <cpuid.h>
+#include <immintrin.h>
+#include <linux/perf_event.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define FLOPS_BATCH 1024          // Iterations per harness rep
+#define FLOPS_ALL_SECONDS 0.2     // Run time of each all-core measurement
+#define ROOF_MIN_AI (1.0 / 16)    // Arithmetic-intensity range of the printed roof
+#define ROOF_MAX_AI 64.0
+#define FP_MAX_EVENTS 8
+
+static volatile double flops_sink;
+
+// Twelve independent accumulators cover FMA latency x ports on current cores;
+// multiplying by just under one and adding a small constant keeps values finite.
+// The empty asm hides the constants, or the compiler may fold the whole loop
+#define DEFINE_FLOPS(SUFFIX, ATTR, VEC, SET1, OP, ADD, FIRST)                        \
+ATTR static double flops_##SUFFIX(size_t iterations) {                              \
+    VEC m = SET1(0.999999999), a = SET1(1e-9);                                       \
+    __asm__("" : "+x"(m), "+x"(a));                                                  \
+    VEC acc0 = SET1(1.0), acc1 = SET1(1.0), acc2 = SET1(1.0), acc3 = SET1(1.0);      \
+    VEC acc4 = SET1(1.0), acc5 = SET1(1.0), acc6 = SET1(1.0), acc7 = SET1(1.0);      \
+    VEC acc8 = SET1(1.0), acc9 = SET1(1.0), acc10 = SET1(1.0), acc11 = SET1(1.0);    \
+    for (size_t i = 0; i < iterations; i++) {                                        \
+        acc0 = OP(acc0, m, a);                                                       \
+        acc1 = OP(acc1, m, a);                                                       \
+        acc2 = OP(acc2, m, a);                                                       \
+        acc3 = OP(acc3, m, a);                                                       \
+        acc4 = OP(acc4, m, a);                                                       \
+        acc5 = OP(acc5, m, a);                                                       \
+        acc6 = OP(acc6, m, a);                                                       \
+        acc7 = OP(acc7, m, a);                                                       \
+        acc8 = OP(acc8, m, a);                                                       \
+        acc9 = OP(acc9, m, a);                                                       \
+        acc10 = OP(acc10, m, a);                                                     \
+        acc11 = OP(acc11, m, a);                                                     \
+    }                                                                                \
+    VEC sum = ADD(ADD(ADD(acc0, acc1), ADD(acc2, acc3)), ADD(ADD(acc4, acc5), ADD(acc6, acc7))); \
+    sum = ADD(sum, ADD(ADD(acc8, acc9), ADD(acc10, acc11)));                         \
+    return FIRST(sum);                                                               \
+}
+#define FLOPS_ACCUMULATORS 12
+
+#define SCALAR_OP(x, m, a) _mm_add_sd(_mm_mul_sd((x), (m)), (a))
+DEFINE_FLOPS(scalar, , __m128d, _mm_set1_pd, SCALAR_OP, _mm_add_sd, _mm_cvtsd_f64)
+DEFINE_FLOPS(scalar_fma, __attribute__((target("fma"))), __m128d, _mm_set1_pd, _mm_fmadd_sd,
+             _mm_add_sd, _mm_cvtsd_f64)
+#define SSE2_OP(x, m, a) _mm_add_pd(_mm_mul_pd((x), (m)), (a))
+DEFINE_FLOPS(sse2, , __m128d, _mm_set1_pd, SSE2_OP, _mm_add_pd, _mm_cvtsd_f64)
+DEFINE_FLOPS(avx2_fma, __attribute__((target("avx2,fma"))), __m256d, _mm256_set1_pd, _mm256_fmadd_pd,
+             _mm256_add_pd, _mm256_cvtsd_f64)
+DEFINE_FLOPS(avx512_fma, __attribute__((target("avx512f"))), __m512d, _mm512_set1_pd, _mm512_fmadd_pd,
+             _mm512_add_pd, _mm512_cvtsd_f64)
+
+static int always_supported(void) {
+    return 1;
+}
+
+static int fma_supported(void) {
+    return __builtin_cpu_supports("fma");
+}
+
+static int avx2_fma_supported(void) {
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+}
+
+static int avx512_supported(void) {
+    return __builtin_cpu_supports("avx512f");
+}
+
+typedef struct {
+    const char *name;
+    unsigned lanes;
+    int (*supported)(void);
+    double (*run)(size_t iterations);
+} flops_entry_t;
+
+static const flops_entry_t flops_table[FLOPS_COUNT] = {
+    [FLOPS_SCALAR]     = {"scalar",     1, always_supported,   flops_scalar},
+    [FLOPS_SCALAR_FMA] = {"scalar fma", 1, fma_supported,      flops_scalar_fma},
+    [FLOPS_SSE2]       = {"sse2",       2, always_supported,   flops_sse2},
+    [FLOPS_AVX2_FMA]   = {"avx2 fma",   4, avx2_fma_supported, flops_avx2_fma},
+    [FLOPS_AVX512_FMA] = {"avx512 fma", 8, avx512_supported,   flops_avx512_fma},
+};
+
+static const char *level_names[ROOF_LEVEL_COUNT] = {"L1", "L2", "L3", "DRAM"};
+
+const char *flops_kernel_name(flops_kernel_t kernel) {
+    return kernel < FLOPS_COUNT ? flops_table[kernel].name : "unknown";
+}
+
+// Every iteration is one multiply and one add (fused or not) per lane per accumulator
+static double flops_per_iteration(flops_kernel_t kernel) {
+    return 2.0 * FLOPS_ACCUMULATORS * flops_table[kernel].lanes;
+}
+
+static void flops_trial(void *ctx, size_t reps) {
+    const flops_entry_t *entry = ctx;
+    flops_sink = entry->run(reps * FLOPS_BATCH);
+}
+
+// All-core run: every worker pins itself, waits at the barrier, then runs a fixed count
+typedef struct {
+    pthread_barrier_t *start;
+    const flops_entry_t *entry;
+    int core;
+    size_t iterations;
+    int failed;
+} flops_worker_t;
+
+static void *flops_worker(void *arg) {
+    flops_worker_t *worker = arg;
+    worker->failed = try_set_cpu_affinity(worker->core) != 0;
+    pthread_barrier_wait(worker->start);
+    if (!worker->failed) {
+        flops_sink = worker->entry->run(worker->iterations);
+    }
+    return NULL;
+}
+
+static double flops_all_cores(flops_kernel_t kernel, const int *cores, size_t num_cores,
+                              double cycles_per_iteration, double cpu_frequency) {
+    pthread_t threads[MT_MAX_CORES];
+    flops_worker_t workers[MT_MAX_CORES];
+    pthread_barrier_t start;
+    size_t iterations = (size_t)(FLOPS_ALL_SECONDS * cpu_frequency / cycles_per_iteration);
+    size_t ran = 0;
+
+    pthread_barrier_init(&start, NULL, (unsigned)num_cores + 1);
+    for (size_t t = 0; t < num_cores; t++) {
+        workers[t] = (flops_worker_t){&start, &flops_table[kernel], cores[t], iterations, 0};
+        if (pthread_create(&threads[t], NULL, flops_worker, &workers[t]) != 0) {
+            perror("pthread_create");
+            exit(1);
+        }
+    }
+
+    pthread_barrier_wait(&start);
+    uint64_t begin = timer_start();
+    for (size_t t = 0; t < num_cores; t++) {
+        pthread_join(threads[t], NULL);
+        ran += !workers[t].failed;
+    }
+    uint64_t cycles = timer_cycles(begin, timer_stop());
+    pthread_barrier_destroy(&start);
+
+    if (cycles == 0) {
+        return 0.0;
+    }
+    return ran * iterations * flops_per_iteration(kernel) / (cycles / cpu_frequency) / 1e9;
+}
+
+void roofline_measure(roofline_t *roof) {
+    double cpu_frequency = get_cpu_frequency();
+    int cores[MT_MAX_CORES];
+    cache_config_t caches[SIM_MAX_LEVELS];
+
+    memset(roof, 0, sizeof(*roof));
+    roof->num_cores = parse_core_list(NULL, cores, MT_MAX_CORES);
+    if (roof->num_cores == 0 || try_set_cpu_affinity(cores[0]) != 0) {
+        fprintf(stderr, "No usable core for the roofline measurements\n");
+        return;
+    }
+
+    for (int k = 0; k < FLOPS_COUNT; k++) {
+        if (!flops_table[k].supported()) {
+            continue;
+        }
+        flops_table[k].run(FLOPS_BATCH);  // Warm-up: brings the vector units up to speed
+        double cycles = bench_run(flops_trial, (void *)&flops_table[k], NULL, NULL);
+        if (cycles <= 0) {
+            continue;
+        }
+        double cycles_per_iteration = cycles / FLOPS_BATCH;
+        roof->gflops[k] = flops_per_iteration((flops_kernel_t)k) / (cycles_per_iteration / cpu_frequency) / 1e9;
+        roof->gflops_all[k] = flops_all_cores((flops_kernel_t)k, cores, roof->num_cores,
+                                              cycles_per_iteration, cpu_frequency);
+    }
+    try_set_cpu_affinity(cores[0]);  // The workers ran on other cores; stay on the first
+
+    // Half of each cache level for the load ceilings, and a buffer past the LLC for DRAM
+    size_t num_caches = cache_sim_detect(caches, SIM_MAX_LEVELS);
+    for (size_t l = 0; l < num_caches && l < ROOF_DRAM; l++) {
+        roof->level_size[l] = caches[l].size / 2;
+    }
+    roof->level_size[ROOF_DRAM] = chase_dram_size() / 2;  // measure_kernel_bandwidth maps twice this
+    for (int l = 0; l < ROOF_LEVEL_COUNT; l++) {
+        if (roof->level_size[l] >= 4096) {
+            roof->gbps[l] = measure_kernel_bandwidth(kernel_best(), OP_LOAD, roof->level_size[l], NULL) / 1e9;
+        }
+    }
+}
+
+static double best_gflops(const roofline_t *roof) {
+    double best = 0.0;
+    for (int k = 0; k < FLOPS_COUNT; k++) {
+        if (roof->gflops[k] > best) {
+            best = roof->gflops[k];
+        }
+    }
+    return best;
+}
+
+// Attainable GFLOP/s at an arithmetic intensity under one memory level
+static double roof_at(const roofline_t *roof, roof_level_t level, double intensity) {
+    double memory = intensity * roof->gbps[level];
+    double peak = best_gflops(roof);
+    return memory < peak ? memory : peak;
+}
+
+static void print_ceilings(const roofline_t *roof, int csv) {
+    double peak = best_gflops(roof);
+
+    if (csv) {
+        printf("section,name,value,unit\n");
+        printf("compute,cores,%zu,\n", roof->num_cores);
+        for (int k = 0; k < FLOPS_COUNT; k++) {
+            if (roof->gflops[k] > 0) {
+                printf("compute,%s 1 core,%.3f,GFLOP/s\n", flops_table[k].name, roof->gflops[k]);
+                printf("compute,%s all cores,%.3f,GFLOP/s\n", flops_table[k].name, roof->gflops_all[k]);
+            }
+        }
+        for (int l = 0; l < ROOF_LEVEL_COUNT; l++) {
+            if (roof->gbps[l] > 0) {
+                printf("memory,%s,%.3f,GB/s\n", level_names[l], roof->gbps[l]);
+                printf("ridge,%s,%.4f,FLOP/B\n", level_names[l], peak / roof->gbps[l]);
+            }
+        }
+        for (double ai = ROOF_MIN_AI; ai <= ROOF_MAX_AI; ai *= 2) {
+            for (int l = 0; l < ROOF_LEVEL_COUNT; l++) {
+                if (roof->gbps[l] > 0) {
+                    printf("roof,%s@%.4f,%.3f,GFLOP/s\n", level_names[l], ai, roof_at(roof, (roof_level_t)l, ai));
+                }
+            }
+        }
+        return;
+    }
+
+    printf("=== Compute Ceilings (double precision) ===\n");
+    printf("Kernel\t\t1 Core (GFLOP/s)\tAll %zu Cores (GFLOP/s)\n", roof->num_cores);
+    for (int k = 0; k < FLOPS_COUNT; k++) {
+        if (roof->gflops[k] <= 0) {
+            printf("%-12s\tnot supported by this CPU\n", flops_table[k].name);
+            continue;
+        }
+        printf("%-12s\t%-16.2f\t%.2f\n", flops_table[k].name, roof->gflops[k], roof->gflops_all[k]);
+    }
+
+    printf("\n=== Memory Ceilings (%s loads, 1 core) ===\n", kernel_name(kernel_best()));
+    printf("Level\tWorking Set (Bytes)\tBandwidth (GB/s)\tRidge Point (FLOP/B)\n");
+    for (int l = 0; l < ROOF_LEVEL_COUNT; l++) {
+        if (roof->gbps[l] <= 0) {
+            printf("%-4s\tnot detected\n", level_names[l]);
+            continue;
+        }
+        printf("%-4s\t%-20zu\t%-16.2f\t%.3f\n", level_names[l], roof->level_size[l], roof->gbps[l],
+               peak / roof->gbps[l]);
+    }
+
+    printf("\n=== Roofline (attainable GFLOP/s, 1 core) ===\nAI (FLOP/B)");
+    for (int l = 0; l < ROOF_LEVEL_COUNT; l++) {
+        if (roof->gbps[l] > 0) {
+            printf("\t%s", level_names[l]);
+        }
+    }
+    printf("\n");
+    for (double ai = ROOF_MIN_AI; ai <= ROOF_MAX_AI; ai *= 2) {
+        printf("%-8.4f", ai);
+        for (int l = 0; l < ROOF_LEVEL_COUNT; l++) {
+            if (roof->gbps[l] > 0) {
+                printf("\t%.2f", roof_at(roof, (roof_level_t)l, ai));
+            }
+        }
+        printf("\n");
+    }
+}
+
+// Retired FP operations, inherited by every child forked after opening. Intel
+// counts FP_ARITH_INST_RETIRED per width (FMA counts twice); AMD Zen counts FLOPs
+typedef struct {
+    int fds[FP_MAX_EVENTS];
+    double weights[FP_MAX_EVENTS];
+    size_t num;
+    uint64_t start[FP_MAX_EVENTS][3];
+} fp_counters_t;
+
+static void cpu_vendor(char vendor[13]) {
+    unsigned int eax, ebx, ecx, edx;
+    memset(vendor, 0, 13);
+    if (__get_cpuid(0, &eax, &ebx, &ecx, &edx)) {
+        memcpy(vendor, &ebx, 4);
+        memcpy(vendor + 4, &edx, 4);
+        memcpy(vendor + 8, &ecx, 4);
+    }
+}
+
+static size_t fp_counters_open(fp_counters_t *fp) {
+    static const struct {
+        uint64_t config;
+        double weight;
+    } intel[] = {
+        {0x01C7, 1}, {0x02C7, 1},    // Scalar double, scalar single
+        {0x04C7, 2}, {0x08C7, 4},    // 128-bit packed double, single
+        {0x10C7, 4}, {0x20C7, 8},    // 256-bit
+        {0x40C7, 8}, {0x80C7, 16},   // 512-bit
+    };
+    char vendor[13];
+
+    memset(fp, 0, sizeof(*fp));
+    cpu_vendor(vendor);
+    if (strcmp(vendor, "GenuineIntel") == 0) {
+        for (size_t i = 0; i < sizeof(intel) / sizeof(intel[0]); i++) {
+            int fd = perf_counter_open(PERF_TYPE_RAW, intel[i].config, 0, 0);
+            if (fd >= 0) {
+                fp->fds[fp->num] = fd;
+                fp->weights[fp->num++] = intel[i].weight;
+            }
+        }
+    } else if (strcmp(vendor, "AuthenticAMD") == 0) {
+        int fd = perf_counter_open(PERF_TYPE_RAW, 0xFF03, 0, 0);  // RETIRED_SSE_AVX_FLOPS, all types
+        if (fd >= 0) {
+            fp->fds[fp->num] = fd;
+            fp->weights[fp->num++] = 1;
+        }
+    }
+    for (size_t i = 0; i < fp->num; i++) {
+        perf_counter_read(fp->fds[i], fp->start[i]);
+    }
+    return fp->num;
+}
+
+static double fp_counters_close(fp_counters_t *fp) {
+    double flops = 0.0;
+    for (size_t i = 0; i < fp->num; i++) {
+        uint64_t end[3];
+        if (perf_counter_read(fp->fds[i], end) == 0) {
+            double enabled = (double)(end[1] - fp->start[i][1]);
+            double running = (double)(end[2] - fp->start[i][2]);
+            double count = (double)(end[0] - fp->start[i][0]);
+            flops += fp->weights[i] * (running > 0 && running < enabled ? count * enabled / running : count);
+        }
+        close(fp->fds[i]);
+    }
+    return flops;
+}
+
+// Run the target under the FP counters plus the usual set, and place it on the DRAM roof
+static void place_program(const roofline_t *roof, char *const argv[], int csv) {
+    fp_counters_t fp;
+    child_profile_t child;
+
+    size_t fp_events = fp_counters_open(&fp);
+    if (run_with_counters(argv, 0, -1, &child) != 0) {
+        fp_counters_close(&fp);
+        fprintf(stderr, "Failed to start user program\n");
+        return;
+    }
+    double flops = fp_counters_close(&fp);
+    double bytes = child.valid[COUNTER_LLC_MISSES] ? (double)child.values[COUNTER_LLC_MISSES] * 64 : 0.0;
+    double gflops = child.wall_seconds > 0 ? flops / child.wall_seconds / 1e9 : 0.0;
+    free_child_profile(&child);
+
+    if (fp_events == 0 || bytes <= 0) {
+        fprintf(stderr, "No %s counters (needs a hardware PMU); program not placed on the roofline\n",
+                fp_events == 0 ? "FP-operation" : "LLC-miss");
+        if (!csv) {
+            printf("\n=== Program ===\nWall Time: %.3f s\n", child.wall_seconds);
+        }
+        return;
+    }
+
+    double intensity = flops / bytes;
+    double attainable = roof_at(roof, ROOF_DRAM, intensity);
+    double ridge = roof->gbps[ROOF_DRAM] > 0 ? best_gflops(roof) / roof->gbps[ROOF_DRAM] : 0.0;
+    const char *bound = intensity < ridge ? "memory" : "compute";
+
+    if (csv) {
+        printf("program,flops,%.0f,FLOP\n", flops);
+        printf("program,dram_bytes,%.0f,B\n", bytes);
+        printf("program,intensity,%.4f,FLOP/B\n", intensity);
+        printf("program,achieved,%.3f,GFLOP/s\n", gflops);
+        printf("program,attainable,%.3f,GFLOP/s\n", attainable);
+        printf("program,bound,%s,\n", bound);
+        return;
+    }
+    printf("\n=== Program on the Roofline (DRAM traffic = LLC misses x 64 B) ===\n");
+    printf("FP Operations: %.0f\n", flops);
+    printf("DRAM Traffic: %.0f bytes\n", bytes);
+    printf("Wall Time: %.3f s\n", child.wall_seconds);
+    printf("Arithmetic Intensity: %.4f FLOP/B (ridge %.3f)\n", intensity, ridge);
+    printf("Achieved: %.3f GFLOP/s of %.3f attainable (%.1f%% of the roof), %s-bound\n",
+           gflops, attainable, attainable > 0 ? 100.0 * gflops / attainable : 0.0, bound);
+}
+
+void measure_roofline(char *const argv[], int csv) {
+    roofline_t roof;
+    cpu_set_t original;
+
+    // The measurements pin this thread; the program must get the full mask back
+    int restore = sched_getaffinity(0, sizeof(original), &original) == 0;
+    roofline_measure(&roof);
+    print_ceilings(&roof, csv);
+    if (restore && sched_setaffinity(0, sizeof(original), &original) != 0) {
+        perror("sched_setaffinity");
+    }
+
+    if (argv != NULL && argv[0] != NULL) {
+        fflush(stdout);
+        place_program(&roof, argv, csv);
+    }
+}
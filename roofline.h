@@ -0,0 +1,41 @@
+#ifndef ROOFLINE_H
+#define ROOFLINE_H
+
+#include <stddef.h>
+
+// Floating-point kernels the compute ceilings are measured with
+typedef enum {
+    FLOPS_SCALAR,      // mulsd + addsd
+    FLOPS_SCALAR_FMA,  // vfmadd231sd
+    FLOPS_SSE2,        // mulpd + addpd, 2 lanes
+    FLOPS_AVX2_FMA,    // 256-bit FMA, 4 lanes
+    FLOPS_AVX512_FMA,  // 512-bit FMA, 8 lanes
+    FLOPS_COUNT
+} flops_kernel_t;
+
+// Memory levels the bandwidth ceilings are measured at
+typedef enum {
+    ROOF_L1,
+    ROOF_L2,
+    ROOF_L3,
+    ROOF_DRAM,
+    ROOF_LEVEL_COUNT
+} roof_level_t;
+
+typedef struct {
+    double gflops[FLOPS_COUNT];         // One core; 0 where the CPU lacks the kernel
+    double gflops_all[FLOPS_COUNT];     // Every core of the affinity mask
+    size_t num_cores;
+    double gbps[ROOF_LEVEL_COUNT];      // One-core load bandwidth; 0 where not measured
+    size_t level_size[ROOF_LEVEL_COUNT];
+} roofline_t;
+
+const char *flops_kernel_name(flops_kernel_t kernel);
+
+// Peak FP throughput per core and all-core, and L1/L2/L3/DRAM load bandwidth
+void roofline_measure(roofline_t *roof);
+// Ceilings, then (when argv is non-NULL) the program run under FP and LLC counters
+// and placed by arithmetic intensity; csv switches to one "section,name,value,unit" per line
+void measure_roofline(char *const argv[], int csv);
+
+#endif // ROOFLINE_H
@@ -0,0 +1,92 @@
+#define _GNU_SOURCE
+#include "timing.h"
+#include <cpuid.h>
+#include <stdio.h>
+#include <time.h>
+
+#define CALIBRATION_ROUNDS 5
+#define CALIBRATION_NS 20000000L     // 20 ms per round
+#define OVERHEAD_SAMPLES 1000
+
+static double calibrated_frequency = 0.0;
+static uint64_t measured_overhead = UINT64_MAX;
+
+static int64_t monotonic_raw_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return (int64_t)ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+int tsc_invariant(void) {
+    unsigned int eax, ebx, ecx, edx;
+    if (__get_cpuid(0x80000000, &eax, &ebx, &ecx, &edx) == 0 || eax < 0x80000007) {
+        return 0;
+    }
+    __get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx);
+    return (edx >> 8) & 1;
+}
+
+// TSC ticks over one busy-waited round; the clock reads are bracketed by TSC
+// reads so the uncertainty is one clock_gettime call, not a scheduler tick
+static double calibration_round(void) {
+    uint64_t tsc_before = timer_start();
+    int64_t ns_start = monotonic_raw_ns();
+    uint64_t tsc_after = timer_stop();
+    uint64_t tsc_start = tsc_before + (tsc_after - tsc_before) / 2;
+
+    int64_t ns_end;
+    uint64_t tsc_end;
+    do {
+        tsc_before = timer_start();
+        ns_end = monotonic_raw_ns();
+        tsc_after = timer_stop();
+    } while (ns_end - ns_start < CALIBRATION_NS);
+    tsc_end = tsc_before + (tsc_after - tsc_before) / 2;
+
+    return (double)(tsc_end - tsc_start) * 1e9 / (double)(ns_end - ns_start);
+}
+
+double tsc_frequency(void) {
+    if (calibrated_frequency > 0) {
+        return calibrated_frequency;
+    }
+    if (!tsc_invariant()) {
+        fprintf(stderr, "Warning: TSC is not invariant; cycle counts follow the current clock\n");
+    }
+
+    // Median of the rounds, so one preempted round does not skew the result
+    double rounds[CALIBRATION_ROUNDS];
+    for (int r = 0; r < CALIBRATION_ROUNDS; r++) {
+        double value = calibration_round();
+        int i = r;
+        while (i > 0 && rounds[i - 1] > value) {
+            rounds[i] = rounds[i - 1];
+            i--;
+        }
+        rounds[i] = value;
+    }
+    calibrated_frequency = rounds[CALIBRATION_ROUNDS / 2];
+    return calibrated_frequency;
+}
+
+uint64_t timer_overhead(void) {
+    if (measured_overhead != UINT64_MAX) {
+        return measured_overhead;
+    }
+    uint64_t best = UINT64_MAX;
+    for (int i = 0; i < OVERHEAD_SAMPLES; i++) {
+        uint64_t start = timer_start();
+        uint64_t stop = timer_stop();
+        if (stop - start < best) {
+            best = stop - start;
+        }
+    }
+    measured_overhead = best;
+    return measured_overhead;
+}
+
+uint64_t timer_cycles(uint64_t start, uint64_t stop) {
+    uint64_t elapsed = stop - start;
+    uint64_t overhead = timer_overhead();
+    return elapsed > overhead ? elapsed - overhead : 0;
+}
@@ -0,0 +1,32 @@
+#ifndef TIMING_H
+#define TIMING_H
+
+#include <stdint.h>
+#include <x86intrin.h>
+
+// Fenced TSC reads: earlier instructions retire before the start read, and the
+// stop read waits for the timed code before later instructions begin
+static inline uint64_t timer_start(void) {
+    _mm_lfence();
+    uint64_t tsc = __rdtsc();
+    _mm_lfence();
+    return tsc;
+}
+
+static inline uint64_t timer_stop(void) {
+    unsigned int aux;
+    uint64_t tsc = __rdtscp(&aux);
+    _mm_lfence();
+    return tsc;
+}
+
+// TSC ticks per second, calibrated once against CLOCK_MONOTONIC_RAW
+double tsc_frequency(void);
+// 1 if CPUID reports an invariant TSC (constant rate across P/C-states)
+int tsc_invariant(void);
+// Cycles an empty timer_start/timer_stop pair reports, measured once
+uint64_t timer_overhead(void);
+// stop - start with the timer overhead removed, never below zero
+uint64_t timer_cycles(uint64_t start, uint64_t stop);
+
+#endif // TIMING_H
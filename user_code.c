@@ -1,10 +1,14 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include "profiling.h"
+#include "perf_counters.h"
+#include "arena.h"
+#include "antagonist.h"
+#include "alloc_profile.h"
 
 extern volatile char *array;  // Declare array as external
 
-void profile_user_code(const char *user_program) {
+void profile_user_code(char *const user_argv[], double sample_interval_ms) {
     size_t size = 64 * 1024; // Example size: 64KB
     size_t main_mem = 16 * 1024 * 1024; // Example size: 16MB
     double cpu_freq = get_cpu_frequency();
@@ -12,6 +16,11 @@ void profile_user_code(const char *user_program) {
     set_cpu_affinity(0);
     verify_cpu_affinity();
 
+    // Every buffer below is a view of one arena; reserve the largest up front
+    if (arena_reserve(main_mem) != 0) {
+        return;
+    }
+
     // Initialize memory for profiling
     initialize_memory(size);
 
@@ -36,19 +45,39 @@ void profile_user_code(const char *user_program) {
     printf("Cache Latency: %.2f ns\n", cache_latency);
     printf("Main Memory Latency: %.2f ns\n", memory_latency);
 
-    // Execute user program
+    // Execute user program: fork/exec with no shell, counters attached to the child
     printf("\n=== Executing User Program ===\n");
-    printf("User Program: %s\n", user_program);
-
-    char command[256];
-    snprintf(command, sizeof(command), "%s", user_program);
-
-    int result = system(command);
-    if (result == -1) {
-        perror("system");
+    printf("User Program:");
+    for (size_t i = 0; user_argv[i] != NULL; i++) {
+        printf(" %s", user_argv[i]);
+    }
+    printf("\n");
+
+    // The preload library only reaches this run; interference runs go without it
+    alloc_session_t alloc_session;
+    alloc_profile_t alloc;
+    int alloc_ok = alloc_profiling && alloc_profile_begin(&alloc_session) == 0;
+    child_profile_t child;
+    int started = run_with_counters(user_argv, sample_interval_ms, -1, &child);
+    if (alloc_ok) {
+        alloc_profile_end(&alloc_session, &alloc);
+    }
+    if (started != 0) {
+        fprintf(stderr, "Failed to start user program\n");
         exit(1);
-    } else {
-        printf("User program executed successfully.\n");
+    }
+    printf("\n=== User Program Counters ===\n");
+    print_child_profile(&child);
+    print_child_timeline(&child);
+    if (alloc_ok) {
+        printf("\n=== Allocation Profile ===\n");
+        print_alloc_profile(&alloc, child.wall_seconds, child.cpu_seconds);
+    }
+    free_child_profile(&child);
+
+    // Same program again, clean and beside the configured noisy neighbour
+    if (antagonist.kind != ANTAG_NONE) {
+        measure_interference(user_argv, &antagonist);
     }
 
     // Measure latencies after execution
@@ -63,7 +92,7 @@ void profile_user_code(const char *user_program) {
     // Call the bandwidth measurement function with different queue depths
     size_t block_size = 64;  // Example block size
     double read_ratio = 0.7; // Example read ratio
-    size_t total_size = size; // Using the same size as the initial profiling
+    size_t total_size = main_mem; // Past the caches, so every request is a real miss
 
     printf("\n=== Measuring Bandwidth for Different Queue Depths ===\n");
     double previous_bandwidth = 0.0;
@@ -87,7 +116,4 @@ void profile_user_code(const char *user_program) {
     if (contention_queue_depth == 0) {
         printf("No contention detected in the tested queue depths.\n");
     }
-
-    // Free allocated memory
-    free((void*)array);
 }
@@ -1,6 +1,6 @@
 #ifndef USER_CODE_H
 #define USER_CODE_H
 
-void profile_user_code(const char *user_program);
+void profile_user_code(char *const user_argv[], double sample_interval_ms);
 
 #endif // USER_CODE_H